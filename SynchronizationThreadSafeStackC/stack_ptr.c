@@ -5,9 +5,10 @@
 // Using a mutex ensures that no two threads will read or write to the stack pointer at the same time, avoiding undefined behavior.
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 
-// Define the number of threads and iterations
+// Define the default number of threads and iterations
 #define NUM_THREADS 200
 #define NUM_ITERATIONS 500
 
@@ -21,78 +22,146 @@ typedef struct Node
     struct Node *next; // Node will hold 'next' of type 'pointer' pointing to a Node
 } StackNode; // renames "struct Node" to "StackNode" for variable declaration
 
-//// Declare the mutex for the stack
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+//// A stack is its top pointer plus the mutex that guards it
+typedef struct
+{
+    StackNode *top; // Top node of the stack, NULL when empty
+    pthread_mutex_t mutex; // Mutex ensuring no two threads read or write 'top' at the same time
+} Stack;
+
 //// Declare the mutex for writing to the output file
 pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+//// Workload settings, shared with the C++ and Rust drivers so the cross-language harness can run all three alike
+////   --threads N        number of threads (default 200)
+////   --iterations N     loop iterations per thread; each iteration is 6 operations (default 500)
+////   --mix M            classic (3 pushes and 3 pops intermixed), push-heavy, balanced or pop-heavy (default classic)
+////   --log on|off       write every operation to output.txt (default on)
+////   --mode M           per-thread (each thread has its own stack, the default) or shared (one stack for all threads)
+typedef struct
+{
+    int threads;
+    int iterations;
+    int push_percent; // 0 selects the classic pattern; otherwise the share of random operations that are pushes
+    int log;
+    int shared;
+} Workload;
+
+Workload workload = {NUM_THREADS, NUM_ITERATIONS, 0, 1, 0};
+
+//// Arguments handed to each thread
+typedef struct
+{
+    Stack *stack; // Stack this thread works on
+    FILE *fp; // Output file, or NULL when logging is off
+    unsigned long long seed; // Seed for the random operation mixes
+} ThreadArgs;
+
 //// Stack function declarations
-////  Using a double pointer ** allows the function to modify the pointer itself and change what the top of the stack points to
-void    push    (value_t v, StackNode **top, FILE *fp); // Pushes value_t onto the top of the stack
-value_t pop     (           StackNode **top, FILE *fp); // Extracts value_t from the top of the stack
+////  Passing the Stack by pointer allows the function to modify its top pointer and change what the top of the stack points to
+void    push    (value_t v, Stack *stack, FILE *fp); // Pushes value_t onto the top of the stack
+value_t pop     (           Stack *stack, FILE *fp); // Extracts value_t from the top of the stack
 int     is_empty(           StackNode *top); // Checks if the stack has a top node. If not, then the stack is empty
 void *testStack(void *arg); // Serves as the entry point for each thread
+int parse_workload(int argc, char *argv[]); // Reads the workload settings from the command line
 
 //// Main control flow
-int main(void) {
-    pthread_t threads[NUM_THREADS]; // Declare an array to hold the threads
-    FILE *fp = fopen("output.txt", "w"); // Open a file called "output.txt" in write mode to log output data.
-    if (!fp) { // Check if the file was successfully open
-        perror("Failed to open file"); // If it wasn't, print an error message and exit
+int main(int argc, char *argv[]) {
+    if (parse_workload(argc, argv) != 0) { // Read the workload settings, or print usage and exit
         return EXIT_FAILURE;
     }
-    // Create 200 threads
-    for (int i = 0 ; i < NUM_THREADS ; i++) {
-        // Attempt to create each thread to run testStack and pass the file pointer as an argument.
-        if (pthread_create(&threads[i], NULL, testStack, fp) != 0) {
+    int num_stacks = workload.shared ? 1 : workload.threads; // One stack for everyone, or one per thread
+    pthread_t *threads = malloc(sizeof(pthread_t) * workload.threads); // Declare an array to hold the threads
+    ThreadArgs *args = malloc(sizeof(ThreadArgs) * workload.threads); // Declare an array to hold each thread's arguments
+    Stack *stacks = malloc(sizeof(Stack) * num_stacks); // Declare the stacks the threads will work on
+    if (!threads || !args || !stacks) {
+        fprintf(stderr, "Failed to allocate memory for the threads\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0 ; i < num_stacks ; i++) {
+        stacks[i].top = NULL; // Each stack starts empty
+        pthread_mutex_init(&stacks[i].mutex, NULL);
+    }
+    FILE *fp = NULL;
+    if (workload.log) {
+        fp = fopen("output.txt", "w"); // Open a file called "output.txt" in write mode to log output data.
+        if (!fp) { // Check if the file was successfully open
+            perror("Failed to open file"); // If it wasn't, print an error message and exit
+            return EXIT_FAILURE;
+        }
+    }
+    // Create the threads
+    for (int i = 0 ; i < workload.threads ; i++) {
+        args[i].stack = &stacks[workload.shared ? 0 : i];
+        args[i].fp = fp;
+        args[i].seed = 0x9E3779B97F4A7C15ULL * (unsigned long long)(i + 1);
+        // Attempt to create each thread to run testStack and pass its arguments.
+        if (pthread_create(&threads[i], NULL, testStack, &args[i]) != 0) {
             perror("Failed to create thread"); // If thread creation fails, print error message
+            return EXIT_FAILURE;
         }
     }
     // Wait for all the threads to finish
-    for (int i = 0 ; i < NUM_THREADS ; i++) {
+    for (int i = 0 ; i < workload.threads ; i++) {
         pthread_join(threads[i], NULL); // Block until the current thread terminates
     }
-    fclose(fp); // Close the file after all threads have completed writing to it
-    pthread_mutex_destroy(&mutex); // Destroy the mutex used to synchronize stack access
+    if (fp) {
+        fclose(fp); // Close the file after all threads have completed writing to it
+    }
+    for (int i = 0 ; i < num_stacks ; i++) {
+        while (!is_empty(stacks[i].top)) { // Free whatever the workload left on the stack
+            StackNode *temp = stacks[i].top;
+            stacks[i].top = temp->next;
+            free(temp);
+        }
+        pthread_mutex_destroy(&stacks[i].mutex); // Destroy the mutex used to synchronize stack access
+    }
     pthread_mutex_destroy(&file_mutex); // Destroy the mutex used to synchronize file writing
+    free(stacks);
+    free(args);
+    free(threads);
     // Exit the program
     printf("Program complete.\n");
     return 0;
 }
 
-void push(value_t v, StackNode **top, FILE *fp) {
-    pthread_mutex_lock(&mutex); // Lock the mutex to prevent other threads from accessing the stack concurrently
+void push(value_t v, Stack *stack, FILE *fp) {
+    pthread_mutex_lock(&stack->mutex); // Lock the mutex to prevent other threads from accessing the stack concurrently
     StackNode *new_node = malloc(sizeof(StackNode)); // Allocate the memory for a new stack node
     // Check if the memory allocation was successful
     if (new_node == NULL) {
         // If it wasn't output an error message, release the mutex and exit
         fprintf(stderr, "Failed to allocate memory for new node\n");
-        pthread_mutex_unlock(&mutex);
+        pthread_mutex_unlock(&stack->mutex);
         return;
     }
     new_node->data = v; // Set the data field of the new node to the provided value
-    new_node->next = *top; // Link the new node to the current top of the stack
-    *top = new_node; // Update the top pointer to the new node, making it the new top of the stack
-    pthread_mutex_lock(&file_mutex); // Lock the file mutex to safely write to the file
-    fprintf(fp, "Pushed %d\n", v); // Write an entry to the output file indicating a node has been pushed
-    pthread_mutex_unlock(&file_mutex); // Unlock the file mutex after writing to the file
-    pthread_mutex_unlock(&mutex); // Unlock the main mutex after mutating the stack
+    new_node->next = stack->top; // Link the new node to the current top of the stack
+    stack->top = new_node; // Update the top pointer to the new node, making it the new top of the stack
+    if (fp) { // Skip the output file when logging is off
+        pthread_mutex_lock(&file_mutex); // Lock the file mutex to safely write to the file
+        fprintf(fp, "Pushed %d\n", v); // Write an entry to the output file indicating a node has been pushed
+        pthread_mutex_unlock(&file_mutex); // Unlock the file mutex after writing to the file
+    }
+    pthread_mutex_unlock(&stack->mutex); // Unlock the stack mutex after mutating the stack
 }
 
-value_t pop(StackNode **top, FILE *fp) {
-    pthread_mutex_lock(&mutex); // Lock the mutex to prevent other threads from accessing the stack
-    if (is_empty(*top)) { // Check if the stack is empty before attempting to pop
-        pthread_mutex_unlock(&mutex); // Unlock the mutex before returning to avoid deadlock
+value_t pop(Stack *stack, FILE *fp) {
+    pthread_mutex_lock(&stack->mutex); // Lock the mutex to prevent other threads from accessing the stack
+    if (is_empty(stack->top)) { // Check if the stack is empty before attempting to pop
+        pthread_mutex_unlock(&stack->mutex); // Unlock the mutex before returning to avoid deadlock
         return (value_t)0; // Return a default value indicating the stack was empty
     }
-    value_t data = (*top)->data; // Retrieve the data from the top node of the stack
-    StackNode *temp = *top; // Store the top node in a temporary pointer
-    *top = temp->next; // Update the top pointer to the next node, effectively removing the top node
+    value_t data = stack->top->data; // Retrieve the data from the top node of the stack
+    StackNode *temp = stack->top; // Store the top node in a temporary pointer
+    stack->top = temp->next; // Update the top pointer to the next node, effectively removing the top node
     free(temp); // Free the memory of the node that was just removed from the stack
-    pthread_mutex_lock(&file_mutex); // Lock the file mutex to safely write to the file
-    fprintf(fp, "Popped %d\n", data); // Write an entry to the output file indicating a node has been popped
-    pthread_mutex_unlock(&file_mutex); // Unlock the file mutex
-    pthread_mutex_unlock(&mutex); // Unlock the stack mutex
+    if (fp) { // Skip the output file when logging is off
+        pthread_mutex_lock(&file_mutex); // Lock the file mutex to safely write to the file
+        fprintf(fp, "Popped %d\n", data); // Write an entry to the output file indicating a node has been popped
+        pthread_mutex_unlock(&file_mutex); // Unlock the file mutex
+    }
+    pthread_mutex_unlock(&stack->mutex); // Unlock the stack mutex
     // Return the data that was in the node we popped off the stack
     return data;
 }
@@ -103,33 +172,71 @@ int is_empty(StackNode *top) {
 }
 
 // Entry point for each thread
-// Loop 500 times, executing 3 push and 3 pop operations intermixed
+// Loop 'iterations' times, executing 6 operations per iteration: 3 push and 3 pop operations intermixed in the
+// classic mix, or a random push/pop sequence in the other mixes
 void *testStack(void *arg) {
-    // Convert the void* argument back to a FILE* to use for file operations
-    FILE *fp = (FILE *)arg;
-    // Initialize the top pointer of the stack to NULL, meaning the stack is empty
-    StackNode *top = NULL;
-    // Loop through 3 intermixed push and pop operations 500 times
-    for (int i = 0 ; i < NUM_ITERATIONS ; i++) {
-        // 3 intermixed pushes and pops
-        // 'i * 3 + _' is a way to generate distinct values for each iteration of the loop that are evenly spaced apart
-        push(i * 3 + 1, &top, fp);
-
-        push(i * 3 + 2, &top, fp);
-
-        if (!is_empty(top)) {
-            pop(&top, fp);
-        }
+    // Convert the void* argument back to the thread's arguments
+    ThreadArgs *args = (ThreadArgs *)arg;
+    Stack *stack = args->stack;
+    FILE *fp = args->fp;
+    unsigned long long state = args->seed; // xorshift state for the random mixes, identical to the C++ and Rust drivers
+    for (int i = 0 ; i < workload.iterations ; i++) {
+        if (workload.push_percent == 0) {
+            // 3 intermixed pushes and pops
+            // 'i * 3 + _' is a way to generate distinct values for each iteration of the loop that are evenly spaced apart
+            push(i * 3 + 1, stack, fp);
 
-        push(i * 3 + 3, &top, fp);
+            push(i * 3 + 2, stack, fp);
 
-        if (!is_empty(top)) {
-            pop(&top, fp);
-        }
+            pop(stack, fp); // pop() checks for an empty stack under the lock, so it is safe on a shared stack too
+
+            push(i * 3 + 3, stack, fp);
+
+            pop(stack, fp);
 
-        if (!is_empty(top)) {
-            pop(&top, fp);
+            pop(stack, fp);
+            continue;
+        }
+        for (int j = 0 ; j < 6 ; j++) {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            if ((state * 0x2545F4914F6CDD1DULL >> 32) % 100 < (unsigned long long)workload.push_percent) {
+                push(i * 6 + j, stack, fp);
+            } else {
+                pop(stack, fp);
+            }
         }
     }
     return NULL;
-}
\ No newline at end of file
+}
+
+// Read the workload settings from the command line. Returns 0 on success, or prints usage and returns -1
+int parse_workload(int argc, char *argv[]) {
+    for (int i = 1 ; i < argc ; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value && strcmp(argv[i], "--threads") == 0 && atoi(value) > 0) {
+            workload.threads = atoi(value);
+        } else if (value && strcmp(argv[i], "--iterations") == 0 && atoi(value) >= 0) {
+            workload.iterations = atoi(value);
+        } else if (value && strcmp(argv[i], "--mix") == 0 && strcmp(value, "classic") == 0) {
+            workload.push_percent = 0;
+        } else if (value && strcmp(argv[i], "--mix") == 0 && strcmp(value, "push-heavy") == 0) {
+            workload.push_percent = 80;
+        } else if (value && strcmp(argv[i], "--mix") == 0 && strcmp(value, "balanced") == 0) {
+            workload.push_percent = 50;
+        } else if (value && strcmp(argv[i], "--mix") == 0 && strcmp(value, "pop-heavy") == 0) {
+            workload.push_percent = 20;
+        } else if (value && strcmp(argv[i], "--log") == 0 && (strcmp(value, "on") == 0 || strcmp(value, "off") == 0)) {
+            workload.log = strcmp(value, "on") == 0;
+        } else if (value && strcmp(argv[i], "--mode") == 0 && (strcmp(value, "shared") == 0 || strcmp(value, "per-thread") == 0)) {
+            workload.shared = strcmp(value, "shared") == 0;
+        } else {
+            fprintf(stderr, "Usage: %s [--threads N] [--iterations N] [--mix classic|push-heavy|balanced|pop-heavy] "
+                            "[--log on|off] [--mode per-thread|shared]\n", argv[0]);
+            return -1;
+        }
+        i++; // Skip the value just consumed
+    }
+    return 0;
+}
@@ -0,0 +1,313 @@
+#ifndef ADAPTIVE_STACK_H
+#define ADAPTIVE_STACK_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "cache_line.h"
+#include "elimination_stack.h"
+#include "log_policy.h"
+#include "node_pool.h"
+#include "sharded_stack.h"
+#include "spin_wait.h"
+#include "stack_chain.h"
+#include "stack_stats.h"
+#include "thread_safe_stack.h"
+
+// Define the algorithms an AdaptiveStack switches between.
+enum class StackStrategy : unsigned {
+    Mutex = 0,  // ThreadSafeStack: cheapest while few threads compete for the lock.
+    LockFree = 1,  // EliminationStack: scales when many do.
+};
+
+// Define when an AdaptiveStack samples its counters and when a sample calls for a switch.
+struct AdaptiveThresholds {
+    std::size_t sampleEvery = 1024;  // Operations a thread performs between attempts to take a sample.
+    std::chrono::milliseconds minInterval{10};  // Shortest time between two samples.
+    std::uint64_t minSampleOps = 4096;  // Operations a sample must cover; until then the next one adds to it.
+    double lockFreeAboveWaitNs = 1000.0;  // Switch to lock-free once the mean lock wait in a sample reaches this.
+    double mutexBelowRetries = 0.05;  // Switch back once lost CAS races per operation in a sample fall to this.
+    unsigned confirmSamples = 3;  // Consecutive samples that must call for the switch before it happens.
+};
+
+// Define a snapshot of an AdaptiveStack's decisions, as returned by adaptive_stats().
+struct AdaptiveStats {
+    StackStrategy strategy = StackStrategy::Mutex;  // Strategy in use.
+    std::uint64_t samples = 0;  // Samples evaluated.
+    std::uint64_t toLockFree = 0;  // Switches from the mutex-based to the lock-free stack.
+    std::uint64_t toMutex = 0;  // Switches back.
+    std::uint64_t migratedValues = 0;  // Values moved by all switches together.
+    std::uint64_t migrationNs = 0;  // Time operations were held off by switches, in total.
+    double lastWaitNs = 0.0;  // Mean lock wait in the latest sample taken on the mutex-based stack.
+    double lastRetriesPerOp = 0.0;  // Lost CAS races per operation in the latest sample taken on the lock-free stack.
+};
+
+// Define a stack that runs on a mutex-based ThreadSafeStack while contention is low and on a lock-free
+// EliminationStack while it is high, and moves its values from one to the other as the load changes.
+// Both stacks are instrumented with ContentionStats. Every sampleEvery operations a thread tries to take a sample;
+// one thread at a time does, at most once per minInterval, and compares the active stack's counters with the previous
+// sample: the mean lock wait on the mutex-based stack, lost CAS races per operation on the lock-free one. When
+// confirmSamples samples in a row call for the other stack, the switch happens.
+//
+// Every operation passes a gate: it bumps a counter in one of kStripes cache-line-sized stripes, picked by thread,
+// then reads the strategy. A switch sets the strategy to kMigrating, waits until every stripe is zero, splices all
+// nodes into the other stack in one step, and opens the gate again, so no value is lost, copied or reordered, and
+// LIFO order holds across a switch. Operations that arrive meanwhile wait; a switch moves pointers, not values, so it
+// takes as long as walking the chain once. The gate costs one atomic increment and decrement per operation, on a
+// cache line the thread usually owns, and ContentionStats adds its own timing on top; use a fixed stack where the
+// load is known. A bulk operation passes the gate once, so it moves the sampling countdown by one.
+template<typename T, typename Allocator = PooledNodeAllocator>
+class AdaptiveStack {
+private:
+    using Clock = std::chrono::steady_clock;
+    using Locked = ThreadSafeStack<T, NoLog, Allocator, ContentionStats>;
+    using LockFree = EliminationStack<T, Allocator, ContentionStats>;
+
+    static constexpr unsigned kMigrating = 2;  // Strategy word while a switch is moving the values.
+    static constexpr std::size_t kStripes = 64;  // Gate counters; threads beyond this share them.
+
+    // Define one gate counter, on its own cache line.
+    struct alignas(kCacheLineSize) Stripe {
+        std::atomic<std::size_t> active{0};  // Operations in progress that passed the gate here.
+    };
+
+    Locked locked;  // Holds the values under StackStrategy::Mutex.
+    LockFree lockFree;  // Holds the values under StackStrategy::LockFree.
+    const AdaptiveThresholds thresholds;
+    alignas(kCacheLineSize) std::atomic<unsigned> mode{static_cast<unsigned>(StackStrategy::Mutex)};  // Or kMigrating.
+    Stripe stripes[kStripes];
+
+    mutable std::mutex samplerMutex;  // Held while sampling or switching; protects everything below.
+    Clock::time_point lastSample;  // When the previous sample was taken.
+    StackStats baseline;  // Counters of the active stack at the previous sample or switch.
+    unsigned agreeing = 0;  // Consecutive samples that called for a switch.
+    AdaptiveStats metrics;  // What adaptive_stats() reports.
+    std::atomic<std::uint64_t> movedToMutex{0};  // Values push_chain() counted as pushes; stats() takes them out.
+
+    // Define an operation's pass through the gate. While it exists, the strategy it read cannot change; releasing it
+    // counts the operation towards the next sample.
+    class Pass {
+    private:
+        AdaptiveStack& stack;
+        StackStrategy strategy;
+        Stripe& stripe;
+
+    public:
+        explicit Pass(AdaptiveStack& owner) : stack(owner), strategy(StackStrategy::Mutex), stripe(owner.enter(strategy)) {}
+
+        Pass(const Pass&) = delete;
+        Pass& operator=(const Pass&) = delete;
+
+        ~Pass() {
+            stripe.active.fetch_sub(1, std::memory_order_release);
+            stack.tick();  // After leaving the gate, since a switch waits for every pass to be released.
+        }
+
+        bool lockFree() const { return strategy == StackStrategy::LockFree; }
+    };
+
+    // Announce an operation on the calling thread's stripe and store the strategy it runs on, waiting while a switch
+    // is in progress. The increment and the load are sequentially consistent, as are the store and loads in
+    // migrate(), so either the switch sees the operation or the operation sees the switch.
+    Stripe& enter(StackStrategy& strategy) {
+        Stripe& stripe = stripes[ThreadHome::index() % kStripes];
+        SpinBackoff backoff;
+        for (;;) {
+            stripe.active.fetch_add(1);
+            const unsigned current = mode.load();
+            if (current != kMigrating) {
+                strategy = static_cast<StackStrategy>(current);
+                return stripe;
+            }
+            stripe.active.fetch_sub(1, std::memory_order_release);
+            while (mode.load(std::memory_order_acquire) == kMigrating) backoff.pause();
+        }
+    }
+
+    // Count one operation of the calling thread, and every sampleEvery operations try to take a sample.
+    void tick() {
+        thread_local std::size_t countdown = 0;  // Shared by every AdaptiveStack; it only paces the sampling.
+        if (++countdown < thresholds.sampleEvery) return;
+        countdown = 0;
+        std::unique_lock<std::mutex> lock(samplerMutex, std::try_to_lock);
+        if (lock.owns_lock()) sample();  // Another thread is sampling already otherwise.
+    }
+
+    // Return the counters of the stack that holds the values under strategy.
+    StackStats countersOf(StackStrategy strategy) const {
+        return strategy == StackStrategy::LockFree ? lockFree.stats() : locked.stats();
+    }
+
+    // Compare the active stack's counters with the baseline and switch once enough samples agree. samplerMutex is
+    // held, so the strategy cannot change under us.
+    void sample() {
+        const Clock::time_point now = Clock::now();
+        if (now - lastSample < thresholds.minInterval) return;
+        const auto current = static_cast<StackStrategy>(mode.load(std::memory_order_relaxed));
+        const StackStats counters = countersOf(current);
+        const std::uint64_t ops = counters.ops() - baseline.ops();
+        if (ops < thresholds.minSampleOps) return;  // Too few to judge; let the next sample cover more.
+        bool wantSwitch;
+        if (current == StackStrategy::Mutex) {
+            const std::uint64_t waits = counters.lockWait.samples - baseline.lockWait.samples;
+            const std::uint64_t waitNs = counters.lockWait.totalNs - baseline.lockWait.totalNs;
+            metrics.lastWaitNs = waits == 0 ? 0.0 : static_cast<double>(waitNs) / static_cast<double>(waits);
+            wantSwitch = metrics.lastWaitNs >= thresholds.lockFreeAboveWaitNs;
+        } else {
+            metrics.lastRetriesPerOp = static_cast<double>(counters.casRetries - baseline.casRetries) / static_cast<double>(ops);
+            wantSwitch = metrics.lastRetriesPerOp <= thresholds.mutexBelowRetries;
+        }
+        ++metrics.samples;
+        lastSample = now;
+        baseline = counters;
+        agreeing = wantSwitch ? agreeing + 1 : 0;
+        if (agreeing >= thresholds.confirmSamples) {
+            migrate(current == StackStrategy::Mutex ? StackStrategy::LockFree : StackStrategy::Mutex);
+        }
+    }
+
+    // Close the gate, wait for the operations already past it, move every node to the target stack and reopen the
+    // gate on the target strategy. samplerMutex is held.
+    void migrate(StackStrategy target) {
+        if (mode.load(std::memory_order_relaxed) == static_cast<unsigned>(target)) return;
+        const Clock::time_point start = Clock::now();
+        mode.store(kMigrating);
+        for (Stripe& stripe : stripes) {
+            SpinBackoff backoff;
+            while (stripe.active.load() != 0) backoff.pause();
+        }
+        std::size_t moved;
+        if (target == StackStrategy::LockFree) {
+            StackChain<T, Allocator> chain = locked.drain();  // Nobody else is using either stack now.
+            moved = chain.size();
+            lockFree.stack.adoptChain(std::move(chain));
+            ++metrics.toLockFree;
+        } else {
+            StackChain<T, Allocator> chain = lockFree.stack.detachAll();
+            moved = chain.size();
+            movedToMutex.fetch_add(moved, std::memory_order_relaxed);
+            locked.push_chain(std::move(chain));
+            ++metrics.toMutex;
+        }
+        metrics.migratedValues += moved;
+        baseline = countersOf(target);
+        agreeing = 0;
+        mode.store(static_cast<unsigned>(target), std::memory_order_release);
+        lastSample = Clock::now();
+        metrics.migrationNs += static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(lastSample - start).count());
+    }
+
+public:
+    // Constructor to start on the mutex-based stack with the given thresholds.
+    explicit AdaptiveStack(const AdaptiveThresholds& limits = AdaptiveThresholds()) : thresholds(limits), lastSample(Clock::now()) {}
+
+    AdaptiveStack(const AdaptiveStack&) = delete;
+    AdaptiveStack& operator=(const AdaptiveStack&) = delete;
+
+    // Method to push a copy of a value onto the stack.
+    void push(const T& value) { emplace(value); }
+
+    // Method to push a value onto the stack, moving it into the node.
+    void push(T&& value) { emplace(std::move(value)); }
+
+    // Method to construct a value in place on top of the stack.
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        Pass pass(*this);
+        if (pass.lockFree()) {
+            lockFree.emplace(std::forward<Args>(args)...);
+        } else {
+            locked.emplace(std::forward<Args>(args)...);
+        }
+    }
+
+    // Method to push every value in [first, last); the last value ends up on top.
+    template<typename InputIt>
+    void push_bulk(InputIt first, InputIt last) {
+        Pass pass(*this);
+        if (pass.lockFree()) {
+            lockFree.push_bulk(first, last);
+        } else {
+            locked.push_bulk(first, last);
+        }
+    }
+
+    // Method to pop a value from the stack into out. Returns false, without throwing, if the stack is empty.
+    bool try_pop(T& out) {
+        Pass pass(*this);
+        return pass.lockFree() ? lockFree.try_pop(out) : locked.try_pop(out);
+    }
+
+    // Method to pop a value from the stack. Returns std::nullopt, without throwing, if the stack is empty.
+    std::optional<T> try_pop() {
+        Pass pass(*this);
+        return pass.lockFree() ? lockFree.try_pop() : locked.try_pop();
+    }
+
+    // Method to pop up to n values, writing them to out from the top down.
+    // Returns the number of values popped, which is less than n only if the stack ran out.
+    template<typename OutputIt>
+    std::size_t pop_n(OutputIt out, std::size_t n) {
+        Pass pass(*this);
+        return pass.lockFree() ? lockFree.pop_n(out, n) : locked.pop_n(out, n);
+    }
+
+    // Method to pop a value from the stack. Throws std::runtime_error if the stack is empty; prefer try_pop on hot paths.
+    T pop() {
+        std::optional<T> data = try_pop();
+        if (!data) {  // Check if the stack is empty.
+            std::cerr << "Error: Attempted to pop from an empty stack.\n";  // Log an error message.
+            throw std::runtime_error("Attempted to pop an empty stack.");  // Throw an exception.
+        }
+        return std::move(*data);  // Return the popped data.
+    }
+
+    // Method to clear the stack.
+    void clear() {
+        Pass pass(*this);
+        if (pass.lockFree()) {
+            lockFree.clear();
+        } else {
+            locked.clear();
+        }
+    }
+
+    // Method to switch to a strategy now, regardless of the counters. Must not be called from inside an operation on
+    // this stack, such as a value's destructor.
+    void switch_to(StackStrategy target) {
+        std::lock_guard<std::mutex> lock(samplerMutex);
+        migrate(target);
+    }
+
+    // Method to take a snapshot of the switching decisions and their cost.
+    AdaptiveStats adaptive_stats() const {
+        std::lock_guard<std::mutex> lock(samplerMutex);
+        AdaptiveStats snapshot = metrics;
+        snapshot.strategy = static_cast<StackStrategy>(mode.load(std::memory_order_relaxed));
+        return snapshot;
+    }
+
+    // Method to take a snapshot of both stacks' counters together. Values moved by a switch count once, as the push
+    // that brought them in; the lock wait and hold times come from the time spent on the mutex-based stack.
+    StackStats stats() const {
+        StackStats total = locked.stats();
+        const StackStats other = lockFree.stats();
+        total.pushes += other.pushes - movedToMutex.load(std::memory_order_relaxed);
+        total.pops += other.pops;
+        total.failedPops += other.failedPops;
+        total.casRetries += other.casRetries;
+        total.depth += other.depth;
+        total.peakDepth = std::max(total.peakDepth, other.peakDepth);
+        return total;
+    }
+};
+
+#endif // ADAPTIVE_STACK_H
@@ -0,0 +1,338 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "cache_line.h"
+
+// Define the operations a stack can record.
+enum class LogOp : std::uint8_t {
+    Push,
+    Pop,
+    Clear,  // value is the number of elements removed by clear().
+    Dropped,  // Trailer record; value is the number of records discarded under OverflowPolicy::Count.
+    Rejected,  // Cancels the thread's earlier Push of value, which found a BoundedStack full or threw.
+};
+
+// Define how the writer thread encodes records in the output file.
+enum class LogFormat {
+    Text,  // One "Pushed: N" / "Popped: N" line per record.
+    Binary,  // Raw LogRecord structs, 16 bytes each, in native byte order.
+};
+
+// Define one fixed-size, binary log record. Formatting is deferred to the writer thread.
+struct LogRecord {
+    std::int64_t value;  // Logged value, or its hash when hashed is set.
+    std::uint32_t thread;  // Small sequential id of the logging thread.
+    LogOp op;  // Operation that was performed.
+    bool hashed;  // Whether value holds std::hash of a non-integral payload.
+};
+
+static_assert(sizeof(LogRecord) == 16, "LogRecord is part of the binary trace format");
+
+// Define what a producer does when its ring buffer is full.
+enum class OverflowPolicy {
+    Drop,  // Discard the record silently.
+    Block,  // Wait until the writer has made room.
+    Count,  // Discard the record and report the number of discarded records in the log.
+};
+
+// Convert a stack value into the 64-bit field of a LogRecord: integers and enums are stored as is, anything else is
+// hashed, so the record stays fixed-size regardless of T.
+template<typename T>
+LogRecord makeLogRecord(LogOp op, const T& value, std::uint32_t thread) {
+    if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+        return {static_cast<std::int64_t>(value), thread, op, false};
+    } else {
+        return {static_cast<std::int64_t>(std::hash<T>{}(value)), thread, op, true};
+    }
+}
+
+// Return a small, sequential id for the calling thread; cheaper to log than std::thread::id.
+inline std::uint32_t logThreadId() {
+    static std::atomic<std::uint32_t> nextId{0};
+    thread_local std::uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+// Define a single-producer, single-consumer ring of fixed-size records.
+// Head and tail live on separate cache lines, and each side caches the other's index so it only touches the
+// shared counter when the cached value says the ring looks full (producer) or empty (consumer).
+template<typename Record>
+class SpscRing {
+private:
+    alignas(kCacheLineSize) std::atomic<std::size_t> head{0};  // Next slot the consumer reads.
+    std::size_t cachedTail = 0;  // Consumer's last view of tail.
+    alignas(kCacheLineSize) std::atomic<std::size_t> tail{0};  // Next slot the producer writes.
+    std::size_t cachedHead = 0;  // Producer's last view of head.
+    alignas(kCacheLineSize) std::size_t mask;  // Capacity - 1; capacity is a power of two.
+    std::unique_ptr<Record[]> slots;  // Record storage.
+
+public:
+    // Constructor to allocate a ring that holds at least the given number of records.
+    explicit SpscRing(std::size_t minCapacity) {
+        std::size_t capacity = 2;
+        while (capacity < minCapacity) capacity <<= 1;
+        mask = capacity - 1;
+        slots.reset(new Record[capacity]);
+    }
+
+    // Append a record; returns false if the ring is full. Producer side only.
+    bool tryPush(const Record& record) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask) return false;
+        }
+        slots[t & mask] = record;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Remove up to max records into out; returns how many were taken. Consumer side only.
+    std::size_t popBatch(Record* out, std::size_t max) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (cachedTail == h) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (cachedTail == h) return 0;
+        }
+        std::size_t n = cachedTail - h;
+        if (n > max) n = max;
+        for (std::size_t i = 0; i < n; ++i) out[i] = slots[(h + i) & mask];
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    // Check whether the ring holds no records. Safe to call from either side.
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+};
+
+// Define an asynchronous operation log.
+// Each producing thread gets its own SpscRing the first time it logs through a given AsyncLogger, so log() is a
+// handful of plain stores with no lock and no syscall. A background writer thread drains every ring, encodes the
+// records in the requested LogFormat and writes them in large batches. Records from one thread keep their
+// order; records from different threads are interleaved in drain order, not in the order the stack applied them.
+class AsyncLogger {
+public:
+    static constexpr std::size_t kDefaultRingCapacity = 1024;  // Records buffered per producing thread.
+
+private:
+    using Ring = SpscRing<LogRecord>;
+    static constexpr std::size_t kDrainBatch = 256;  // Records the writer takes from a ring per visit.
+    static constexpr std::size_t kWriteThreshold = 64 * 1024;  // Bytes buffered before the writer calls write().
+
+    // Define one producer's ring plus the flags that let a ring be reused after its thread exits.
+    struct Slot {
+        explicit Slot(std::size_t capacity) : ring(capacity) {}
+        Ring ring;  // Records from the owning thread.
+        std::atomic<bool> abandoned{false};  // Set when the owning thread has exited.
+        std::atomic<bool> closed{false};  // Set when the logger has been destroyed.
+    };
+
+    // Define the calling thread's map from logger id to its ring in that logger.
+    struct ThreadSlots {
+        struct Entry {
+            std::uint64_t loggerId;
+            std::shared_ptr<Slot> slot;
+        };
+        std::vector<Entry> entries;
+
+        // Mark every ring this thread produced into as free for a later thread to adopt.
+        ~ThreadSlots() {
+            for (auto& entry : entries) entry.slot->abandoned.store(true, std::memory_order_release);
+        }
+    };
+
+    const std::uint64_t id;  // Unique id, so a thread's cache never confuses two loggers at the same address.
+    const LogFormat encoding;  // Encoding used by the writer thread.
+    const OverflowPolicy policy;  // Behaviour when a ring is full.
+    const std::size_t ringCapacity;  // Capacity of each per-thread ring.
+    std::ofstream file;  // Destination of the formatted log.
+
+    std::mutex slotsMutex;  // Protects slots and slotsVersion.
+    std::vector<std::shared_ptr<Slot>> slots;  // Every ring created for this logger.
+    std::uint64_t slotsVersion = 0;  // Bumped whenever slots changes, so the writer can refresh its copy lazily.
+
+    std::atomic<std::uint64_t> droppedCount{0};  // Records discarded under OverflowPolicy::Count.
+    std::atomic<bool> running{true};  // Cleared by the destructor to stop the writer.
+    std::mutex wakeMutex;  // Used with wake to let the destructor interrupt the writer's idle wait.
+    std::condition_variable wake;
+    std::thread writer;  // Background thread that drains the rings.
+
+    static std::uint64_t nextLoggerId() {
+        static std::atomic<std::uint64_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    static ThreadSlots& threadSlots() {
+        thread_local ThreadSlots cache;
+        return cache;
+    }
+
+    // Find the calling thread's ring, adopting an idle abandoned ring or creating a new one on first use.
+    Slot& localSlot() {
+        ThreadSlots& cache = threadSlots();
+        for (auto& entry : cache.entries) {
+            if (entry.loggerId == id) return *entry.slot;
+        }
+        cache.entries.erase(std::remove_if(cache.entries.begin(), cache.entries.end(),
+                                           [](const ThreadSlots::Entry& e) { return e.slot->closed.load(std::memory_order_relaxed); }),
+                            cache.entries.end());  // Forget rings of loggers that no longer exist.
+        std::shared_ptr<Slot> slot;
+        {
+            std::lock_guard<std::mutex> lock(slotsMutex);
+            for (auto& candidate : slots) {
+                bool wasAbandoned = true;
+                if (candidate->ring.empty() &&
+                    candidate->abandoned.compare_exchange_strong(wasAbandoned, false, std::memory_order_acq_rel)) {
+                    slot = candidate;
+                    break;
+                }
+            }
+            if (!slot) {
+                slot = std::make_shared<Slot>(ringCapacity);
+                slots.push_back(slot);
+                ++slotsVersion;
+            }
+        }
+        cache.entries.push_back({id, slot});
+        return *slot;
+    }
+
+    // Append the encoded form of a batch of records to the output buffer.
+    void format(std::string& out, const LogRecord* records, std::size_t n) const {
+        if (encoding == LogFormat::Binary) {
+            out.append(reinterpret_cast<const char*>(records), n * sizeof(LogRecord));
+            return;
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            switch (records[i].op) {
+                case LogOp::Push: out += "Pushed: "; break;
+                case LogOp::Pop: out += "Popped: "; break;
+                case LogOp::Clear: out += "Cleared: "; break;
+                case LogOp::Dropped: out += "Dropped: "; break;
+                case LogOp::Rejected: out += "Rejected: "; break;
+            }
+            if (records[i].hashed) out += '#';
+            out += std::to_string(records[i].value);
+            out += '\n';
+        }
+    }
+
+    // Drain every ring once into buf; returns true if any record was found.
+    bool drainOnce(std::vector<std::shared_ptr<Slot>>& local, std::uint64_t& version, std::string& buf) {
+        {
+            std::lock_guard<std::mutex> lock(slotsMutex);
+            if (version != slotsVersion) {
+                local = slots;
+                version = slotsVersion;
+            }
+        }
+        LogRecord batch[kDrainBatch];
+        bool found = false;
+        for (auto& slot : local) {
+            std::size_t n;
+            while ((n = slot->ring.popBatch(batch, kDrainBatch)) != 0) {
+                format(buf, batch, n);
+                found = true;
+                if (buf.size() >= kWriteThreshold) {
+                    file.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+                    buf.clear();
+                }
+            }
+        }
+        return found;
+    }
+
+    // Body of the writer thread.
+    void writerLoop() {
+        std::vector<std::shared_ptr<Slot>> local;
+        std::uint64_t version = ~std::uint64_t{0};
+        std::string buf;
+        buf.reserve(2 * kWriteThreshold);
+        while (running.load(std::memory_order_acquire)) {
+            if (!drainOnce(local, version, buf)) {
+                if (!buf.empty()) {  // Going idle: hand what we have to the OS.
+                    file.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+                    file.flush();
+                    buf.clear();
+                }
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wake.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+        while (drainOnce(local, version, buf)) {}  // Producers are done; take everything that is left.
+        if (std::uint64_t drops = droppedCount.load(std::memory_order_relaxed)) {  // Make data loss visible in the trace.
+            if (encoding == LogFormat::Binary) {
+                const LogRecord trailer{static_cast<std::int64_t>(drops), logThreadId(), LogOp::Dropped, false};
+                format(buf, &trailer, 1);
+            } else {
+                buf += "Dropped: " + std::to_string(drops) + " records\n";
+            }
+        }
+        file.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        file.flush();
+    }
+
+public:
+    // Constructor to open the log file and start the writer thread.
+    explicit AsyncLogger(const std::string& path, LogFormat format = LogFormat::Text,
+                         OverflowPolicy overflow = OverflowPolicy::Block, std::size_t capacity = kDefaultRingCapacity)
+        : id(nextLoggerId()), encoding(format), policy(overflow), ringCapacity(capacity) {
+        file.open(path, std::ios::out | std::ios::binary);  // Open the output file for logging.
+        if (!file.is_open()) {  // Check if the file opened successfully.
+            throw std::runtime_error("Unable to open file");  // Throw an exception if the file cannot be opened.
+        }
+        writer = std::thread(&AsyncLogger::writerLoop, this);
+    }
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    // Destructor to drain every ring, stop the writer and close the file. No thread may log concurrently.
+    ~AsyncLogger() {
+        running.store(false, std::memory_order_release);
+        wake.notify_one();
+        writer.join();
+        std::lock_guard<std::mutex> lock(slotsMutex);
+        for (auto& slot : slots) slot->closed.store(true, std::memory_order_relaxed);
+    }
+
+    // Record one operation. Never takes a lock or performs I/O on the calling thread, except that the very first
+    // record a thread writes registers its ring.
+    template<typename T>
+    void log(LogOp op, const T& value) {
+        Slot& slot = localSlot();
+        const LogRecord record = makeLogRecord(op, value, logThreadId());
+        if (slot.ring.tryPush(record)) return;
+        switch (policy) {
+            case OverflowPolicy::Drop:
+                break;
+            case OverflowPolicy::Count:
+                droppedCount.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case OverflowPolicy::Block:
+                while (!slot.ring.tryPush(record)) std::this_thread::yield();
+                break;
+        }
+    }
+
+    // Report how many records have been discarded under OverflowPolicy::Count.
+    std::uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+};
+
+#endif // ASYNC_LOG_H
@@ -0,0 +1,230 @@
+#ifndef BOUNDED_STACK_H
+#define BOUNDED_STACK_H
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "cache_line.h"
+#include "lock_policy.h"
+#include "log_policy.h"
+#include "wait_queue.h"
+
+// Define a generic, thread-safe stack with a fixed capacity. All storage is allocated once, in the constructor, as
+// one contiguous array of slots, so pushes and pops never allocate and the stack can never use more memory than it
+// was given. A full stack pushes back on producers: try_push() fails, push() sleeps until a pop makes room and
+// push_for() sleeps up to a timeout. Consumers wait the same way on an empty stack. Sleepers park in a WaitQueue
+// and, as in ThreadSafeStack, a push or pop only signals when someone is actually waiting.
+// An optional high-water callback reports when the stack fills past a threshold, so a producer can shed load before
+// it blocks. Values live in their slots, so they are constructed and moved out under the lock, as in SegmentedStack.
+// Logging never runs under the lock: a push is recorded from its argument before the lock is taken, as in
+// ThreadSafeStack, and a pop after the lock is released. A try_push() or push_for() that finds the stack full, or a
+// push whose copy or move throws, then records LogOp::Rejected for the same value, which cancels that push.
+template<typename T, typename LogPolicy = TextLog, typename LockPolicy = PthreadLock>
+class BoundedStack : private LogPolicy {
+private:
+    using Held = typename LockPolicy::QueueNode;  // Per-acquisition lock state, kept on the caller's stack frame.
+
+    std::allocator<T> storage;  // Source of the slot array; stateless.
+    const std::size_t limit;  // Number of slots.
+    T* slots;  // Slot array, filled from index 0 upward.
+    // The fields written under the lock start a cache line of their own, as in ThreadSafeStack; the wait queues and
+    // the callback, touched only when someone waits or the mark is crossed, come after them on lines of their own.
+    alignas(kCacheLineSize) std::size_t used;  // Number of constructed elements.
+    std::size_t waitingPushers;  // Producers parked, or about to park, in notFull. Protected by mutex.
+    std::size_t waitingPoppers;  // Consumers parked, or about to park, in notEmpty. Protected by mutex.
+    std::size_t highWater;  // Depth at which onHighWater fires; 0 disables it.
+    bool highWaterArmed;  // Whether the next push that reaches highWater fires the callback. Protected by mutex.
+    LockPolicy mutex;  // Lock to ensure thread safety during operations.
+    alignas(kCacheLineSize) WaitQueue notFull;  // Where push() and push_for() sleep until a pop makes room.
+    WaitQueue notEmpty;  // Where wait_pop() and wait_pop_for() sleep until a push arrives.
+    std::function<void(std::size_t)> onHighWater;  // Called with the depth, outside the lock.
+
+    // Sleep in queue until ready() holds or deadline passes; nullptr waits without one. Enters and leaves with the
+    // mutex held. Returns false on timeout, leaving ready() false.
+    template<typename Ready>
+    bool waitLocked(Held& held, WaitQueue& queue, std::size_t& waiters, const timespec* deadline, Ready ready) {
+        if (ready()) return true;
+        ++waiters;  // Read under the lock by the other side, so it sees us before we sleep.
+        bool ok = true;
+        while (!ready()) {
+            queue.prepare();
+            mutex.unlock(held);
+            const bool woken = queue.park(deadline);
+            mutex.lock(held);
+            if (!woken && !ready()) {
+                ok = false;  // Timed out.
+                break;
+            }
+        }
+        --waiters;
+        return ok;
+    }
+
+    // Push a value, waiting for room if wait is set. Returns false if the stack stayed full.
+    template<typename U>
+    bool pushValue(U&& value, bool wait, const timespec* deadline) {
+        LogPolicy::record(LogOp::Push, value);  // Log while the value is still private; once pushed it may be popped.
+        Held held;
+        mutex.lock(held);  // Lock the mutex before modifying the stack.
+        const auto hasRoom = [this] { return used < limit; };
+        if (!(wait ? waitLocked(held, notFull, waitingPushers, deadline, hasRoom) : hasRoom())) {
+            mutex.unlock(held);
+            LogPolicy::record(LogOp::Rejected, value);  // Withdraw the push recorded above.
+            return false;  // The stack was full.
+        }
+        try {
+            new (slots + used) T(std::forward<U>(value));
+        } catch (...) {
+            const bool passOn = waitingPushers != 0;  // The wakeup a pop sent may have been ours; the slot is free.
+            mutex.unlock(held);
+            if (passOn) notFull.notify();
+            LogPolicy::record(LogOp::Rejected, value);
+            throw;
+        }
+        ++used;
+        const std::size_t depth = used;
+        const bool fire = highWaterArmed && highWater != 0 && depth >= highWater;
+        if (fire) highWaterArmed = false;  // Re-armed once the stack drains to half the mark.
+        const bool wake = waitingPoppers != 0;
+        mutex.unlock(held);  // Unlock the mutex after modifying the stack.
+        if (wake) notEmpty.notify();
+        if (fire) onHighWater(depth);
+        return true;
+    }
+
+    // Pop a value, waiting for one if wait is set. Returns std::nullopt if the stack stayed empty.
+    std::optional<T> popValue(bool wait, const timespec* deadline) {
+        Held held;
+        mutex.lock(held);  // Lock the mutex before modifying the stack.
+        const auto hasValue = [this] { return used != 0; };
+        if (!(wait ? waitLocked(held, notEmpty, waitingPoppers, deadline, hasValue) : hasValue())) {
+            mutex.unlock(held);
+            return std::nullopt;  // The stack was empty.
+        }
+        T* slot = slots + used - 1;
+        std::optional<T> data(std::move(*slot));
+        slot->~T();
+        --used;
+        if (used <= highWater / 2) highWaterArmed = true;
+        const bool wake = waitingPushers != 0;
+        mutex.unlock(held);  // Unlock the mutex after modifying the stack.
+        if (wake) notFull.notify();
+        LogPolicy::record(LogOp::Pop, *data);  // Log the pop operation outside the lock.
+        return data;
+    }
+
+public:
+    static constexpr std::size_t kDefaultCapacity = 1024;  // Capacity of a default-constructed stack.
+
+    // Constructor to create an empty stack with room for kDefaultCapacity values.
+    BoundedStack() : BoundedStack(kDefaultCapacity) {}
+
+    // Constructor to create an empty stack with room for capacity values, allocated up front. Any further arguments
+    // go to the log policy, e.g. a trace file path. Throws std::invalid_argument if capacity is 0.
+    template<typename... LogArgs>
+    explicit BoundedStack(std::size_t capacity, LogArgs&&... logArgs)
+        : LogPolicy(std::forward<LogArgs>(logArgs)...), limit(capacity), slots(nullptr), used(0), waitingPushers(0),
+          waitingPoppers(0), highWater(0), highWaterArmed(true) {
+        if (capacity == 0) throw std::invalid_argument("BoundedStack capacity must be at least 1.");
+        slots = storage.allocate(capacity);
+    }
+
+    BoundedStack(const BoundedStack&) = delete;
+    BoundedStack& operator=(const BoundedStack&) = delete;
+
+    // Destructor to clean up resources.
+    ~BoundedStack() {
+        clear();  // Destroy the elements.
+        storage.deallocate(slots, limit);
+    }
+
+    // Method to register a callback that runs when a push brings the depth to mark or beyond. It fires once, then
+    // again only after the stack has drained to mark / 2, so a stack hovering at the mark does not fire on every
+    // push. It runs on the pushing thread after the lock is released. A mark of 0 disables it. Call before the stack
+    // is shared.
+    void set_high_water(std::size_t mark, std::function<void(std::size_t)> callback) {
+        highWater = mark;
+        onHighWater = std::move(callback);
+        highWaterArmed = true;
+    }
+
+    // Method to return the number of values the stack can hold.
+    std::size_t capacity() const { return limit; }
+
+    // Method to push a value if there is room. Returns false, without waiting, if the stack is full.
+    bool try_push(const T& value) { return pushValue(value, false, nullptr); }
+    bool try_push(T&& value) { return pushValue(std::move(value), false, nullptr); }
+
+    // Method to push a value, sleeping until a pop makes room if the stack is full.
+    void push(const T& value) { pushValue(value, true, nullptr); }
+    void push(T&& value) { pushValue(std::move(value), true, nullptr); }
+
+    // Method to push a value, sleeping up to timeout for room if the stack is full. Returns false if it stayed full.
+    template<typename Rep, typename Period>
+    bool push_for(const T& value, const std::chrono::duration<Rep, Period>& timeout) {
+        const timespec deadline = WaitQueue::deadlineAfter(timeout);
+        return pushValue(value, true, &deadline);
+    }
+    template<typename Rep, typename Period>
+    bool push_for(T&& value, const std::chrono::duration<Rep, Period>& timeout) {
+        const timespec deadline = WaitQueue::deadlineAfter(timeout);
+        return pushValue(std::move(value), true, &deadline);
+    }
+
+    // Method to pop a value from the stack into out. Returns false, without throwing, if the stack is empty.
+    bool try_pop(T& out) {
+        std::optional<T> data = popValue(false, nullptr);
+        if (!data) return false;  // The stack was empty.
+        out = std::move(*data);
+        return true;
+    }
+
+    // Method to pop a value from the stack. Returns std::nullopt, without throwing, if the stack is empty.
+    std::optional<T> try_pop() { return popValue(false, nullptr); }
+
+    // Method to pop a value from the stack. Throws std::runtime_error if the stack is empty; prefer try_pop on hot paths.
+    T pop() {
+        std::optional<T> data = try_pop();
+        if (!data) {  // Check if the stack is empty.
+            std::cerr << "Error: Attempted to pop from an empty stack.\n";  // Log an error message.
+            throw std::runtime_error("Attempted to pop an empty stack.");  // Throw an exception.
+        }
+        return std::move(*data);  // Return the popped data.
+    }
+
+    // Method to pop a value from the stack, sleeping until a value is pushed if the stack is empty.
+    T wait_pop() { return std::move(*popValue(true, nullptr)); }
+
+    // Method to pop a value from the stack, sleeping up to timeout for a push if the stack is empty.
+    // Returns std::nullopt, without throwing, if the stack is still empty when the timeout expires.
+    template<typename Rep, typename Period>
+    std::optional<T> wait_pop_for(const std::chrono::duration<Rep, Period>& timeout) {
+        const timespec deadline = WaitQueue::deadlineAfter(timeout);
+        return popValue(true, &deadline);
+    }
+
+    // Method to clear the stack. The values are destroyed in place, so unlike the node-based stacks this happens
+    // under the lock.
+    void clear() {
+        Held held;
+        mutex.lock(held);  // Lock the mutex before modifying the stack.
+        const std::size_t removed = used;
+        while (used != 0) slots[--used].~T();
+        highWaterArmed = true;
+        const std::size_t wake = waitingPushers;
+        mutex.unlock(held);  // Unlock the mutex after modifying the stack.
+        if (wake != 0) notFull.notify(wake);
+        if (removed != 0) {
+            LogPolicy::record(LogOp::Clear, removed);
+        }
+    }
+};
+
+#endif // BOUNDED_STACK_H
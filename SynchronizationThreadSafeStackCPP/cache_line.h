@@ -0,0 +1,21 @@
+#ifndef CACHE_LINE_H
+#define CACHE_LINE_H
+
+#include <cstddef>
+#include <new>
+
+// Define the distance that keeps two independently written fields from false-sharing, used for every alignas() in
+// the stacks. Where std::hardware_destructive_interference_size is a stable constant it is used directly. GCC
+// derives it from -mtune and warns that it may change between builds, which would change class layouts, so there
+// the value is fixed at 64 bytes, the line size of current x86-64 and most AArch64 cores. Define
+// STACK_CACHE_LINE_SIZE to override it, e.g. 128 for Apple silicon or for x86 parts whose adjacent-line prefetcher
+// pulls in pairs of lines.
+#if defined(STACK_CACHE_LINE_SIZE)
+inline constexpr std::size_t kCacheLineSize = STACK_CACHE_LINE_SIZE;
+#elif defined(__cpp_lib_hardware_interference_size) && (!defined(__GNUC__) || defined(__clang__))
+inline constexpr std::size_t kCacheLineSize = std::hardware_destructive_interference_size;
+#else
+inline constexpr std::size_t kCacheLineSize = 64;
+#endif
+
+#endif // CACHE_LINE_H
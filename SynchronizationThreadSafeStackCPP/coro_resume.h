@@ -0,0 +1,30 @@
+#ifndef CORO_RESUME_H
+#define CORO_RESUME_H
+
+#include <coroutine>
+
+// Define where a coroutine suspended in an async_pop() resumes once a value has been handed to it.
+// inlineOnPusher() resumes it directly on the thread whose push delivered the value, before that push returns; on()
+// passes it to an executor, any object with a schedule(std::coroutine_handle<>) method, which must outlive the wait.
+// The target is two words kept in the suspended awaiter, so waiting allocates nothing.
+struct ResumeTarget {
+    void (*schedule)(void* executor, std::coroutine_handle<> handle);  // Type-erased executor call.
+    void* executor;  // Executor passed to schedule, or nullptr for inline resumption.
+
+    // Resume handle on this target.
+    void operator()(std::coroutine_handle<> handle) const { schedule(executor, handle); }
+
+    // Return the target that resumes the coroutine on the pushing thread.
+    static ResumeTarget inlineOnPusher() {
+        return {[](void*, std::coroutine_handle<> handle) { handle.resume(); }, nullptr};
+    }
+
+    // Return the target that hands the coroutine to executor.schedule().
+    template<typename Executor>
+    static ResumeTarget on(Executor& executor) {
+        return {[](void* target, std::coroutine_handle<> handle) { static_cast<Executor*>(target)->schedule(handle); },
+                &executor};
+    }
+};
+
+#endif // CORO_RESUME_H
@@ -0,0 +1,223 @@
+#ifndef ELIMINATION_STACK_H
+#define ELIMINATION_STACK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "cache_line.h"
+#include "lock_free_stack.h"
+#include "node_pool.h"
+#include "spin_wait.h"
+#include "stack_node.h"
+#include "stack_stats.h"
+
+// Define a lock-free stack with an elimination-backoff array in front of a LockFreeStack.
+// Every operation first tries a single CAS on the shared top. When that CAS loses a race, instead of retrying on the
+// contended cache line straight away, the thread visits a random slot of the elimination array and waits there for a
+// short, bounded time. A push and a pop that meet in a slot cancel out: the pusher's node is handed straight to the
+// popper and top is never touched. Both operations remain linearizable, at the moment of the exchange, because a
+// push immediately followed by a pop leaves the stack unchanged.
+// The StatsPolicy (see stack_stats.h) counts operations, depth and lost CAS races on top; a push or pop that goes to
+// the elimination array after its CAS lost counts one retry for every lost CAS, whether or not a partner turns up.
+template<typename T, typename Allocator = PooledNodeAllocator, typename StatsPolicy = NoStats>
+class EliminationStack {
+public:
+    static constexpr std::size_t kDefaultSlots = 16;  // Elimination array size.
+    static constexpr std::size_t kDefaultSpins = 256;  // Pause iterations a thread waits in a slot before giving up.
+
+private:
+    using Node = StackNode<T>;
+
+    // Slot encoding, all in one word:
+    //   kEmpty          - nobody is waiting;
+    //   kPopWaiting     - a popper is waiting for a node;
+    //   node            - a pusher is offering node (nodes are at least 8-byte aligned, so the low bit is clear);
+    //   node | kHandOff - a pusher has delivered node to the waiting popper, who will reset the slot.
+    static constexpr std::uintptr_t kEmpty = 0;
+    static constexpr std::uintptr_t kPopWaiting = 1;
+    static constexpr std::uintptr_t kHandOff = 1;
+
+    // Define one elimination slot, padded so neighbouring slots never share a cache line.
+    struct alignas(kCacheLineSize) Slot {
+        std::atomic<std::uintptr_t> word{kEmpty};
+    };
+
+    template<typename, typename> friend class AdaptiveStack;  // Moves the backing stack's nodes when it switches.
+
+    using Backing = LockFreeStack<T, Allocator, StatsPolicy>;
+    Backing stack;  // Backing Treiber stack.
+    std::unique_ptr<Slot[]> slots;  // Elimination array.
+    const std::size_t slotCount;  // Number of slots in the array.
+    const std::size_t spinLimit;  // How long a thread waits in a slot.
+
+    // Pick the slot a backing-off thread will visit.
+    Slot& randomSlot() { return slots[fastRandom() % slotCount]; }
+
+    // Try to hand node to a popper through the elimination array. Returns true if a popper took it.
+    bool eliminatePush(Node* node) {
+        Slot& slot = randomSlot();
+        const auto offer = reinterpret_cast<std::uintptr_t>(node);
+        std::uintptr_t seen = slot.word.load(std::memory_order_relaxed);
+        if (seen == kPopWaiting) {  // A popper is already waiting: deliver directly.
+            return slot.word.compare_exchange_strong(seen, offer | kHandOff, std::memory_order_release,
+                                                     std::memory_order_relaxed);
+        }
+        if (seen != kEmpty ||
+            !slot.word.compare_exchange_strong(seen, offer, std::memory_order_release, std::memory_order_relaxed)) {
+            return false;  // Slot busy; go back to the stack.
+        }
+        for (std::size_t i = 0; i < spinLimit; ++i) {  // Wait for a popper to take the offer.
+            if (slot.word.load(std::memory_order_acquire) != offer) return true;
+            cpuRelax();
+        }
+        std::uintptr_t expected = offer;  // Timed out: withdraw unless a popper got there first.
+        return !slot.word.compare_exchange_strong(expected, kEmpty, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    // Try to take a node from a pusher through the elimination array. Returns the node, or nullptr.
+    Node* eliminatePop() {
+        Slot& slot = randomSlot();
+        std::uintptr_t seen = slot.word.load(std::memory_order_acquire);
+        if (seen != kEmpty && seen != kPopWaiting && (seen & kHandOff) == 0) {  // A pusher is offering a node.
+            if (slot.word.compare_exchange_strong(seen, kEmpty, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return reinterpret_cast<Node*>(seen);
+            }
+            return nullptr;
+        }
+        if (seen != kEmpty ||
+            !slot.word.compare_exchange_strong(seen, kPopWaiting, std::memory_order_relaxed, std::memory_order_relaxed)) {
+            return nullptr;  // Slot busy; go back to the stack.
+        }
+        for (std::size_t i = 0; i < spinLimit; ++i) {  // Wait for a pusher to deliver.
+            std::uintptr_t word = slot.word.load(std::memory_order_acquire);
+            if (word != kPopWaiting) {
+                slot.word.store(kEmpty, std::memory_order_relaxed);  // Only the waiting popper resets a delivery.
+                return reinterpret_cast<Node*>(word & ~kHandOff);
+            }
+            cpuRelax();
+        }
+        std::uintptr_t expected = kPopWaiting;  // Timed out: withdraw unless a pusher delivered meanwhile.
+        if (slot.word.compare_exchange_strong(expected, kEmpty, std::memory_order_acquire, std::memory_order_acquire)) {
+            return nullptr;
+        }
+        slot.word.store(kEmpty, std::memory_order_relaxed);
+        return reinterpret_cast<Node*>(expected & ~kHandOff);
+    }
+
+    // Publish a node, alternating between the stack and the elimination array until one of them accepts it.
+    void pushNode(Node* node) {
+        std::size_t retries = 0;
+        stack.adjustDepth(1);  // Count the node before it is visible, so depth never dips below zero.
+        while (!stack.tryPushNode(node)) {
+            ++retries;
+            if (eliminatePush(node)) break;
+        }
+        stack.countCasRetries(retries);
+        stack.countPush();
+    }
+
+    // Obtain a node, alternating between the stack and the elimination array. Returns nullptr if the stack is empty.
+    // eliminated reports whether the node came from a pusher directly (and so was never visible to other threads).
+    Node* popNode(bool& eliminated) {
+        for (std::size_t retries = 0;; ++retries) {
+            Node* node;
+            if (stack.tryPopNode(node)) {
+                eliminated = false;
+            } else if ((node = eliminatePop()) != nullptr) {
+                eliminated = true;
+            } else {
+                continue;
+            }
+            stack.countCasRetries(retries + (eliminated ? 1 : 0));
+            if (node == nullptr) {
+                stack.countFailedPop();
+            } else {
+                stack.countPop();
+                stack.adjustDepth(-1);
+            }
+            return node;
+        }
+    }
+
+    // Dispose of a node whose payload has been moved out.
+    void releaseNode(Node* node, bool eliminated) {
+        if (eliminated) {
+            Allocator::destroy(node);  // No other thread ever saw this node.
+        } else {
+            stack.domain.retire(node, &Backing::destroyNode);  // Concurrent pops may still read it.
+        }
+    }
+
+public:
+    // Constructor to initialize the stack with the given elimination array size and per-slot wait.
+    explicit EliminationStack(std::size_t arraySize = kDefaultSlots, std::size_t spins = kDefaultSpins,
+                              EpochDomain& reclaimDomain = EpochDomain::global())
+        : stack(reclaimDomain), slots(new Slot[arraySize == 0 ? 1 : arraySize]),
+          slotCount(arraySize == 0 ? 1 : arraySize), spinLimit(spins) {}
+
+    EliminationStack(const EliminationStack&) = delete;
+    EliminationStack& operator=(const EliminationStack&) = delete;
+
+    // Method to push a copy of a value onto the stack.
+    void push(const T& value) { emplace(value); }
+
+    // Method to push a value onto the stack, moving it into the node.
+    void push(T&& value) { emplace(std::move(value)); }
+
+    // Method to construct a value in place on top of the stack.
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        pushNode(Allocator::template create<Node>(std::forward<Args>(args)...));
+    }
+
+    // Method to pop a value from the stack into out. Returns false, without throwing, if the stack is empty.
+    bool try_pop(T& out) {
+        bool eliminated;
+        Node* node = popNode(eliminated);
+        if (node == nullptr) return false;  // The stack was empty.
+        out = std::move(node->data);
+        releaseNode(node, eliminated);
+        return true;
+    }
+
+    // Method to pop a value from the stack. Returns std::nullopt, without throwing, if the stack is empty.
+    std::optional<T> try_pop() {
+        bool eliminated;
+        Node* node = popNode(eliminated);
+        if (node == nullptr) return std::nullopt;  // The stack was empty.
+        std::optional<T> data(std::move(node->data));
+        releaseNode(node, eliminated);
+        return data;
+    }
+
+    // Method to pop a value from the stack. Throws std::runtime_error if the stack is empty; prefer try_pop on hot paths.
+    T pop() {
+        std::optional<T> data = try_pop();
+        if (!data) {  // Check if the stack is empty.
+            std::cerr << "Error: Attempted to pop from an empty stack.\n";  // Log an error message.
+            throw std::runtime_error("Attempted to pop an empty stack.");  // Throw an exception.
+        }
+        return std::move(*data);  // Return the popped data.
+    }
+
+    // Bulk operations go straight to the backing stack; a single CAS already amortizes their contention.
+    template<typename InputIt>
+    void push_bulk(InputIt first, InputIt last) { stack.push_bulk(first, last); }
+
+    template<typename OutputIt>
+    std::size_t pop_n(OutputIt out, std::size_t n) { return stack.pop_n(out, n); }
+
+    // Method to clear the stack.
+    void clear() { stack.clear(); }
+
+    // Method to take a snapshot of the instrumentation counters. All zero unless StatsPolicy is ContentionStats.
+    StackStats stats() const { return stack.stats(); }
+};
+
+#endif // ELIMINATION_STACK_H
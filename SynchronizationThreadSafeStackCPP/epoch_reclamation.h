@@ -0,0 +1,306 @@
+#ifndef EPOCH_RECLAMATION_H
+#define EPOCH_RECLAMATION_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "cache_line.h"
+
+// Define a snapshot of the counters kept by an EpochDomain.
+struct ReclaimStats {
+    std::uint64_t epoch = 0;  // Current global epoch.
+    std::uint64_t retired = 0;  // Objects handed to retire() so far.
+    std::uint64_t reclaimed = 0;  // Objects whose deleter has run.
+    std::uint64_t pending = 0;  // Objects retired but not yet freed (retired - reclaimed).
+    std::uint64_t batches = 0;  // Number of batched frees performed.
+    std::uint64_t avgReclaimLatencyNs = 0;  // Mean time from retire to free per object, timed from its run's first retire.
+    std::uint64_t maxReclaimLatencyNs = 0;  // Worst time from retire to free seen so far.
+};
+
+// Define an epoch-based reclamation domain.
+// Readers wrap every access to shared nodes in an EpochDomain::Guard, which announces the global epoch the thread
+// entered in. Writers that unlink a node call retire() instead of deleting it; the node goes on the calling thread's
+// retire list, tagged with the current epoch. Once every active thread has caught up with the global epoch it is
+// advanced, and anything retired two epochs ago can no longer be reachable by any reader, so it is freed in one batch.
+// The domain is container-agnostic: retire() takes a type-erased pointer and a deleter, so any structure in this
+// repository can share it. A domain must outlive every thread that used it; global() is never destroyed.
+class EpochDomain {
+public:
+    using Deleter = void (*)(void*);  // Type-erased function that frees one retired object.
+
+    static constexpr std::size_t kDefaultBatchSize = 64;  // Retired objects a thread buffers before it tries to free.
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr std::uint64_t kInactive = ~std::uint64_t{0};  // Announced epoch of a thread outside any guard.
+
+    // Define one object waiting for its grace period to pass.
+    struct Retired {
+        void* ptr;  // Object to free.
+        Deleter deleter;  // Function that frees it.
+    };
+
+    // Define a run of consecutive retire list entries that were retired in the same epoch.
+    struct Segment {
+        std::uint64_t epoch;  // Epoch the entries were retired in.
+        std::size_t count;  // Number of entries in the run.
+        Clock::time_point firstRetire;  // When the first entry of the run was retired.
+    };
+
+    // Define the per-thread state. Records are padded to a cache line so announcing an epoch never false-shares.
+    struct alignas(kCacheLineSize) ThreadRecord {
+        std::atomic<std::uint64_t> epoch{kInactive};  // Epoch announced by the owning thread, or kInactive.
+        std::atomic<bool> inUse{false};  // Whether a live thread currently owns this record.
+        ThreadRecord* nextRecord = nullptr;  // Next record in the domain's registry; immutable once linked.
+        unsigned nesting = 0;  // Depth of nested guards held by the owner.
+        std::deque<Retired> retired;  // Objects retired by the owner, oldest first.
+        std::deque<Segment> segments;  // Epoch runs over retired, oldest first.
+        std::atomic<std::uint64_t> retiredCount{0};  // Objects retired by the owner (written by the owner only).
+        std::atomic<std::uint64_t> reclaimedCount{0};  // Objects freed from this record's list.
+    };
+
+    // Define the thread-local cache that maps domains to the record this thread owns in each of them.
+    struct ThreadCache {
+        struct Entry {
+            EpochDomain* domain;
+            ThreadRecord* record;
+        };
+        std::vector<Entry> entries;
+
+        // Give every owned record back to its domain when the thread exits.
+        ~ThreadCache() {
+            for (auto& entry : entries) {
+                entry.domain->releaseRecord(entry.record);
+            }
+        }
+    };
+
+    std::atomic<std::uint64_t> globalEpoch{0};  // Epoch counter advanced once all active threads have observed it.
+    std::atomic<ThreadRecord*> records{nullptr};  // Push-only registry of thread records.
+    std::size_t batchSize;  // Retired objects buffered per thread before a collection is attempted.
+
+    std::mutex orphanMutex;  // Protects the garbage left behind by exited threads.
+    std::deque<Retired> orphans;  // Garbage inherited from exited threads, oldest first.
+    std::deque<Segment> orphanSegments;  // Epoch runs over orphans.
+    std::atomic<std::size_t> orphanCount{0};  // Size of orphans, readable without the mutex.
+    std::atomic<std::uint64_t> orphanReclaimed{0};  // Objects freed from the orphan list.
+
+    std::atomic<std::uint64_t> batchCount{0};  // Number of batched frees performed.
+    std::atomic<std::uint64_t> latencyTotalNs{0};  // Sum of per-run retire-to-free latencies, weighted by run size.
+    std::atomic<std::uint64_t> latencyMaxNs{0};  // Largest per-batch retire-to-free latency.
+
+    // Access the calling thread's domain-to-record cache.
+    static ThreadCache& threadCache() {
+        thread_local ThreadCache cache;
+        return cache;
+    }
+
+    // Find this thread's record in the domain, claiming or allocating one on first use.
+    ThreadRecord& localRecord() {
+        ThreadCache& cache = threadCache();
+        for (auto& entry : cache.entries) {
+            if (entry.domain == this) return *entry.record;
+        }
+        ThreadRecord* record = acquireRecord();
+        cache.entries.push_back({this, record});
+        return *record;
+    }
+
+    // Claim a record left behind by an exited thread, or link a new one into the registry.
+    ThreadRecord* acquireRecord() {
+        for (ThreadRecord* record = records.load(std::memory_order_acquire); record != nullptr; record = record->nextRecord) {
+            bool expected = false;
+            if (!record->inUse.load(std::memory_order_relaxed) &&
+                record->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+        auto record = new ThreadRecord();
+        record->inUse.store(true, std::memory_order_relaxed);
+        ThreadRecord* head = records.load(std::memory_order_relaxed);
+        do {
+            record->nextRecord = head;
+        } while (!records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+        return record;
+    }
+
+    // Hand an exiting thread's pending garbage to the orphan list and make its record claimable again.
+    void releaseRecord(ThreadRecord* record) {
+        record->epoch.store(kInactive, std::memory_order_release);
+        record->nesting = 0;
+        if (!record->retired.empty()) {
+            std::lock_guard<std::mutex> lock(orphanMutex);
+            orphans.insert(orphans.end(), record->retired.begin(), record->retired.end());
+            orphanSegments.insert(orphanSegments.end(), record->segments.begin(), record->segments.end());
+            orphanCount.store(orphans.size(), std::memory_order_relaxed);
+            record->retired.clear();
+            record->segments.clear();
+        }
+        record->inUse.store(false, std::memory_order_release);
+    }
+
+    // Advance the global epoch if every active thread has announced the current one.
+    bool tryAdvance() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // Pairs with the fence in Guard so announcements are seen.
+        std::uint64_t current = globalEpoch.load(std::memory_order_acquire);
+        for (ThreadRecord* record = records.load(std::memory_order_acquire); record != nullptr; record = record->nextRecord) {
+            std::uint64_t announced = record->epoch.load(std::memory_order_acquire);
+            if (announced != kInactive && announced != current) return false;  // A reader is still in an older epoch.
+        }
+        return globalEpoch.compare_exchange_strong(current, current + 1, std::memory_order_acq_rel);
+    }
+
+    // Free every leading run of a retire list whose grace period has passed; return the number of objects freed.
+    std::size_t freeExpired(std::deque<Retired>& list, std::deque<Segment>& runs) {
+        const std::uint64_t current = globalEpoch.load(std::memory_order_acquire);
+        std::size_t freed = 0;
+        std::uint64_t worstNs = 0;
+        std::uint64_t totalNs = 0;
+        const auto now = Clock::now();
+        while (!runs.empty() && runs.front().epoch + 2 <= current) {
+            const Segment run = runs.front();
+            runs.pop_front();
+            for (std::size_t i = 0; i < run.count; ++i) {
+                list.front().deleter(list.front().ptr);
+                list.pop_front();
+            }
+            freed += run.count;
+            const auto runNs =
+                static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - run.firstRetire).count());
+            worstNs = std::max(worstNs, runNs);
+            totalNs += runNs * run.count;  // Timed from the run's first retire: an upper bound per object.
+        }
+        if (freed != 0) {
+            batchCount.fetch_add(1, std::memory_order_relaxed);
+            latencyTotalNs.fetch_add(totalNs, std::memory_order_relaxed);
+            std::uint64_t seen = latencyMaxNs.load(std::memory_order_relaxed);
+            while (worstNs > seen && !latencyMaxNs.compare_exchange_weak(seen, worstNs, std::memory_order_relaxed)) {}
+        }
+        return freed;
+    }
+
+    // Append an object to a retire list, starting a new epoch run when the epoch has moved on.
+    static void append(std::deque<Retired>& list, std::deque<Segment>& runs, Retired item, std::uint64_t epoch) {
+        list.push_back(item);
+        if (runs.empty() || runs.back().epoch != epoch) {
+            runs.push_back({epoch, 1, Clock::now()});
+        } else {
+            ++runs.back().count;
+        }
+    }
+
+    // Free whatever the calling thread and the orphan list can safely release right now.
+    void collect(ThreadRecord& record) {
+        tryAdvance();
+        record.reclaimedCount.fetch_add(freeExpired(record.retired, record.segments), std::memory_order_relaxed);
+        if (orphanCount.load(std::memory_order_relaxed) != 0) {
+            std::unique_lock<std::mutex> lock(orphanMutex, std::try_to_lock);  // Never wait on another collector.
+            if (lock.owns_lock()) {
+                orphanReclaimed.fetch_add(freeExpired(orphans, orphanSegments), std::memory_order_relaxed);
+                orphanCount.store(orphans.size(), std::memory_order_relaxed);
+            }
+        }
+    }
+
+public:
+    // Define an RAII critical region. Nodes loaded from a shared structure stay valid until the guard is destroyed.
+    class Guard {
+    private:
+        EpochDomain& domain;
+        ThreadRecord& record;
+
+    public:
+        explicit Guard(EpochDomain& d = EpochDomain::global()) : domain(d), record(d.localRecord()) {
+            if (record.nesting++ == 0) {
+                record.epoch.store(domain.globalEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);  // Publish the announcement before any shared load.
+            }
+        }
+
+        ~Guard() {
+            if (--record.nesting == 0) {
+                record.epoch.store(kInactive, std::memory_order_release);  // Leave the critical region.
+            }
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    // Constructor to initialize a domain with the given per-thread batch size.
+    explicit EpochDomain(std::size_t batch = kDefaultBatchSize) : batchSize(batch == 0 ? 1 : batch) {}
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Destructor to free all pending garbage. No thread may hold a guard or use the domain afterwards.
+    ~EpochDomain() {
+        auto& entries = threadCache().entries;  // Forget this domain in the destroying thread's cache.
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [this](const ThreadCache::Entry& e) { return e.domain == this; }),
+                      entries.end());
+        ThreadRecord* record = records.load(std::memory_order_acquire);
+        while (record != nullptr) {
+            for (auto& item : record->retired) item.deleter(item.ptr);
+            ThreadRecord* next = record->nextRecord;
+            delete record;
+            record = next;
+        }
+        for (auto& item : orphans) item.deleter(item.ptr);
+    }
+
+    // Return the process-wide domain. It is intentionally never destroyed so threads may exit in any order.
+    static EpochDomain& global() {
+        static auto* domain = new EpochDomain();
+        return *domain;
+    }
+
+    // Defer freeing an unlinked object until no reader can still hold a reference to it.
+    void retire(void* ptr, Deleter deleter) {
+        ThreadRecord& record = localRecord();
+        append(record.retired, record.segments, {ptr, deleter}, globalEpoch.load(std::memory_order_acquire));
+        record.retiredCount.fetch_add(1, std::memory_order_relaxed);
+        if (record.retired.size() >= batchSize) {
+            collect(record);  // Free in batches rather than on every retire.
+        }
+    }
+
+    // Convenience overload that retires an object allocated with new.
+    template<typename T>
+    void retire(T* ptr) {
+        retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    // Push reclamation forward without waiting for the batch threshold, e.g. before measuring or at shutdown.
+    // Must not be called while the calling thread holds a guard on this domain.
+    void flush() {
+        ThreadRecord& record = localRecord();
+        for (int i = 0; i < 3; ++i) {
+            collect(record);
+        }
+    }
+
+    // Take a snapshot of the domain's counters. Values are read without synchronization and may be slightly stale.
+    ReclaimStats stats() const {
+        ReclaimStats s;
+        s.epoch = globalEpoch.load(std::memory_order_relaxed);
+        for (ThreadRecord* record = records.load(std::memory_order_acquire); record != nullptr; record = record->nextRecord) {
+            s.retired += record->retiredCount.load(std::memory_order_relaxed);
+            s.reclaimed += record->reclaimedCount.load(std::memory_order_relaxed);
+        }
+        s.reclaimed += orphanReclaimed.load(std::memory_order_relaxed);
+        s.pending = s.retired >= s.reclaimed ? s.retired - s.reclaimed : 0;
+        s.batches = batchCount.load(std::memory_order_relaxed);
+        s.avgReclaimLatencyNs = s.reclaimed == 0 ? 0 : latencyTotalNs.load(std::memory_order_relaxed) / s.reclaimed;
+        s.maxReclaimLatencyNs = latencyMaxNs.load(std::memory_order_relaxed);
+        return s;
+    }
+};
+
+#endif // EPOCH_RECLAMATION_H
@@ -0,0 +1,525 @@
+#ifndef FLAT_COMBINING_STACK_H
+#define FLAT_COMBINING_STACK_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "cache_line.h"
+#include "lock_policy.h"
+#include "log_policy.h"
+#include "node_pool.h"
+#include "spin_wait.h"
+#include "stack_chain.h"
+#include "stack_node.h"
+#include "stack_stats.h"
+#include "wait_queue.h"
+
+// Define a flat-combining stack with the same policies as ThreadSafeStack and nearly the same API.
+// A thread does not modify the stack itself. It publishes its request (push a prepared node, or pop) in its own
+// publication record and then tries to take the lock. Whoever gets the lock becomes the combiner. It scans every
+// record, pairs pending pushes with pending pops locally (the popper is handed the pusher's node and top is never
+// touched), applies what is left to top in one pass and marks each request done. The other threads just spin on
+// their own record's cache line, so top, the lock and the node links stay in the combiner's cache instead of
+// bouncing between cores on every operation. Each combining pass is one critical section, so operations stay
+// linearizable: paired push/pop couples are ordered push-then-pop inside the pass.
+// The template parameters are ThreadSafeStack's, in the same order, and so is the API, with two differences: there is
+// no async_pop()/async_push(), and top_peek() always takes the lock, as top_peek_locked() does. Bulk operations,
+// drain(), for_each_snapshot() and the blocking wait_pop() take the lock directly instead of going through a record;
+// a combiner that links values onto the stack wakes the consumers sleeping in wait_pop(). The combiner acquires the
+// lock with LockPolicy::try_lock() and never waits for it: a thread that finds it taken spins on its record instead.
+// With ContentionStats the lock wait of a combined push or pop is the time from publishing the request until it was
+// served or its thread became the combiner, and the hold time is the length of each combining pass.
+template<typename T, typename LogPolicy = TextLog, typename Allocator = PooledNodeAllocator, typename StatsPolicy = NoStats,
+         typename LockPolicy = PthreadLock>
+class FlatCombiningStack : private LogPolicy, private StatsPolicy {
+private:
+    using Node = StackNode<T>;
+    using Timestamp = typename StatsPolicy::Timestamp;
+
+    // Define what a critical section carries from lock() to unlock(), as in ThreadSafeStack.
+    struct Held {
+        typename LockPolicy::QueueNode node;
+        Timestamp acquired;
+    };
+
+    // Define the states of a publication record.
+    enum RequestState : int {
+        kIdle,  // No request outstanding.
+        kPushRequest,  // node holds a prepared node to push.
+        kPopRequest,  // The owner wants the top node.
+        kDone,  // The combiner has served the request; for pops, node holds the result or nullptr.
+    };
+
+    // Define one thread's publication record, padded so owners spin on a line nobody else writes until done.
+    struct alignas(kCacheLineSize) Record {
+        std::atomic<int> state{kIdle};  // Request state, handed back and forth between owner and combiner.
+        Node* node = nullptr;  // Request argument or result, guarded by state.
+        std::atomic<bool> abandoned{false};  // Set when the owning thread exits, so another thread can adopt it.
+        Record* nextRecord = nullptr;  // Next record in the publication list; immutable once linked.
+    };
+
+    // Define the calling thread's map from stack id to its record in that stack.
+    struct ThreadRecords {
+        struct Entry {
+            std::uint64_t stackId;
+            std::shared_ptr<Record> record;
+        };
+        std::vector<Entry> entries;
+
+        // Hand every record this thread owned back to its stack for reuse.
+        ~ThreadRecords() {
+            for (auto& entry : entries) entry.record->abandoned.store(true, std::memory_order_release);
+        }
+    };
+
+    alignas(kCacheLineSize) Node* top;  // Pointer to the top node of the stack, only touched while holding mutex.
+    std::atomic<std::size_t> size;  // Number of values. Written under mutex; read without it by approx_size().
+    std::size_t waiting;  // Number of consumers parked, or about to park, in waitQueue. Protected by mutex.
+    LockPolicy mutex;  // Held by the combiner and by the operations that take the lock directly.
+    std::atomic<Record*> publications{nullptr};  // Head of the push-only publication list.
+    std::mutex registryMutex;  // Protects owned.
+    std::vector<std::shared_ptr<Record>> owned;  // Keeps every record alive for as long as the stack exists.
+    const std::uint64_t id;  // Unique id, so a thread's cache never confuses two stacks at the same address.
+    std::vector<Record*> pushes;  // Combiner scratch space: push requests found in the current pass.
+    std::vector<Record*> pops;  // Combiner scratch space: pop requests found in the current pass.
+    alignas(kCacheLineSize) WaitQueue waitQueue;  // Where wait_pop() sleeps until a push arrives; cold otherwise.
+
+    static std::uint64_t nextStackId() {
+        static std::atomic<std::uint64_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    static ThreadRecords& threadRecords() {
+        thread_local ThreadRecords cache;
+        return cache;
+    }
+
+    // Find the calling thread's publication record, adopting an abandoned one or linking a new one on first use.
+    Record& localRecord() {
+        ThreadRecords& cache = threadRecords();
+        for (auto& entry : cache.entries) {
+            if (entry.stackId == id) return *entry.record;
+        }
+        cache.entries.erase(std::remove_if(cache.entries.begin(), cache.entries.end(),
+                                           [](const typename ThreadRecords::Entry& e) { return e.record.use_count() == 1; }),
+                            cache.entries.end());  // Forget records of stacks that no longer exist.
+        std::shared_ptr<Record> record;
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            for (auto& candidate : owned) {
+                bool wasAbandoned = true;
+                if (candidate->abandoned.compare_exchange_strong(wasAbandoned, false, std::memory_order_acq_rel)) {
+                    record = candidate;
+                    break;
+                }
+            }
+            if (!record) {
+                record = std::make_shared<Record>();
+                owned.push_back(record);
+                record->nextRecord = publications.load(std::memory_order_relaxed);
+                publications.store(record.get(), std::memory_order_release);  // Registration is serialized by registryMutex.
+            }
+        }
+        cache.entries.push_back({id, record});
+        return *record;
+    }
+
+    // Lock the mutex, recording how long the wait took.
+    void lock(Held& held) {
+        const Timestamp requested = StatsPolicy::now();
+        mutex.lock(held.node);
+        held.acquired = StatsPolicy::now();
+        StatsPolicy::recordWait(requested, held.acquired);
+    }
+
+    // Unlock the mutex, recording how long it was held. The sample is stored after the lock is released.
+    void unlock(Held& held) {
+        const Timestamp released = StatsPolicy::now();
+        mutex.unlock(held.node);
+        StatsPolicy::recordHold(held.acquired, released);
+    }
+
+    // Add delta to the count read by approx_size(). Must be called with mutex held; only the holder writes it.
+    void publish(std::ptrdiff_t delta) {
+        size.store(static_cast<std::size_t>(static_cast<std::ptrdiff_t>(size.load(std::memory_order_relaxed)) + delta),
+                   std::memory_order_relaxed);
+    }
+
+    // Serve every published request in one pass and return how many sleeping consumers to wake once the lock is
+    // released: one per value linked onto the stack, but no more than are waiting. Must be called with mutex held.
+    std::size_t combine() {
+        pushes.clear();
+        pops.clear();
+        for (Record* record = publications.load(std::memory_order_acquire); record != nullptr; record = record->nextRecord) {
+            int state = record->state.load(std::memory_order_acquire);
+            if (state == kPushRequest) {
+                pushes.push_back(record);
+            } else if (state == kPopRequest) {
+                pops.push_back(record);
+            }
+        }
+        for (Record* record : pops) {
+            if (!pushes.empty()) {  // Eliminate: give this pop a node pushed in the same pass.
+                Record* pusher = pushes.back();
+                pushes.pop_back();
+                record->node = pusher->node;
+                pusher->state.store(kDone, std::memory_order_release);
+            } else {  // No pushes left to pair with: take from the stack itself.
+                record->node = top;
+                if (top != nullptr) {
+                    top = top->next;
+                    publish(-1);
+                }
+            }
+            record->state.store(kDone, std::memory_order_release);
+        }
+        for (Record* pusher : pushes) {  // Link the unmatched pushes onto the stack.
+            pusher->node->next = top;
+            top = pusher->node;
+            pusher->state.store(kDone, std::memory_order_release);
+        }
+        publish(static_cast<std::ptrdiff_t>(pushes.size()));
+        return std::min(pushes.size(), waiting);
+    }
+
+    // Publish a request and wait until some combiner, possibly this thread, has served it.
+    Node* submit(int request, Node* node) {
+        Record& record = localRecord();
+        record.node = node;
+        record.state.store(request, std::memory_order_release);
+        const Timestamp requested = StatsPolicy::now();
+        SpinBackoff backoff;
+        for (;;) {
+            if (record.state.load(std::memory_order_acquire) == kDone) {  // Another combiner served it.
+                StatsPolicy::recordWait(requested, StatsPolicy::now());
+                break;
+            }
+            Held held;
+            if (mutex.try_lock(held.node)) {  // Become the combiner; the pass serves our own request too.
+                held.acquired = StatsPolicy::now();
+                StatsPolicy::recordWait(requested, held.acquired);
+                const std::size_t wake = combine();
+                unlock(held);
+                if (wake != 0) waitQueue.notify(wake);
+                break;
+            }
+            backoff.pause();
+        }
+        Node* result = record.node;
+        record.state.store(kIdle, std::memory_order_relaxed);
+        return result;
+    }
+
+    // Pop a node through the combiner and take ownership of it, or return nullptr if the stack was empty.
+    Node* popNode() {
+        Node* node = submit(kPopRequest, nullptr);
+        if (node == nullptr) {
+            StatsPolicy::countFailedPop();
+        } else {
+            StatsPolicy::countPop();
+            StatsPolicy::adjustDepth(-1);
+        }
+        return node;
+    }
+
+    // Detach the top node, sleeping while the stack is empty until deadline passes; nullptr waits without one.
+    // Returns nullptr only on timeout.
+    Node* waitForNode(const timespec* deadline) {
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        bool counted = false;
+        while (top == nullptr) {
+            if (!counted) {
+                ++waiting;  // Combiners and direct pushes read this under the lock, so they see us before we sleep.
+                counted = true;
+            }
+            waitQueue.prepare();
+            unlock(held);
+            const bool woken = waitQueue.park(deadline);
+            lock(held);
+            if (!woken && top == nullptr) break;  // Timed out with nothing to take.
+        }
+        if (counted) --waiting;
+        Node* node = top;
+        if (node != nullptr) {
+            top = node->next;
+            publish(-1);
+            StatsPolicy::adjustDepth(-1);
+        }
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        return node;
+    }
+
+    // Hand a node detached by waitForNode() to the caller.
+    std::optional<T> takeWaited(Node* node) {
+        if (node == nullptr) {
+            StatsPolicy::countFailedPop();
+            return std::nullopt;  // Timed out.
+        }
+        StatsPolicy::countPop();
+        std::optional<T> data(std::move(node->data));
+        Allocator::destroy(node);
+        LogPolicy::record(LogOp::Pop, *data);  // Log the pop operation outside the lock.
+        return data;
+    }
+
+    // Link the private chain head..bottom of count nodes onto the stack in one critical section.
+    void spliceChain(Node* head, Node* bottom, std::size_t count) {
+        for (Node* node = head; node != nullptr; node = node->next) {
+            LogPolicy::record(LogOp::Push, node->data);  // Log while the chain is still private.
+        }
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        bottom->next = top;
+        top = head;
+        publish(static_cast<std::ptrdiff_t>(count));
+        const std::size_t wake = std::min(count, waiting);  // One wakeup per value, but no more than are waiting.
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        if (wake != 0) waitQueue.notify(wake);
+        StatsPolicy::countPush(count);
+        StatsPolicy::adjustDepth(static_cast<std::ptrdiff_t>(count));
+    }
+
+public:
+    // Constructor to initialize the stack. Any arguments go to the log policy, e.g. a trace file path.
+    template<typename... LogArgs>
+    explicit FlatCombiningStack(LogArgs&&... logArgs)
+        : LogPolicy(std::forward<LogArgs>(logArgs)...), top(nullptr), size(0), waiting(0), id(nextStackId()) {}
+
+    FlatCombiningStack(const FlatCombiningStack&) = delete;
+    FlatCombiningStack& operator=(const FlatCombiningStack&) = delete;
+
+    // Destructor to clean up resources. No thread may use the stack concurrently.
+    ~FlatCombiningStack() { clear(); }
+
+    // Method to push a copy of a value onto the stack.
+    void push(const T& value) { emplace(value); }
+
+    // Method to push a value onto the stack, moving it into the node.
+    void push(T&& value) { emplace(std::move(value)); }
+
+    // Method to construct a value in place on top of the stack.
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        auto newNode = Allocator::template create<Node>(std::forward<Args>(args)...);  // Build the node up front.
+        LogPolicy::record(LogOp::Push, newNode->data);  // Log while the node is still private.
+        submit(kPushRequest, newNode);
+        StatsPolicy::countPush();
+        StatsPolicy::adjustDepth(1);
+    }
+
+    // Method to pop a value from the stack into out. Returns false, without throwing, if the stack is empty.
+    bool try_pop(T& out) {
+        Node* node = popNode();
+        if (node == nullptr) return false;  // The stack was empty.
+        out = std::move(node->data);
+        Allocator::destroy(node);
+        LogPolicy::record(LogOp::Pop, out);
+        return true;
+    }
+
+    // Method to pop a value from the stack. Returns std::nullopt, without throwing, if the stack is empty.
+    std::optional<T> try_pop() {
+        Node* node = popNode();
+        if (node == nullptr) return std::nullopt;  // The stack was empty.
+        std::optional<T> data(std::move(node->data));
+        Allocator::destroy(node);
+        LogPolicy::record(LogOp::Pop, *data);
+        return data;
+    }
+
+    // Method to pop a value from the stack. Throws std::runtime_error if the stack is empty; prefer try_pop on hot paths.
+    T pop() {
+        std::optional<T> data = try_pop();
+        if (!data) {  // Check if the stack is empty.
+            std::cerr << "Error: Attempted to pop from an empty stack.\n";  // Log an error message.
+            throw std::runtime_error("Attempted to pop an empty stack.");  // Throw an exception.
+        }
+        return std::move(*data);  // Return the popped data.
+    }
+
+    // Method to pop a value from the stack, sleeping until a value is pushed if the stack is empty.
+    T wait_pop() { return std::move(*takeWaited(waitForNode(nullptr))); }
+
+    // Method to pop a value from the stack, sleeping up to timeout for a push if the stack is empty.
+    // Returns std::nullopt, without throwing, if the stack is still empty when the timeout expires.
+    template<typename Rep, typename Period>
+    std::optional<T> wait_pop_for(const std::chrono::duration<Rep, Period>& timeout) {
+        const timespec deadline = WaitQueue::deadlineAfter(timeout);
+        return takeWaited(waitForNode(&deadline));
+    }
+
+    // Method to push every value in [first, last) in one critical section; the last value ends up on top.
+    // Bulk operations already amortize the lock, so they take it directly instead of going through a record.
+    template<typename InputIt>
+    void push_bulk(InputIt first, InputIt last) {
+        if (first == last) return;
+        Node* bottom = Allocator::template create<Node>(*first);
+        Node* head = bottom;
+        std::size_t count = 1;
+        try {
+            for (++first; first != last; ++first) {
+                Node* node = Allocator::template create<Node>(*first);
+                node->next = head;
+                head = node;
+                ++count;
+            }
+        } catch (...) {
+            while (head != nullptr) {
+                Node* next = head->next;
+                Allocator::destroy(head);
+                head = next;
+            }
+            throw;
+        }
+        spliceChain(head, bottom, count);
+    }
+
+    // Method to push every value of a chain taken from a stack with the same node allocator, e.g. by drain(), in one
+    // critical section without copying. The chain's first value ends up on top, and the chain is left empty.
+    void push_chain(StackChain<T, Allocator>&& chain) {
+        const std::size_t count = chain.size();
+        Node* bottom = chain.tail;
+        Node* head = chain.release();
+        if (head != nullptr) spliceChain(head, bottom, count);
+    }
+
+    // Method to pop up to n values in one critical section, writing them to out from the top down.
+    template<typename OutputIt>
+    std::size_t pop_n(OutputIt out, std::size_t n) {
+        if (n == 0) return 0;
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        Node* first = top;
+        std::size_t taken = 0;
+        while (top != nullptr && taken < n) {
+            top = top->next;
+            ++taken;
+        }
+        publish(-static_cast<std::ptrdiff_t>(taken));
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        StatsPolicy::adjustDepth(-static_cast<std::ptrdiff_t>(taken));
+        StatsPolicy::countPop(taken);
+        if (taken < n) StatsPolicy::countFailedPop();  // The stack ran out before n values.
+        for (std::size_t i = 0; i < taken; ++i) {
+            Node* next = first->next;
+            LogPolicy::record(LogOp::Pop, first->data);
+            *out++ = std::move(first->data);
+            Allocator::destroy(first);
+            first = next;
+        }
+        return taken;
+    }
+
+    // Method to clear the stack: detach the chain under the lock and free it outside.
+    void clear() {
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        Node* node = top;
+        top = nullptr;
+        size.store(0, std::memory_order_relaxed);
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        std::size_t count = 0;
+        while (node != nullptr) {
+            Node* next = node->next;
+            Allocator::destroy(node);
+            node = next;
+            ++count;
+        }
+        if (count != 0) {
+            LogPolicy::record(LogOp::Clear, count);
+            StatsPolicy::adjustDepth(-static_cast<std::ptrdiff_t>(count));
+        }
+    }
+
+    // Method to detach every value at once, as a chain the caller owns: a pointer swap under the lock, whatever the
+    // depth. The chain is counted, and logged as one clear, after the lock is released.
+    StackChain<T, Allocator> drain() {
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        Node* head = top;
+        top = nullptr;
+        size.store(0, std::memory_order_relaxed);
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        std::size_t count = 0;
+        Node* tail = nullptr;
+        for (Node* node = head; node != nullptr; node = node->next) {  // Walk the private chain without the lock.
+            tail = node;
+            ++count;
+        }
+        if (count != 0) {
+            LogPolicy::record(LogOp::Clear, count);  // The values left the stack, as with clear().
+            StatsPolicy::adjustDepth(-static_cast<std::ptrdiff_t>(count));
+        }
+        return StackChain<T, Allocator>(head, tail, count);
+    }
+
+    // Method to call fn(const T&) on every value, top first, without popping. The lock is held for the whole walk,
+    // so combining waits until it is done; fn should be short and must not use the stack.
+    template<typename Fn>
+    void for_each_snapshot(Fn fn) {
+        Held held;
+        lock(held);  // Lock the mutex so no combiner changes the chain under the walk.
+        try {
+            for (const Node* node = top; node != nullptr; node = node->next) fn(static_cast<const T&>(node->data));
+        } catch (...) {
+            unlock(held);
+            throw;
+        }
+        unlock(held);  // Unlock the mutex after the walk.
+    }
+
+    // Method to return the number of values, read without the lock. It may lag requests a combiner is serving; once
+    // they are done it is exact. See size_locked() for an exact count.
+    std::size_t approx_size() const { return size.load(std::memory_order_relaxed); }
+
+    // Method to check, without the lock, whether the stack looks empty. Same consistency as approx_size().
+    bool empty() const { return approx_size() == 0; }
+
+    // Method to return a copy of the top value, or std::nullopt if the stack is empty. Unlike ThreadSafeStack this
+    // always takes the lock: the combiner keeps no mirror of the top value.
+    std::optional<T> top_peek() { return top_peek_locked(); }
+
+    // Method to return the exact number of values at one moment. Slower: takes the lock.
+    std::size_t size_locked() {
+        Held held;
+        lock(held);
+        const std::size_t depth = size.load(std::memory_order_relaxed);
+        unlock(held);
+        return depth;
+    }
+
+    // Method to check whether the stack is empty at one moment. Slower: takes the lock.
+    bool empty_locked() { return size_locked() == 0; }
+
+    // Method to return a copy of the value on top at one moment, or std::nullopt if the stack is empty. Slower:
+    // takes the lock, and copies the value under it.
+    std::optional<T> top_peek_locked() {
+        Held held;
+        lock(held);
+        std::optional<T> value;
+        try {
+            if (top != nullptr) value.emplace(top->data);
+        } catch (...) {
+            unlock(held);
+            throw;
+        }
+        unlock(held);
+        return value;
+    }
+
+    // Method to take a snapshot of the instrumentation counters. All zero unless StatsPolicy is ContentionStats.
+    StackStats stats() const { return StatsPolicy::snapshot(); }
+};
+
+#endif // FLAT_COMBINING_STACK_H
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+#include "lock_policy.h"
+#include "log_policy.h"
+#include "node_pool.h"
+#include "numa_topology.h"
+#include "realtime_stack.h"
+#include "stack_stats.h"
+#include "thread_safe_stack.h"
+
+// Measure the worst-case push and pop latency a real-time thread sees from a shared stack, for the default stack
+// and for RealtimeStack. A SCHED_FIFO control loop wakes every --period-us, times one push and one pop, and goes back
+// to sleep, while SCHED_OTHER background threads hammer the same stack and mid-priority SCHED_FIFO hogs burn the CPU
+// in bursts. The hogs set up the classic priority inversion: a background thread holding the lock is preempted by a
+// hog, so the control loop waits for the whole burst unless the lock lends the holder its priority. That only happens
+// when the hog, the holder and the control loop compete for one CPU, so every thread is pinned to the same CPU (the
+// first one the process may use, or --cpu N); with --cpu none a hog usually finds an idle core instead. Each
+// configuration prints the p50 to p99.99 and the maximum of both operations. Run with --help for the options; the
+// real-time policies need root or CAP_SYS_NICE, and the loop falls back to SCHED_OTHER (and the hogs are skipped)
+// without them.
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kControlPriority = 80;  // SCHED_FIFO priority of the control loop.
+constexpr int kHogPriority = 40;  // SCHED_FIFO priority of the hogs: above everything but the control loop.
+constexpr std::size_t kThreadStackBytes = 256 * 1024;  // Small, so mlockall() does not pin 8 MiB per thread.
+constexpr std::size_t kPrefill = 64;  // Values pushed before the run, so pops rarely find the stack empty.
+constexpr std::size_t kRealtimeNodes = 4096;  // Arena reserved for the RealtimeStack nodes.
+
+// Define the command-line options.
+struct Options {
+    std::size_t samples = 100000;  // Control-loop iterations per configuration.
+    std::size_t background = 2;  // SCHED_OTHER threads pushing and popping flat out.
+    std::size_t hogs = 1;  // Mid-priority SCHED_FIFO threads burning the CPU in bursts.
+    long periodUs = 20;  // Control-loop period.
+    long hogUs = 1000;  // Length of each hog burst; a hog sleeps ten times as long between bursts.
+    int cpu = -1;  // CPU every thread of a run is pinned to, or -1 for none.
+};
+
+// Define the state shared by the threads of one run.
+template<typename Stack>
+struct RunState {
+    Stack stack;
+    std::atomic<bool> stop{false};
+    std::size_t samples = 0;
+    long periodNs = 0;
+    long hogNs = 0;
+    std::vector<std::uint32_t> pushNs;  // Per-iteration push latency, sized before the run.
+    std::vector<std::uint32_t> popNs;  // Per-iteration pop latency, sized before the run.
+};
+
+std::uint32_t elapsedNs(Clock::time_point from, Clock::time_point to) {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+    return static_cast<std::uint32_t>(std::min<long long>(ns, UINT32_MAX));
+}
+
+void advance(timespec& time, long ns) {
+    time.tv_nsec += ns;
+    while (time.tv_nsec >= 1000000000L) {
+        time.tv_nsec -= 1000000000L;
+        ++time.tv_sec;
+    }
+}
+
+// Wake on an absolute schedule and time one push and one pop per period. This function is intended to be used with
+// pthreads.
+template<typename Stack>
+void* controlLoop(void* arg) {
+    auto state = static_cast<RunState<Stack>*>(arg);
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < state->samples; ++i) {
+        advance(next, state->periodNs);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr) == EINTR) {}
+        const auto start = Clock::now();
+        state->stack.push(i);
+        const auto pushed = Clock::now();
+        state->stack.try_pop(value);
+        const auto popped = Clock::now();
+        state->pushNs[i] = elapsedNs(start, pushed);
+        state->popNs[i] = elapsedNs(pushed, popped);
+    }
+    return nullptr;
+}
+
+// Push and pop flat out until the run stops, so the lock is often held when the control loop wakes. This function
+// is intended to be used with pthreads.
+template<typename Stack>
+void* backgroundLoop(void* arg) {
+    auto state = static_cast<RunState<Stack>*>(arg);
+    std::uint64_t value = 0;
+    while (!state->stop.load(std::memory_order_relaxed)) {
+        state->stack.push(value);
+        state->stack.try_pop(value);
+    }
+    return nullptr;
+}
+
+// Spin for hogNs, then sleep ten times as long, until the run stops. This function is intended to be used with
+// pthreads.
+template<typename Stack>
+void* hogLoop(void* arg) {
+    auto state = static_cast<RunState<Stack>*>(arg);
+    while (!state->stop.load(std::memory_order_relaxed)) {
+        const auto until = Clock::now() + std::chrono::nanoseconds(state->hogNs);
+        while (Clock::now() < until) {}
+        timespec pause{0, 0};
+        advance(pause, 10 * state->hogNs);
+        nanosleep(&pause, nullptr);
+    }
+    return nullptr;
+}
+
+// Start a thread with a small stack under the given policy, pinned to cpu unless it is negative. Returns false if the
+// thread could not be created, e.g. because a real-time policy is not permitted.
+bool startThread(pthread_t& thread, void* (*body)(void*), void* arg, int policy, int priority, int cpu) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, kThreadStackBytes);
+    if (cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        pthread_attr_setaffinity_np(&attributes, sizeof(cpus), &cpus);
+    }
+    if (policy != SCHED_OTHER) {
+        sched_param param{};
+        param.sched_priority = priority;
+        pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attributes, policy);
+        pthread_attr_setschedparam(&attributes, &param);
+    }
+    const bool started = pthread_create(&thread, &attributes, body, arg) == 0;
+    pthread_attr_destroy(&attributes);
+    return started;
+}
+
+// Return the q-quantile of samples, which must be sorted.
+std::uint32_t quantile(const std::vector<std::uint32_t>& samples, double q) {
+    if (samples.empty()) return 0;
+    return samples[static_cast<std::size_t>(q * static_cast<double>(samples.size() - 1))];
+}
+
+void printRow(const char* config, const char* op, std::vector<std::uint32_t>& samples) {
+    std::sort(samples.begin(), samples.end());
+    std::cout << std::left << std::setw(14) << config << std::setw(6) << op << std::right;
+    for (double q : {0.50, 0.99, 0.999, 0.9999}) std::cout << std::setw(10) << quantile(samples, q);
+    std::cout << std::setw(10) << (samples.empty() ? 0 : samples.back()) << '\n';
+}
+
+// Run one configuration on a fresh stack and print its rows.
+template<typename Stack>
+void runConfig(const char* config, const Options& options) {
+    auto state = std::make_unique<RunState<Stack>>();
+    state->samples = options.samples;
+    state->periodNs = options.periodUs * 1000;
+    state->hogNs = options.hogUs * 1000;
+    state->pushNs.assign(options.samples, 0);  // Touch every page now, not from inside the loop.
+    state->popNs.assign(options.samples, 0);
+    for (std::size_t i = 0; i < kPrefill; ++i) state->stack.push(i);
+
+    std::vector<pthread_t> helpers;
+    for (std::size_t i = 0; i < options.background; ++i) {
+        pthread_t thread;
+        if (startThread(thread, backgroundLoop<Stack>, state.get(), SCHED_OTHER, 0, options.cpu)) helpers.push_back(thread);
+    }
+    std::size_t hogs = 0;
+    for (std::size_t i = 0; i < options.hogs; ++i) {
+        pthread_t thread;
+        if (!startThread(thread, hogLoop<Stack>, state.get(), SCHED_FIFO, kHogPriority, options.cpu)) break;
+        helpers.push_back(thread);
+        ++hogs;
+    }
+    pthread_t control;
+    const char* policy = "SCHED_FIFO";
+    if (!startThread(control, controlLoop<Stack>, state.get(), SCHED_FIFO, kControlPriority, options.cpu)) {
+        policy = "SCHED_OTHER";
+        if (!startThread(control, controlLoop<Stack>, state.get(), SCHED_OTHER, 0, options.cpu)) {
+            std::cerr << config << ": failed to start the control loop\n";
+            state->stop.store(true);
+            for (pthread_t thread : helpers) pthread_join(thread, nullptr);
+            return;
+        }
+    }
+    pthread_join(control, nullptr);
+    state->stop.store(true);
+    for (pthread_t thread : helpers) pthread_join(thread, nullptr);
+
+    std::cout << "# " << config << ": control loop " << policy << ", " << helpers.size() - hogs << " background, "
+              << hogs << " hogs, "
+              << (options.cpu >= 0 ? "pinned to CPU " + std::to_string(options.cpu) : std::string("unpinned")) << '\n';
+    printRow(config, "push", state->pushNs);
+    printRow(config, "pop", state->popNs);
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --samples N       control-loop iterations per configuration (default: 100000)\n"
+              << "  --background N    SCHED_OTHER threads contending for the stack (default: 2)\n"
+              << "  --hogs N          mid-priority SCHED_FIFO threads burning the CPU in bursts (default: 1)\n"
+              << "  --period-us N     control-loop period in microseconds (default: 20)\n"
+              << "  --hog-us N        length of a hog burst in microseconds (default: 1000)\n"
+              << "  --cpu N|none      CPU to pin every thread to, or none (default: the first CPU this process may use)\n";
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    const std::vector<int> cpus = allowedCpus();
+    if (!cpus.empty()) options.cpu = cpus.front();
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--samples") == 0 && hasValue) {
+            options.samples = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--background") == 0 && hasValue) {
+            options.background = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--hogs") == 0 && hasValue) {
+            options.hogs = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--period-us") == 0 && hasValue) {
+            options.periodUs = std::stol(argv[++i]);
+        } else if (std::strcmp(argv[i], "--hog-us") == 0 && hasValue) {
+            options.hogUs = std::stol(argv[++i]);
+        } else if (std::strcmp(argv[i], "--cpu") == 0 && hasValue) {
+            ++i;
+            options.cpu = std::strcmp(argv[i], "none") == 0 ? -1 : std::stoi(argv[i]);
+        } else {
+            printUsage(argv[0]);
+            return std::strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    if (options.cpu >= 0 && std::find(cpus.begin(), cpus.end(), options.cpu) == cpus.end()) {
+        std::cerr << "CPU " << options.cpu << " is not available to this process.\n";
+        return 1;
+    }
+
+    std::cout << std::left << std::setw(14) << "config" << std::setw(6) << "op" << std::right << std::setw(10) << "p50"
+              << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "p99.99" << std::setw(10)
+              << "max" << "  (ns)\n";
+    runConfig<ThreadSafeStack<std::uint64_t, NoLog, HeapNodeAllocator, NoStats, PthreadLock>>("pthread+heap", options);
+    runConfig<ThreadSafeStack<std::uint64_t, NoLog, PooledNodeAllocator, NoStats, PthreadLock>>("pthread+pool", options);
+
+    // The real-time configuration runs last: mlockall() also pins every page the process maps from now on.
+    try {
+        reserveRealtimeNodes<std::uint64_t>(kRealtimeNodes);
+    } catch (const std::exception& error) {
+        std::cerr << "realtime: " << error.what() << '\n';
+        return 1;
+    }
+    if (!lockProcessMemory()) std::cout << "# mlockall failed; only the arena is locked (see ulimit -l)\n";
+    runConfig<RealtimeStack<std::uint64_t>>("realtime", options);
+    return 0;
+}
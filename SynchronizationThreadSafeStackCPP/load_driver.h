@@ -0,0 +1,367 @@
+#ifndef LOAD_DRIVER_H
+#define LOAD_DRIVER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <pthread.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "numa_topology.h"
+#include "spin_wait.h"
+
+// Load generator that drives any stack with the push/try_pop surface from a pool of worker threads.
+// The workers are created once, optionally pinned to CPUs, and every run releases all of them together through a
+// barrier, so the measured interval covers the workload at full concurrency rather than a ramp while threads are
+// still being created. Each worker times itself; a run's wall time is the first worker's start to the last
+// worker's finish.
+
+// Define where worker threads run.
+enum class Placement {
+    None,  // Wherever the scheduler puts them.
+    Compact,  // Worker i on the i-th allowed CPU, filling one NUMA node before the next.
+    Scatter,  // Round-robin over NUMA nodes, so consecutive workers land on different nodes.
+};
+
+// Define the workload settings. --threads, --iterations, --mix, --log and --mode are shared with the C and Rust
+// drivers so the cross-language harness can run all three alike; the rest are specific to this driver.
+//   --threads N        number of worker threads (default: hardware concurrency)
+//   --iterations N     loop iterations per thread; each iteration is 6 operations (default 500)
+//   --mix M            classic (3 pushes and 3 pops intermixed), push-heavy, balanced or pop-heavy (default classic)
+//   --ops-file FILE    read the operation mix from FILE instead (see readMixFile)
+//   --log on|off       trace every operation (default on; ignored by the stacks without a log policy)
+//   --mode M           shared (one stack for all threads, the default) or per-thread (each thread has its own stack)
+//   --pin P            none (the default), compact or scatter; see Placement
+struct Workload {
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int iterations = 500;
+    bool classic = true;  // Run the fixed 3-push/3-pop pattern; otherwise draw operations at random.
+    unsigned pushPercent = 50;  // Share of random operations that are pushes.
+    unsigned thinkNs = 0;  // Busy work between random operations, standing in for the caller's own work.
+    bool log = true;
+    bool perThread = false;
+    Placement placement = Placement::None;
+};
+
+// Read an operation mix from path into workload. The file has one "name value" pair per line, '#' starts a comment:
+//   push 70      relative weight of pushes
+//   pop 30       relative weight of pops
+//   think 200    nanoseconds of busy work between operations (default 0)
+// Returns false, after printing the reason, if the file cannot be read or holds anything else.
+inline bool readMixFile(const char* path, Workload& workload) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot open op-mix file " << path << "\n";
+        return false;
+    }
+    unsigned long push = 0, pop = 0, think = 0;
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string name;
+        unsigned long value = 0;
+        if (!(fields >> name)) continue;  // Blank or comment-only line.
+        std::string rest;
+        if (!(fields >> value) || (fields >> rest) || (name != "push" && name != "pop" && name != "think")) {
+            std::cerr << path << ":" << number << ": expected 'push N', 'pop N' or 'think NS'\n";
+            return false;
+        }
+        (name == "push" ? push : name == "pop" ? pop : think) = value;
+    }
+    if (push + pop == 0) {
+        std::cerr << path << ": push and pop weights are both 0\n";
+        return false;
+    }
+    workload.classic = false;
+    workload.pushPercent = static_cast<unsigned>((push * 100 + (push + pop) / 2) / (push + pop));
+    workload.thinkNs = static_cast<unsigned>(think);
+    return true;
+}
+
+// Return the CPU for each worker slot under placement: worker i runs on order[i % order.size()].
+// Empty for Placement::None.
+inline std::vector<int> placementOrder(Placement placement) {
+    std::vector<int> order;
+    if (placement == Placement::None) return order;
+    const auto& nodes = NumaTopology::get().nodes();
+    if (placement == Placement::Compact) {
+        for (const auto& node : nodes) order.insert(order.end(), node.begin(), node.end());
+        return order;
+    }
+    std::size_t total = 0;
+    for (const auto& node : nodes) total += node.size();
+    for (std::size_t round = 0; order.size() < total; ++round) {  // Scatter: one CPU per node per round.
+        for (const auto& node : nodes) {
+            if (round < node.size()) order.push_back(node[round]);
+        }
+    }
+    return order;
+}
+
+// Define a fixed set of worker threads, created once and reused for every run.
+// run() publishes a routine and its per-worker arguments, then releases every worker through one barrier, so all
+// of them start the routine together, and returns once all of them have finished it.
+class WorkerPool {
+private:
+    std::vector<pthread_t> threads;  // Worker handles.
+    const Placement where;  // How the workers were pinned.
+    pthread_barrier_t start;  // Workers plus the caller; passing it hands out a job.
+    pthread_barrier_t done;  // Workers plus the caller; passing it means the job is finished.
+    void* (*routine)(void*) = nullptr;  // Current job, written by run() before the start barrier.
+    unsigned char* args = nullptr;  // Arguments of worker 0; worker i's are stride bytes further.
+    std::size_t stride = 0;
+    bool stopping = false;  // Set by the destructor before the last start barrier.
+
+    struct Launch {
+        WorkerPool* pool;
+        std::size_t index;
+    };
+    std::vector<Launch> launches;  // Worker indexes, kept alive for the worker threads.
+
+    static void* workerLoop(void* arg) {
+        const Launch launch = *static_cast<Launch*>(arg);
+        WorkerPool& pool = *launch.pool;
+        for (;;) {
+            pthread_barrier_wait(&pool.start);
+            if (pool.stopping) return nullptr;
+            pool.routine(pool.args + launch.index * pool.stride);
+            pthread_barrier_wait(&pool.done);
+        }
+    }
+
+public:
+    // Constructor to start count workers placed as requested. Throws std::runtime_error if a thread cannot be created.
+    WorkerPool(std::size_t count, Placement placement) : threads(count), where(placement), launches(count) {
+        pthread_barrier_init(&start, nullptr, static_cast<unsigned>(count + 1));
+        pthread_barrier_init(&done, nullptr, static_cast<unsigned>(count + 1));
+        const std::vector<int> order = placementOrder(placement);
+        for (std::size_t i = 0; i < count; ++i) {
+            launches[i] = {this, i};
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            if (!order.empty()) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET(order[i % order.size()], &cpus);
+                pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+            }
+            const int status = pthread_create(&threads[i], &attr, workerLoop, &launches[i]);
+            pthread_attr_destroy(&attr);
+            if (status != 0) {
+                std::cerr << "Failed to create thread." << std::endl;
+                std::exit(1);  // The threads already waiting at the barrier cannot be released cleanly.
+            }
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Destructor to stop and join the workers.
+    ~WorkerPool() {
+        stopping = true;
+        pthread_barrier_wait(&start);
+        for (auto& thread : threads) pthread_join(thread, nullptr);
+        pthread_barrier_destroy(&done);
+        pthread_barrier_destroy(&start);
+    }
+
+    std::size_t size() const { return threads.size(); }
+    Placement placement() const { return where; }
+
+    // Run job(&perWorker[i]) on every worker i at once and wait for all of them. perWorker must have size() entries.
+    template<typename Arg>
+    void run(void* (*job)(void*), std::vector<Arg>& perWorker) {
+        routine = job;
+        args = reinterpret_cast<unsigned char*>(perWorker.data());
+        stride = sizeof(Arg);
+        pthread_barrier_wait(&start);
+        pthread_barrier_wait(&done);
+    }
+};
+
+// Return the pool for the workload's thread count and placement, reusing it across runs with the same settings.
+inline WorkerPool& workerPool(const Workload& workload) {
+    static std::unique_ptr<WorkerPool> pool;
+    if (!pool || pool->size() != static_cast<std::size_t>(workload.threads) || pool->placement() != workload.placement) {
+        pool.reset();  // Join the old workers before starting new ones.
+        pool = std::make_unique<WorkerPool>(static_cast<std::size_t>(workload.threads), workload.placement);
+    }
+    return *pool;
+}
+
+// Define the arguments handed to each testStack worker.
+template<typename Stack>
+struct WorkerArgs {
+    Stack* stack;  // Stack this thread works on.
+    const Workload* workload;  // Workload settings.
+    std::uint64_t seed;  // Seed for the random operation mixes.
+    std::chrono::steady_clock::time_point begin;  // When this worker started its first operation.
+    std::chrono::steady_clock::time_point end;  // When this worker finished its last operation.
+};
+
+// Spin for about ns nanoseconds without touching shared memory.
+inline void think(unsigned ns) {
+    const auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+    while (std::chrono::steady_clock::now() < until) cpuRelax();
+}
+
+// Define a function that performs a sequence of stack operations. This function is intended to be run by a
+// WorkerPool, or directly with pthreads. It is templated on the stack type so every variant with the push/pop
+// surface can be driven by the same workload.
+template<typename Stack>
+void* testStack(void* arg) {
+    // Cast the void pointer to the arguments for the stack type under test.
+    auto args = static_cast<WorkerArgs<Stack>*>(arg);
+    auto stack = args->stack;
+    const Workload& workload = *args->workload;
+    std::uint64_t state = args->seed;  // xorshift state for the random mixes, identical to the C and Rust drivers.
+    args->begin = std::chrono::steady_clock::now();
+    // Loop over the iterations to perform stack operations.
+    for (int i = 0; i < workload.iterations; ++i) {
+        try {
+            if (workload.classic) {
+                // 3 intermixed push and pop operations
+                // 'i * 3 + _' is a way to generate distinct values for each iteration of the loop that are evenly spaced apart
+                // try_pop is used so that an empty stack costs a branch rather than an exception.
+                stack->push(i * 3 + 1);
+                stack->push(i * 3 + 2);
+                stack->try_pop();
+                stack->push(i * 3 + 3);
+                stack->try_pop();
+                stack->try_pop();
+                continue;
+            }
+            for (int j = 0; j < 6; ++j) {
+                state ^= state >> 12;
+                state ^= state << 25;
+                state ^= state >> 27;
+                if ((state * 0x2545F4914F6CDD1Dull >> 32) % 100 < workload.pushPercent) {
+                    stack->push(i * 6 + j);
+                } else {
+                    stack->try_pop();
+                }
+                if (workload.thinkNs != 0) think(workload.thinkNs);
+            }
+        } catch (const std::runtime_error& e) {
+            // If an error occurs during the stack operations, log the error message.
+            std::cerr << "Operation error: " << e.what() << "\n";
+        }
+    }
+    args->end = std::chrono::steady_clock::now();
+    // Return null as the function is used as a thread routine which does not need to return any value.
+    return nullptr;
+}
+
+// Create the stack for one thread in per-thread mode, or the single shared stack.
+// Traced stacks (those whose log policy takes a path) get one trace file per stack in per-thread mode, so the
+// traces do not overwrite each other.
+template<typename Stack, bool Traced>
+std::unique_ptr<Stack> makeStack(const Workload& workload, std::size_t index, const char* traceSuffix) {
+    if constexpr (Traced) {
+        if (workload.perThread) return std::make_unique<Stack>("output_" + std::to_string(index) + traceSuffix);
+    }
+    return std::make_unique<Stack>();
+}
+
+// Run the workload against one shared instance of the given stack type, or one instance per thread, and print the
+// steady-state throughput. If report is given, it is called for each stack once the workers have finished, before
+// the stack is cleared.
+template<typename Stack, bool Traced = false>
+int runWorkload(const Workload& workload, const char* traceSuffix = ".txt", void (*report)(const Stack&) = nullptr) {
+    WorkerPool& pool = workerPool(workload);
+    // Instantiate the thread-safe stacks: one shared among threads, or one per thread.
+    std::vector<std::unique_ptr<Stack>> stacks;
+    for (std::size_t i = 0; i < (workload.perThread ? pool.size() : 1); ++i) {
+        stacks.push_back(makeStack<Stack, Traced>(workload, i, traceSuffix));
+    }
+    std::vector<WorkerArgs<Stack>> args(pool.size());
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        args[i] = {stacks[workload.perThread ? i : 0].get(), &workload, 0x9E3779B97F4A7C15ull * (i + 1), {}, {}};
+    }
+
+    // Release every worker at once and wait for all of them to finish.
+    pool.run(testStack<Stack>, args);
+
+    auto begin = args.front().begin;
+    auto end = args.front().end;
+    for (const auto& worker : args) {
+        begin = std::min(begin, worker.begin);
+        end = std::max(end, worker.end);
+    }
+    const std::chrono::duration<double> elapsed = end - begin;
+    const double ops = static_cast<double>(args.size()) * workload.iterations * 6;
+    std::cout << args.size() << " threads: " << static_cast<long long>(ops) << " ops in " << elapsed.count() << " s ("
+              << static_cast<long long>(elapsed.count() > 0 ? ops / elapsed.count() : 0) << " ops/s)\n";
+
+    // Clear the stacks to release any remaining resources.
+    for (auto& stack : stacks) {
+        if (report != nullptr) report(*stack);
+        stack->clear();
+    }
+
+    std::cout << "Program complete.\n";
+    return 0;
+}
+
+// Run the workload on LoggedStack, or on UnloggedStack when logging is turned off.
+template<typename LoggedStack, typename UnloggedStack>
+int runLogged(const Workload& workload, const char* traceSuffix = ".txt") {
+    return workload.log ? runWorkload<LoggedStack, true>(workload, traceSuffix) : runWorkload<UnloggedStack>(workload);
+}
+
+// Read the workload settings from argv[first..]. Returns false, after printing usage, on an unknown option.
+inline bool parseWorkload(int argc, char* argv[], int first, Workload& workload) {
+    for (int i = first; i < argc; i += 2) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value != nullptr && std::strcmp(argv[i], "--threads") == 0 && std::atoi(value) > 0) {
+            workload.threads = std::atoi(value);
+        } else if (value != nullptr && std::strcmp(argv[i], "--iterations") == 0 && std::atoi(value) >= 0) {
+            workload.iterations = std::atoi(value);
+        } else if (value != nullptr && std::strcmp(argv[i], "--mix") == 0 && std::strcmp(value, "classic") == 0) {
+            workload.classic = true;
+        } else if (value != nullptr && std::strcmp(argv[i], "--mix") == 0 && std::strcmp(value, "push-heavy") == 0) {
+            workload.classic = false;
+            workload.pushPercent = 80;
+        } else if (value != nullptr && std::strcmp(argv[i], "--mix") == 0 && std::strcmp(value, "balanced") == 0) {
+            workload.classic = false;
+            workload.pushPercent = 50;
+        } else if (value != nullptr && std::strcmp(argv[i], "--mix") == 0 && std::strcmp(value, "pop-heavy") == 0) {
+            workload.classic = false;
+            workload.pushPercent = 20;
+        } else if (value != nullptr && std::strcmp(argv[i], "--ops-file") == 0) {
+            if (!readMixFile(value, workload)) return false;
+        } else if (value != nullptr && std::strcmp(argv[i], "--log") == 0 &&
+                   (std::strcmp(value, "on") == 0 || std::strcmp(value, "off") == 0)) {
+            workload.log = std::strcmp(value, "on") == 0;
+        } else if (value != nullptr && std::strcmp(argv[i], "--mode") == 0 &&
+                   (std::strcmp(value, "shared") == 0 || std::strcmp(value, "per-thread") == 0)) {
+            workload.perThread = std::strcmp(value, "per-thread") == 0;
+        } else if (value != nullptr && std::strcmp(argv[i], "--pin") == 0 &&
+                   (std::strcmp(value, "none") == 0 || std::strcmp(value, "compact") == 0 ||
+                    std::strcmp(value, "scatter") == 0)) {
+            workload.placement = std::strcmp(value, "compact") == 0   ? Placement::Compact
+                                 : std::strcmp(value, "scatter") == 0 ? Placement::Scatter
+                                                                      : Placement::None;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [variant] [--threads N] [--iterations N] "
+                      << "[--mix classic|push-heavy|balanced|pop-heavy] [--ops-file FILE] [--log on|off] "
+                      << "[--mode shared|per-thread] [--pin none|compact|scatter]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif // LOAD_DRIVER_H
@@ -0,0 +1,389 @@
+#ifndef LOCK_FREE_STACK_H
+#define LOCK_FREE_STACK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "epoch_reclamation.h"
+#include "node_pool.h"
+#include "packed_stack.h"
+#include "stack_chain.h"
+#include "stack_node.h"
+#include "stack_stats.h"
+
+// Define a pointer packed together with a generation counter in a single 64-bit word.
+// User-space addresses on x86-64 and AArch64 fit in the low 48 bits, which leaves the high 16 bits for a tag that is
+// bumped on every successful compare-and-swap. A thread holding a stale word therefore fails its CAS even when the
+// same node address has come back to the top of the stack in the meantime (the ABA problem).
+template<typename Node>
+class TaggedPtr {
+public:
+    static constexpr int kPointerBits = 48; // Number of low bits that hold the address.
+    static constexpr std::uint64_t kPointerMask = (std::uint64_t{1} << kPointerBits) - 1; // Mask selecting the address bits.
+
+    static_assert(sizeof(void*) == sizeof(std::uint64_t), "TaggedPtr requires 64-bit pointers");
+
+    // Combine a pointer and a tag into one word.
+    static std::uint64_t pack(Node* ptr, std::uint16_t tag) {
+        return (static_cast<std::uint64_t>(tag) << kPointerBits) | (reinterpret_cast<std::uintptr_t>(ptr) & kPointerMask);
+    }
+
+    // Extract the pointer from a packed word.
+    static Node* ptr(std::uint64_t word) { return reinterpret_cast<Node*>(word & kPointerMask); }
+
+    // Extract the tag from a packed word.
+    static std::uint16_t tag(std::uint64_t word) { return static_cast<std::uint16_t>(word >> kPointerBits); }
+};
+
+// Define an intrusive Treiber list head: an atomic tagged word with CAS-loop push and pop of whole nodes.
+// A node's next pointer is only written before the node is published, so concurrent poppers may read it plainly;
+// callers must keep popped nodes alive (see EpochDomain) while other threads might still be reading them.
+// The CAS loops report how many attempts lost a race, for instrumentation; callers that ignore the count pay nothing.
+template<typename Node>
+class TaggedHead {
+private:
+    using Tagged = TaggedPtr<Node>;
+    std::atomic<std::uint64_t> head{0}; // Packed pointer to the first node plus its generation tag.
+
+public:
+    // Link a node in front of the current head. Returns the number of failed CAS attempts.
+    std::size_t push(Node* node) {
+        std::size_t retries = 0;
+        std::uint64_t old = head.load(std::memory_order_relaxed); // Snapshot the current head.
+        for (;;) {
+            node->next = Tagged::ptr(old); // Point the new node at the snapshot.
+            if (head.compare_exchange_weak(old, Tagged::pack(node, Tagged::tag(old) + 1),
+                                           std::memory_order_release, std::memory_order_relaxed)) {
+                return retries;
+            }
+            ++retries; // Retry if the head moved.
+        }
+    }
+
+    // Link a pre-built chain first..last (already joined through next) in front of the current head with one CAS.
+    // Returns the number of failed CAS attempts.
+    std::size_t pushChain(Node* first, Node* last) {
+        std::size_t retries = 0;
+        std::uint64_t old = head.load(std::memory_order_relaxed); // Snapshot the current head.
+        for (;;) {
+            last->next = Tagged::ptr(old); // Hang the current list off the end of the chain.
+            if (head.compare_exchange_weak(old, Tagged::pack(first, Tagged::tag(old) + 1),
+                                           std::memory_order_release, std::memory_order_relaxed)) {
+                return retries;
+            }
+            ++retries; // Retry if the head moved.
+        }
+    }
+
+    // Unlink up to n leading nodes with one CAS. Returns the first unlinked node and stores the count in taken;
+    // the last unlinked node's next still points into the list, so callers must stop after taken nodes.
+    // Adds the number of failed CAS attempts to retries.
+    Node* popChain(std::size_t n, std::size_t& taken, std::size_t& retries) {
+        std::uint64_t old = head.load(std::memory_order_acquire); // Snapshot the current head.
+        while (Tagged::ptr(old) != nullptr && n != 0) {
+            Node* rest = Tagged::ptr(old);
+            std::size_t count = 0;
+            while (rest != nullptr && count < n) { // Walk past up to n nodes; the tagged CAS rejects a stale walk.
+                rest = rest->next;
+                ++count;
+            }
+            if (head.compare_exchange_weak(old, Tagged::pack(rest, Tagged::tag(old) + 1),
+                                           std::memory_order_acquire, std::memory_order_acquire)) {
+                taken = count;
+                return Tagged::ptr(old); // We own the detached prefix now.
+            }
+            ++retries;
+        }
+        taken = 0;
+        return nullptr; // The list was empty.
+    }
+
+    // Try once to link a node in front of the head; returns false if another thread moved the head first.
+    bool tryPush(Node* node) {
+        std::uint64_t old = head.load(std::memory_order_relaxed);
+        node->next = Tagged::ptr(old);
+        return head.compare_exchange_strong(old, Tagged::pack(node, Tagged::tag(old) + 1),
+                                            std::memory_order_release, std::memory_order_relaxed);
+    }
+
+    // Try once to unlink the first node. Returns true and sets node (nullptr if the list was empty) when the
+    // attempt settled, or false if another thread moved the head first.
+    bool tryPop(Node*& node) {
+        std::uint64_t old = head.load(std::memory_order_acquire);
+        if (Tagged::ptr(old) == nullptr) {
+            node = nullptr;
+            return true;
+        }
+        Node* next = Tagged::ptr(old)->next;
+        if (!head.compare_exchange_strong(old, Tagged::pack(next, Tagged::tag(old) + 1),
+                                          std::memory_order_acquire, std::memory_order_relaxed)) {
+            return false;
+        }
+        node = Tagged::ptr(old);
+        return true;
+    }
+
+    // Unlink the first node, or return nullptr when the list is empty. Adds the number of failed CAS attempts to retries.
+    Node* pop(std::size_t& retries) {
+        std::uint64_t old = head.load(std::memory_order_acquire); // Snapshot the current head.
+        while (Tagged::ptr(old) != nullptr) {
+            Node* next = Tagged::ptr(old)->next; // May be stale; the tagged CAS catches that.
+            if (head.compare_exchange_weak(old, Tagged::pack(next, Tagged::tag(old) + 1),
+                                           std::memory_order_acquire, std::memory_order_acquire)) {
+                return Tagged::ptr(old); // We own the unlinked node now.
+            }
+            ++retries;
+        }
+        return nullptr; // The list was empty.
+    }
+
+    // Detach the whole list at once and return its first node.
+    Node* exchange(Node* replacement) {
+        std::uint64_t old = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(old, Tagged::pack(replacement, Tagged::tag(old) + 1),
+                                           std::memory_order_acq_rel, std::memory_order_relaxed)) {}
+        return Tagged::ptr(old);
+    }
+
+    // Check whether the list currently has no nodes.
+    bool empty() const { return Tagged::ptr(head.load(std::memory_order_acquire)) == nullptr; }
+};
+
+// Tag that selects the PackedStack representation of LockFreeStack for a small trivially copyable T (kPackable).
+// It is opt-in: push_bulk and pop_n lose their single-CAS atomicity there, and a single thread pays two CASes per
+// operation.
+struct PackedRepresentation {};
+
+// Define a generic, lock-free stack class that can handle any type T.
+// It offers the same push/pop/clear surface as ThreadSafeStack, so the two can be swapped behind the same driver.
+// Passing PackedRepresentation as the last argument selects the specialization below, which stores small trivially
+// copyable values inline in a PackedStack instead of in nodes.
+// Popped nodes are retired to an EpochDomain rather than deleted, so a thread that read a stale top can still
+// dereference it; the node is freed in a batch once no pop that could have seen it is still running.
+// Nodes come from the Allocator policy (see node_pool.h), and the reclamation domain hands them back to it.
+// The StatsPolicy (see stack_stats.h) counts operations, CAS retries and depth; the default NoStats compiles out.
+template<typename T, typename Allocator = PooledNodeAllocator, typename StatsPolicy = NoStats, typename Select = void>
+class LockFreeStack : private StatsPolicy {
+private:
+    template<typename, typename, typename> friend class EliminationStack;  // Layers its backoff on the single-CAS attempts.
+    template<typename, typename> friend class AdaptiveStack;  // Moves nodes in and out when it switches strategy.
+
+    using Node = StackNode<T>;
+    TaggedHead<Node> top;  // Tagged pointer to the top node of the stack.
+    EpochDomain& domain;  // Reclamation domain that frees popped nodes.
+
+    // Deleter handed to the reclamation domain; returns a node to the allocator.
+    static void destroyNode(void* node) { Allocator::destroy(static_cast<Node*>(node)); }
+
+    // Unlink the top node, or return nullptr if the stack is empty.
+    Node* popNode() {
+        std::size_t retries = 0;
+        Node* node;
+        {
+            EpochDomain::Guard guard(domain);  // Keep nodes we may read alive until the CAS settles.
+            node = top.pop(retries);  // Unlink the top node with a CAS loop.
+        }
+        StatsPolicy::countCasRetries(retries);
+        if (node == nullptr) {
+            StatsPolicy::countFailedPop();
+        } else {
+            StatsPolicy::countPop();
+            StatsPolicy::adjustDepth(-1);
+        }
+        return node;
+    }
+
+    // Try a single CAS to publish a node; false means the CAS lost a race with another thread.
+    bool tryPushNode(Node* node) { return top.tryPush(node); }
+
+    // Try a single CAS to unlink the top node. On true, node is the popped node or nullptr if the stack was empty;
+    // false means the CAS lost a race with another thread.
+    bool tryPopNode(Node*& node) {
+        EpochDomain::Guard guard(domain);  // Keep the node we read alive until the CAS settles.
+        return top.tryPop(node);
+    }
+
+    // Retire every node of a detached chain. Returns the number of nodes retired.
+    std::size_t retireChain(Node* node) {
+        std::size_t count = 0;
+        while (node != nullptr) {
+            Node* next = node->next;
+            domain.retire(node, &destroyNode);
+            node = next;
+            ++count;
+        }
+        return count;
+    }
+
+    // Detach every node as a chain, top first, without retiring any. Only safe while no other thread is using the
+    // stack, since no pop that might still read the nodes is waited for.
+    StackChain<T, Allocator> detachAll() {
+        Node* head = top.exchange(nullptr);
+        Node* tail = nullptr;
+        std::size_t count = 0;
+        for (Node* node = head; node != nullptr; node = node->next) {
+            tail = node;
+            ++count;
+        }
+        StatsPolicy::adjustDepth(-static_cast<std::ptrdiff_t>(count));
+        return StackChain<T, Allocator>(head, tail, count);
+    }
+
+    // Link a chain's nodes in on top with a single CAS. The values move rather than arrive, so no push is counted.
+    void adoptChain(StackChain<T, Allocator>&& chain) {
+        const std::size_t count = chain.size();
+        Node* bottom = chain.tail;
+        Node* head = chain.release();
+        if (head == nullptr) return;
+        StatsPolicy::adjustDepth(static_cast<std::ptrdiff_t>(count));
+        StatsPolicy::countCasRetries(top.pushChain(head, bottom));
+    }
+
+public:
+    // Constructor to initialize the stack, optionally sharing a reclamation domain other than the global one.
+    explicit LockFreeStack(EpochDomain& reclaimDomain = EpochDomain::global()) : domain(reclaimDomain) {}
+
+    // The stack owns its nodes, so copying is not supported.
+    LockFreeStack(const LockFreeStack&) = delete;
+    LockFreeStack& operator=(const LockFreeStack&) = delete;
+
+    // Destructor to clean up resources. No other thread may use the stack by now, so nodes are freed directly.
+    ~LockFreeStack() {
+        Node* node = top.exchange(nullptr);
+        while (node != nullptr) {
+            Node* next = node->next;
+            Allocator::destroy(node);
+            node = next;
+        }
+    }
+
+    // Method to push a copy of a value onto the stack.
+    void push(const T& value) { emplace(value); }
+
+    // Method to push a value onto the stack, moving it into the node.
+    void push(T&& value) { emplace(std::move(value)); }
+
+    // Method to construct a value in place on top of the stack.
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        auto newNode = Allocator::template create<Node>(std::forward<Args>(args)...);  // Create a new node.
+        StatsPolicy::adjustDepth(1);  // Count the node before it is visible, so depth never dips below zero.
+        StatsPolicy::countCasRetries(top.push(newNode));  // Publish the node with a CAS loop on top.
+        StatsPolicy::countPush();
+    }
+
+    // Method to push every value in [first, last) with a single CAS; the last value ends up on top.
+    template<typename InputIt>
+    void push_bulk(InputIt first, InputIt last) {
+        if (first == last) return;
+        Node* bottom = Allocator::template create<Node>(*first);  // The first value ends up deepest in the chain.
+        Node* head = bottom;
+        std::size_t count = 1;
+        try {
+            for (++first; first != last; ++first) {  // Build the chain privately, newest value at the head.
+                Node* node = Allocator::template create<Node>(*first);
+                node->next = head;
+                head = node;
+                ++count;
+            }
+        } catch (...) {
+            while (head != nullptr) {  // Free the partial chain before propagating the error.
+                Node* next = head->next;
+                Allocator::destroy(head);
+                head = next;
+            }
+            throw;
+        }
+        StatsPolicy::adjustDepth(static_cast<std::ptrdiff_t>(count));
+        StatsPolicy::countCasRetries(top.pushChain(head, bottom));  // Publish the whole chain at once.
+        StatsPolicy::countPush(count);
+    }
+
+    // Method to pop up to n values with a single CAS, writing them to out from the top down.
+    // Returns the number of values popped, which is less than n only if the stack ran out.
+    template<typename OutputIt>
+    std::size_t pop_n(OutputIt out, std::size_t n) {
+        std::size_t taken;
+        std::size_t retries = 0;
+        Node* node;
+        {
+            EpochDomain::Guard guard(domain);  // Keep the nodes we walk alive until the CAS settles.
+            node = top.popChain(n, taken, retries);
+        }
+        StatsPolicy::countCasRetries(retries);
+        StatsPolicy::adjustDepth(-static_cast<std::ptrdiff_t>(taken));
+        StatsPolicy::countPop(taken);
+        if (taken < n) StatsPolicy::countFailedPop();
+        for (std::size_t i = 0; i < taken; ++i) {  // The detached prefix is private to us now.
+            Node* next = node->next;
+            *out++ = std::move(node->data);
+            domain.retire(node, &destroyNode);
+            node = next;
+        }
+        return taken;
+    }
+
+    // Method to pop a value from the stack into out. Returns false, without throwing, if the stack is empty.
+    bool try_pop(T& out) {
+        Node* node = popNode();
+        if (node == nullptr) return false;  // The stack was empty.
+        out = std::move(node->data);  // Move the data out of the node we now own.
+        domain.retire(node, &destroyNode);  // Free the node once no concurrent pop can still be reading it.
+        return true;
+    }
+
+    // Method to pop a value from the stack. Returns std::nullopt, without throwing, if the stack is empty.
+    std::optional<T> try_pop() {
+        Node* node = popNode();
+        if (node == nullptr) return std::nullopt;  // The stack was empty.
+        std::optional<T> data(std::move(node->data));  // Move the data straight into the result.
+        domain.retire(node, &destroyNode);  // Free the node once no concurrent pop can still be reading it.
+        return data;
+    }
+
+    // Method to pop a value from the stack. Throws std::runtime_error if the stack is empty; prefer try_pop on hot paths.
+    T pop() {
+        std::optional<T> data = try_pop();
+        if (!data) {  // Check if the stack is empty.
+            std::cerr << "Error: Attempted to pop from an empty stack.\n";  // Log an error message.
+            throw std::runtime_error("Attempted to pop an empty stack.");  // Throw an exception.
+        }
+        return std::move(*data);  // Return the popped data.
+    }
+
+    // Method to clear the stack.
+    void clear() {
+        std::size_t count = retireChain(top.exchange(nullptr));  // Detach the whole chain in one step, then retire it.
+        StatsPolicy::adjustDepth(-static_cast<std::ptrdiff_t>(count));
+    }
+
+    // Method to take a snapshot of the instrumentation counters. All zero unless StatsPolicy is ContentionStats.
+    StackStats stats() const { return StatsPolicy::snapshot(); }
+
+    // Expose the reclamation domain so callers can observe pending garbage and reclaim latency.
+    EpochDomain& reclaimDomain() const { return domain; }
+};
+
+// Define the lock-free stack for small trivially copyable values, selected with PackedRepresentation: values live in
+// a PackedStack's array of tagged words, with no StackNode, no allocation per push and nothing for an EpochDomain to
+// reclaim. The Allocator is unused and the domain is kept only so code written against the node-based stack still
+// compiles.
+template<typename T, typename Allocator, typename StatsPolicy>
+class LockFreeStack<T, Allocator, StatsPolicy, PackedRepresentation> : public PackedStack<T, StatsPolicy> {
+private:
+    EpochDomain& domain;  // Not used for reclamation; see reclaimDomain().
+
+public:
+    // Constructor to initialize the stack. The domain is accepted for compatibility; nothing is ever retired to it.
+    explicit LockFreeStack(EpochDomain& reclaimDomain = EpochDomain::global()) : domain(reclaimDomain) {}
+
+    // Expose the reclamation domain the stack was given, for parity with the node-based stack.
+    EpochDomain& reclaimDomain() const { return domain; }
+};
+
+#endif // LOCK_FREE_STACK_H
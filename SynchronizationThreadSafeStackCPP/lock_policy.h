@@ -0,0 +1,318 @@
+#ifndef LOCK_POLICY_H
+#define LOCK_POLICY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <pthread.h>
+#include <stdexcept>
+
+#include "cache_line.h"
+#include "numa_topology.h"
+#include "spin_wait.h"
+
+// Lock policies for the mutex-based stacks. Each one provides lock(node) and unlock(node), where node is a
+// QueueNode the caller keeps alive (usually on its stack frame) from lock() until unlock() returns. Only queue locks
+// use it; for the others QueueNode is an empty struct. try_lock(node) takes the lock only if that needs no waiting
+// and returns whether it did; a successful try_lock() is released with unlock(node) like lock(). Every policy waits
+// with SpinBackoff, so waiters yield once a wait gets long instead of burning a time slice the lock holder may need.
+
+// Define the per-acquisition state of locks that need none.
+struct NoQueueNode {};
+
+// Define a policy that wraps pthread_mutex_t: a futex-based mutex that parks waiters in the kernel. The default.
+class PthreadLock {
+private:
+    pthread_mutex_t mutex;  // Mutex to ensure thread safety during operations.
+
+public:
+    using QueueNode = NoQueueNode;
+    static constexpr const char* kName = "pthread";
+
+    PthreadLock() : mutex(PTHREAD_MUTEX_INITIALIZER) { pthread_mutex_init(&mutex, nullptr); }
+    ~PthreadLock() { pthread_mutex_destroy(&mutex); }
+
+    PthreadLock(const PthreadLock&) = delete;
+    PthreadLock& operator=(const PthreadLock&) = delete;
+
+    void lock(QueueNode&) { pthread_mutex_lock(&mutex); }
+    bool try_lock(QueueNode&) { return pthread_mutex_trylock(&mutex) == 0; }
+    void unlock(QueueNode&) { pthread_mutex_unlock(&mutex); }
+};
+
+// Define a policy that wraps a pthread_mutex_t with the priority-inheritance protocol, for real-time threads. While a
+// thread waits for the lock, the holder runs at the waiter's priority if that is higher, so a lower-priority holder
+// cannot be preempted by medium-priority work and keep a real-time waiter blocked for as long as that work runs.
+// Uncontended lock and unlock are one atomic instruction in user space, as with PthreadLock; only a contended lock
+// enters the kernel, which is what applies the inheritance. Throws std::runtime_error if the platform lacks
+// PTHREAD_PRIO_INHERIT.
+class PriorityInheritLock {
+private:
+    pthread_mutex_t mutex;
+
+public:
+    using QueueNode = NoQueueNode;
+    static constexpr const char* kName = "pi";
+
+    PriorityInheritLock() {
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        const int error = pthread_mutexattr_setprotocol(&attributes, PTHREAD_PRIO_INHERIT);
+        if (error == 0) pthread_mutex_init(&mutex, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+        if (error != 0) throw std::runtime_error("Priority-inheritance mutexes are not supported");
+    }
+    ~PriorityInheritLock() { pthread_mutex_destroy(&mutex); }
+
+    PriorityInheritLock(const PriorityInheritLock&) = delete;
+    PriorityInheritLock& operator=(const PriorityInheritLock&) = delete;
+
+    void lock(QueueNode&) { pthread_mutex_lock(&mutex); }
+    bool try_lock(QueueNode&) { return pthread_mutex_trylock(&mutex) == 0; }
+    void unlock(QueueNode&) { pthread_mutex_unlock(&mutex); }
+};
+
+// Define a test-and-test-and-set spinlock. Waiters spin on a plain load, which stays in their own cache, and only
+// try the exchange once the lock looks free. Lowest latency when the holder is running, e.g. with pinned threads.
+class TtasSpinLock {
+private:
+    std::atomic<bool> held{false};  // Whether some thread holds the lock.
+
+public:
+    using QueueNode = NoQueueNode;
+    static constexpr const char* kName = "ttas";
+
+    TtasSpinLock() = default;
+    TtasSpinLock(const TtasSpinLock&) = delete;
+    TtasSpinLock& operator=(const TtasSpinLock&) = delete;
+
+    void lock(QueueNode&) {
+        SpinBackoff backoff;
+        while (held.exchange(true, std::memory_order_acquire)) {
+            while (held.load(std::memory_order_relaxed)) backoff.pause();
+        }
+    }
+
+    bool try_lock(QueueNode&) { return !held.load(std::memory_order_relaxed) && !held.exchange(true, std::memory_order_acquire); }
+
+    void unlock(QueueNode&) { held.store(false, std::memory_order_release); }
+};
+
+// Define a ticket lock: threads take a number and wait until it is served, so the lock is granted in FIFO order.
+// The two counters live on separate cache lines, so taking a ticket does not disturb the line waiters spin on.
+class TicketLock {
+private:
+    alignas(kCacheLineSize) std::atomic<std::uint32_t> nextTicket{0};  // Number handed to the next thread to arrive.
+    alignas(kCacheLineSize) std::atomic<std::uint32_t> nowServing{0};  // Number of the thread allowed to hold the lock.
+
+public:
+    using QueueNode = NoQueueNode;
+    static constexpr const char* kName = "ticket";
+
+    TicketLock() = default;
+    TicketLock(const TicketLock&) = delete;
+    TicketLock& operator=(const TicketLock&) = delete;
+
+    void lock(QueueNode&) {
+        const std::uint32_t ticket = nextTicket.fetch_add(1, std::memory_order_relaxed);
+        SpinBackoff backoff;
+        while (nowServing.load(std::memory_order_acquire) != ticket) backoff.pause();
+    }
+
+    // Take the next ticket only if it is the one being served, i.e. nobody holds or waits for the lock.
+    bool try_lock(QueueNode&) {
+        std::uint32_t ticket = nowServing.load(std::memory_order_acquire);
+        return nextTicket.compare_exchange_strong(ticket, ticket + 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    // Only the holder writes nowServing, so a plain increment is enough.
+    void unlock(QueueNode&) {
+        nowServing.store(nowServing.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+// Define an MCS queue lock. Each waiter spins on a flag in its own QueueNode and the holder hands the lock to its
+// successor directly, so a release touches one other thread's cache line instead of every waiter's. This scales
+// across sockets where a single shared flag or ticket counter would bounce between them.
+class McsLock {
+public:
+    // Define one waiter's place in the queue, on its own cache line.
+    struct alignas(kCacheLineSize) QueueNode {
+        std::atomic<QueueNode*> next{nullptr};  // Thread queued behind this one, once it has linked itself in.
+        std::atomic<bool> waiting{false};  // Cleared by the predecessor when it hands the lock over.
+    };
+
+    static constexpr const char* kName = "mcs";
+
+private:
+    std::atomic<QueueNode*> tail{nullptr};  // Last thread in the queue, or nullptr when the lock is free.
+
+public:
+    McsLock() = default;
+    McsLock(const McsLock&) = delete;
+    McsLock& operator=(const McsLock&) = delete;
+
+    void lock(QueueNode& node) {
+        node.next.store(nullptr, std::memory_order_relaxed);
+        node.waiting.store(true, std::memory_order_relaxed);
+        QueueNode* predecessor = tail.exchange(&node, std::memory_order_acq_rel);
+        if (predecessor == nullptr) return;  // The lock was free.
+        predecessor->next.store(&node, std::memory_order_release);
+        SpinBackoff backoff;
+        while (node.waiting.load(std::memory_order_acquire)) backoff.pause();
+    }
+
+    // Enqueue only if the queue is empty, which makes this thread the holder at once.
+    bool try_lock(QueueNode& node) {
+        node.next.store(nullptr, std::memory_order_relaxed);
+        node.waiting.store(false, std::memory_order_relaxed);
+        QueueNode* expected = nullptr;
+        return tail.compare_exchange_strong(expected, &node, std::memory_order_acq_rel, std::memory_order_relaxed);
+    }
+
+    void unlock(QueueNode& node) {
+        QueueNode* successor = node.next.load(std::memory_order_acquire);
+        if (successor == nullptr) {
+            QueueNode* expected = &node;
+            if (tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed)) {
+                return;  // Nobody was queued behind us.
+            }
+            SpinBackoff backoff;  // A thread has swapped itself into tail but not linked itself to us yet.
+            while ((successor = node.next.load(std::memory_order_acquire)) == nullptr) backoff.pause();
+        }
+        successor->waiting.store(false, std::memory_order_release);
+    }
+};
+
+// Define an adaptive lock: spin briefly in the hope that the holder, inside a short critical section, lets go soon;
+// then park on a condition variable so a long wait costs no CPU. The unlocker only touches the parking mutex when a
+// waiter has actually parked, so the uncontended path is one exchange and one store.
+class AdaptiveLock {
+private:
+    std::atomic<bool> held{false};  // Whether some thread holds the lock.
+    std::atomic<std::uint32_t> parked{0};  // Number of threads parked, or about to park, on wake.
+    pthread_mutex_t parkMutex;  // Protects the check-then-sleep of a parking thread.
+    pthread_cond_t wake;  // Signalled by unlock() when a thread is parked.
+
+public:
+    using QueueNode = NoQueueNode;
+    static constexpr const char* kName = "adaptive";
+    static constexpr unsigned kSpinAttempts = 128;  // Checks of the lock word before a waiter parks.
+
+    AdaptiveLock() : parkMutex(PTHREAD_MUTEX_INITIALIZER), wake(PTHREAD_COND_INITIALIZER) {
+        pthread_mutex_init(&parkMutex, nullptr);
+        pthread_cond_init(&wake, nullptr);
+    }
+
+    ~AdaptiveLock() {
+        pthread_cond_destroy(&wake);
+        pthread_mutex_destroy(&parkMutex);
+    }
+
+    AdaptiveLock(const AdaptiveLock&) = delete;
+    AdaptiveLock& operator=(const AdaptiveLock&) = delete;
+
+    void lock(QueueNode&) {
+        for (unsigned i = 0; i < kSpinAttempts; ++i) {  // Spin phase.
+            if (!held.load(std::memory_order_relaxed) && !held.exchange(true, std::memory_order_acquire)) return;
+            cpuRelax();
+        }
+        pthread_mutex_lock(&parkMutex);  // Park phase.
+        parked.fetch_add(1, std::memory_order_seq_cst);  // Announce before the final check, so unlock() sees us.
+        while (held.exchange(true, std::memory_order_seq_cst)) {
+            pthread_cond_wait(&wake, &parkMutex);
+        }
+        parked.fetch_sub(1, std::memory_order_relaxed);
+        pthread_mutex_unlock(&parkMutex);
+    }
+
+    bool try_lock(QueueNode&) { return !held.load(std::memory_order_relaxed) && !held.exchange(true, std::memory_order_acquire); }
+
+    void unlock(QueueNode&) {
+        held.store(false, std::memory_order_seq_cst);  // Ordered before the parked check, pairing with lock().
+        if (parked.load(std::memory_order_seq_cst) != 0) {
+            pthread_mutex_lock(&parkMutex);  // Waits until a parking thread is inside pthread_cond_wait.
+            pthread_cond_signal(&wake);
+            pthread_mutex_unlock(&parkMutex);
+        }
+    }
+};
+
+// Define a NUMA-aware cohort lock: a global TTAS lock plus one ticket lock per NUMA node. A thread first takes its
+// node's local lock, then the global one. On release, if another thread of the same node is already queued on the
+// local lock, the holder passes the global lock to it along with the local one, so the lock word, the stack's top
+// pointer and the nodes just pushed stay in that node's caches. Threads of other nodes only get a turn once the
+// node runs out of waiters or has kept the lock for kMaxPasses hand-offs in a row, which bounds their wait.
+// A thread's node is its home node (threadNode()); QueueNode remembers it, so unlock() releases the right local lock
+// even if the thread migrated while holding the lock.
+class CohortLock {
+public:
+    struct QueueNode {
+        std::size_t node = 0;  // Node whose local lock this acquisition holds.
+    };
+
+    static constexpr const char* kName = "cohort";
+    static constexpr std::uint32_t kMaxPasses = 64;  // Consecutive local hand-offs before the node lets go.
+
+private:
+    // Define one node's local lock, on its own cache lines so that nodes never share one.
+    struct alignas(kCacheLineSize) Local {
+        std::atomic<std::uint32_t> nextTicket{0};  // Number handed to the next thread of this node to arrive.
+        alignas(kCacheLineSize) std::atomic<std::uint32_t> nowServing{0};  // Number of the local holder.
+        bool globalPassed = false;  // Whether the previous local holder left the global lock held for us.
+        std::uint32_t passes = 0;  // Hand-offs since the node took the global lock. Both fields belong to the holder.
+    };
+
+    alignas(kCacheLineSize) std::atomic<bool> global{false};  // Whether some node holds the global lock.
+    std::unique_ptr<Local[]> locals;  // One local lock per node.
+
+public:
+    CohortLock() : locals(new Local[NumaTopology::get().nodeCount()]) {}
+    CohortLock(const CohortLock&) = delete;
+    CohortLock& operator=(const CohortLock&) = delete;
+
+    void lock(QueueNode& held) {
+        held.node = threadNode();
+        Local& local = locals[held.node];
+        const std::uint32_t ticket = local.nextTicket.fetch_add(1, std::memory_order_relaxed);
+        SpinBackoff backoff;
+        while (local.nowServing.load(std::memory_order_acquire) != ticket) backoff.pause();
+        if (local.globalPassed) return;  // Our node already holds the global lock.
+        while (global.exchange(true, std::memory_order_acquire)) {
+            while (global.load(std::memory_order_relaxed)) backoff.pause();
+        }
+    }
+
+    // Take the local lock only if nobody of this node holds or waits for it, then the global lock only if it is
+    // free; if it is not, give the local lock back to whoever queued behind us meanwhile.
+    bool try_lock(QueueNode& held) {
+        held.node = threadNode();
+        Local& local = locals[held.node];
+        std::uint32_t ticket = local.nowServing.load(std::memory_order_acquire);
+        if (!local.nextTicket.compare_exchange_strong(ticket, ticket + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+            return false;
+        }
+        if (local.globalPassed) return true;
+        if (!global.load(std::memory_order_relaxed) && !global.exchange(true, std::memory_order_acquire)) return true;
+        local.nowServing.store(ticket + 1, std::memory_order_release);
+        return false;
+    }
+
+    void unlock(QueueNode& held) {
+        Local& local = locals[held.node];
+        const std::uint32_t serving = local.nowServing.load(std::memory_order_relaxed);
+        const bool localWaiter = local.nextTicket.load(std::memory_order_relaxed) != serving + 1;
+        if (localWaiter && local.passes < kMaxPasses) {
+            ++local.passes;
+            local.globalPassed = true;  // Keep the global lock within the node.
+        } else {
+            local.passes = 0;
+            local.globalPassed = false;
+            global.store(false, std::memory_order_release);
+        }
+        local.nowServing.store(serving + 1, std::memory_order_release);
+    }
+};
+
+#endif // LOCK_POLICY_H
@@ -0,0 +1,75 @@
+#ifndef LOG_POLICY_H
+#define LOG_POLICY_H
+
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "async_log.h"
+#include "mapped_trace.h"
+
+// Logging policies for ThreadSafeStack. Each one provides record(op, value), which the stack calls outside its lock:
+// for a push before the lock is taken, while the value is still private, and for a pop or clear after it has been
+// released. NoLog is an empty class whose record() is an empty inline function, so a stack built with it carries no
+// logger state and compiles to the bare push/pop. The others keep their AsyncLogger on the heap and hold only a pointer
+// to it, which is written once at construction: the logger's own mutexes, counters and writer-thread state never share
+// a cache line with the stack's lock and top pointer.
+
+// Define a policy that records nothing.
+struct NoLog {
+    NoLog() = default;
+
+    template<typename T>
+    void record(LogOp, const T&) {}
+};
+
+// True for every policy but NoLog. Stacks that build values in place under their lock use it to keep that path when
+// nothing is logged, and stage a copy to record outside the lock otherwise.
+template<typename LogPolicy>
+inline constexpr bool kRecordsOps = !std::is_same_v<LogPolicy, NoLog>;
+
+// Define a policy that writes a "Pushed: N" / "Popped: N" text trace through an AsyncLogger.
+class TextLog {
+private:
+    std::unique_ptr<AsyncLogger> logger;  // Asynchronous writer for the trace.
+
+public:
+    // Constructor to open the trace file. Throws if it cannot be opened.
+    explicit TextLog(const std::string& path = "output.txt", OverflowPolicy overflow = OverflowPolicy::Block)
+        : logger(std::make_unique<AsyncLogger>(path, LogFormat::Text, overflow)) {}
+
+    template<typename T>
+    void record(LogOp op, const T& value) { logger->log(op, value); }
+};
+
+// Define a policy that writes raw 16-byte LogRecords through an AsyncLogger; cheaper than text for the writer.
+class BinaryLog {
+private:
+    std::unique_ptr<AsyncLogger> logger;  // Asynchronous writer for the trace.
+
+public:
+    // Constructor to open the trace file. Throws if it cannot be opened.
+    explicit BinaryLog(const std::string& path = "output.bin", OverflowPolicy overflow = OverflowPolicy::Block)
+        : logger(std::make_unique<AsyncLogger>(path, LogFormat::Binary, overflow)) {}
+
+    template<typename T>
+    void record(LogOp op, const T& value) { logger->log(op, value); }
+};
+
+// Define a policy that stamps every operation with its thread and a TSC timestamp in a memory-mapped trace (see
+// mapped_trace.h). Recording is a few stores into the calling thread's own region of the file, with no writer
+// thread; decode the result with trace_decode.
+class MappedLog {
+private:
+    std::unique_ptr<MappedTrace> trace;  // Mapped trace file.
+
+public:
+    // Constructor to create the trace file, preallocated to fileBytes. Throws if it cannot be created.
+    explicit MappedLog(const std::string& path = "output.trace", std::size_t fileBytes = MappedTrace::kDefaultFileBytes)
+        : trace(std::make_unique<MappedTrace>(path, fileBytes)) {}
+
+    template<typename T>
+    void record(LogOp op, const T& value) { trace->log(op, value); }
+};
+
+#endif // LOG_POLICY_H
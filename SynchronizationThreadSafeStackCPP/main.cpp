@@ -1,148 +1,312 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <coroutine>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <memory>
 #include <pthread.h>
-#include <fstream>
+#include <sys/resource.h>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
-// Define a template class StackNode that can store any type T.
-template<typename T>
-class StackNode {
-public:
-    T data; // Public member variable to hold the data of type T.
-    StackNode* next; // Pointer to the next StackNode in the stack.
+#include "adaptive_stack.h"
+#include "bounded_stack.h"
+#include "elimination_stack.h"
+#include "epoch_reclamation.h"
+#include "flat_combining_stack.h"
+#include "load_driver.h"
+#include "lock_free_stack.h"
+#include "log_policy.h"
+#include "numa_stack.h"
+#include "segmented_stack.h"
+#include "sharded_stack.h"
+#include "stack_config.h"
+#include "stack_stats.h"
+#include "thread_safe_stack.h"
 
-    // Explicit constructor that initializes a StackNode with a given value and sets the next pointer to nullptr.
-    explicit StackNode(T val) : data(val), next(nullptr) {}
-};
+// Print the instrumentation counters of a stack built with ContentionStats.
+template<typename Stack>
+void printStats(const Stack& stack) {
+    StackStats stats = stack.stats();
+    std::cout << "ops " << stats.ops() << " (pushes " << stats.pushes << ", pops " << stats.pops << ", failed pops "
+              << stats.failedPops << "), CAS retries " << stats.casRetries << ", depth " << stats.depth << " (peak "
+              << stats.peakDepth << ")\n";
+    if (stats.lockWait.samples != 0) {
+        std::cout << "  lock wait: mean " << stats.lockWait.meanNs() << " ns, p50 <= " << stats.lockWait.percentileNs(0.5)
+                  << " ns, p99 <= " << stats.lockWait.percentileNs(0.99) << " ns, max " << stats.lockWait.maxNs << " ns\n"
+                  << "  lock hold: mean " << stats.lockHold.meanNs() << " ns, p50 <= " << stats.lockHold.percentileNs(0.5)
+                  << " ns, p99 <= " << stats.lockHold.percentileNs(0.99) << " ns, max " << stats.lockHold.maxNs << " ns\n";
+    }
+}
 
+// Print the counters of an AdaptiveStack and the switches it made.
+void printAdaptive(const AdaptiveStack<int>& stack) {
+    printStats(stack);
+    AdaptiveStats adaptive = stack.adaptive_stats();
+    std::cout << "  strategy " << (adaptive.strategy == StackStrategy::LockFree ? "lock-free" : "mutex") << " after "
+              << adaptive.samples << " samples; " << adaptive.toLockFree << " switches to lock-free, " << adaptive.toMutex
+              << " back, " << adaptive.migratedValues << " values moved in " << adaptive.migrationNs << " ns; last lock wait "
+              << adaptive.lastWaitNs << " ns, last CAS retries per op " << adaptive.lastRetriesPerOp << "\n";
+}
 
-// Define a generic, thread-safe stack class that can handle any type T.
-template<typename T>
-class ThreadSafeStack {
-private:
-    StackNode<T>* top;  // Pointer to the top node of the stack.
-    pthread_mutex_t mutex;  // Mutex to ensure thread safety during operations.
-    std::ofstream file;  // File stream for logging stack operations.
-    std::atomic<bool> isClearing{false};  // Atomic flag to prevent operations during stack clearing.
+// Define the arguments handed to each burstWorker thread.
+template<typename Stack>
+struct BurstArgs {
+    Stack* stack;  // Stack shared by all workers.
+    bool bulk;  // Whether to use push_bulk/pop_n instead of one call per element.
+};
 
-public:
-    // Constructor to initialize the stack.
-    ThreadSafeStack() : top(nullptr), mutex(PTHREAD_MUTEX_INITIALIZER) {
-        pthread_mutex_init(&mutex, nullptr);  // Initialize the mutex.
-        file.open("output.txt", std::ios::out);  // Open the output file for logging.
-        if (!file.is_open()) {  // Check if the file opened successfully.
-            throw std::runtime_error("Unable to open file");  // Throw an exception if the file cannot be opened.
+// Push and pop bursts of 64 values, either one call per value or one bulk call per burst.
+template<typename Stack>
+void* burstWorker(void* arg) {
+    auto args = static_cast<BurstArgs<Stack>*>(arg);
+    int values[64];
+    int popped[64];
+    for (int i = 0; i < 500; ++i) {
+        for (int j = 0; j < 64; ++j) values[j] = i * 64 + j;
+        if (args->bulk) {
+            args->stack->push_bulk(values, values + 64);
+            args->stack->pop_n(popped, 64);
+        } else {
+            for (int value : values) args->stack->push(value);
+            for (int& slot : popped) args->stack->try_pop(slot);
         }
     }
+    return nullptr;
+}
 
-    // Destructor to clean up resources.
-    ~ThreadSafeStack() {
-        clear();  // Clear the stack.
-        pthread_mutex_destroy(&mutex);  // Destroy the mutex.
-        if (file.is_open()) {  // Check if the file is still open.
-            file.close();  // Close the file.
-        }
+// Time the burst workload on 8 threads and return operations per second.
+template<typename Stack>
+double measureBursts(bool bulk) {
+    std::vector<pthread_t> threads(8);
+    Stack stack;
+    BurstArgs<Stack> args{&stack, bulk};
+    auto start = std::chrono::steady_clock::now();
+    for (auto& thread : threads) {
+        pthread_create(&thread, nullptr, burstWorker<Stack>, &args);
     }
+    for (auto& thread : threads) {
+        pthread_join(thread, nullptr);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(threads.size()) * 500 * 128 / elapsed.count();
+}
 
-    // Method to push a value onto the stack.
-    void push(T value) {
-        if (isClearing.load()) return;  // Return immediately if the stack is being cleared.
+// Report the throughput of bulk operations against the per-element baseline for one stack type.
+template<typename Stack>
+void compareBulk(const char* name) {
+    double single = measureBursts<Stack>(false);
+    double bulk = measureBursts<Stack>(true);
+    std::cout << name << ": per-element " << static_cast<long long>(single) << " ops/s, bulk "
+              << static_cast<long long>(bulk) << " ops/s (" << bulk / single << "x)\n";
+}
 
-        pthread_mutex_lock(&mutex);  // Lock the mutex before modifying the stack.
-        auto newNode = new StackNode<T>(value);  // Create a new node.
-        newNode->next = top;  // Set the new node's next to the current top.
-        top = newNode;  // Update the top to be the new node.
-        if (file.is_open()) {  // Check if the file is open.
-            file << "Pushed: " << value << std::endl;  // Log the push operation.
-        }
-        pthread_mutex_unlock(&mutex);  // Unlock the mutex after modifying the stack.
-    }
+// Define the arguments handed to the work-queue producers and consumers.
+template<typename Stack>
+struct WorkQueueArgs {
+    Stack* stack;  // Stack used as the work queue.
+    int items;  // Values each producer pushes.
+    std::atomic<long long>* consumed;  // Values taken by all consumers.
+};
 
-    // Method to pop a value from the stack.
-    T pop() {
-        pthread_mutex_lock(&mutex);  // Lock the mutex before modifying the stack.
-        if (top == nullptr) {  // Check if the stack is empty.
-            pthread_mutex_unlock(&mutex);  // Unlock the mutex if the stack is empty.
-            std::cerr << "Error: Attempted to pop from an empty stack.\n";  // Log an error message.
-            throw std::runtime_error("Attempted to pop an empty stack.");  // Throw an exception.
+// Push items values in bursts of 64, pausing between bursts so the consumers run out of work and go idle.
+// On a BoundedStack, push() also sleeps while the stack is full.
+template<typename Stack>
+void* workProducer(void* arg) {
+    auto args = static_cast<WorkQueueArgs<Stack>*>(arg);
+    for (int i = 0; i < args->items; ++i) {
+        args->stack->push(i);
+        if (i % 64 == 63) {
+            timespec pause{0, 1000000};  // 1 ms.
+            nanosleep(&pause, nullptr);
         }
-        auto node = top;  // Store the top node.
-        T data = node->data;  // Get the data from the top node.
-        top = node->next;  // Update the top to the next node.
-        delete node;  // Delete the old top node.
-        if (file.is_open()) {  // Check if the file is open.
-            file << "Popped: " << data << "\n";  // Log the pop operation.
-        }
-        pthread_mutex_unlock(&mutex);  // Unlock the mutex after modifying the stack.
-        return data;  // Return the popped data.
     }
+    return nullptr;
+}
 
-    // Method to clear the stack.
-    void clear() {
-        isClearing.store(true);  // Set the clearing flag to true.
-        pthread_mutex_lock(&mutex);  // Lock the mutex before modifying the stack.
-        while (top != nullptr) {  // Loop until the stack is empty.
-            try {
-                pop();  // Pop each node.
-            } catch (const std::runtime_error& e) {  // Catch any exceptions from pop.
-                std::cerr << "Clearing error: " << e.what() << "\n";  // Log clearing errors.
-                break;  // Break the loop on error.
-            }
-        }
-        pthread_mutex_unlock(&mutex);  // Unlock the mutex after modifying the stack.
-        isClearing.store(false);  // Reset the clearing flag to false.
+// Take values with wait_pop() until the -1 that marks the end of the work.
+template<typename Stack>
+void* workConsumer(void* arg) {
+    auto args = static_cast<WorkQueueArgs<Stack>*>(arg);
+    while (args->stack->wait_pop() != -1) {
+        args->consumed->fetch_add(1, std::memory_order_relaxed);
     }
+    return nullptr;
+}
+
+// Use a blocking stack as a producer/consumer work queue: half the threads produce, half consume with wait_pop().
+// Idle consumers sleep rather than spin, so CPU time stays well below threads x wall time.
+template<typename Stack>
+int runWorkQueue(const Workload& workload, Stack& stack) {
+    const int pairs = workload.threads > 1 ? workload.threads / 2 : 1;
+    std::atomic<long long> consumed{0};
+    WorkQueueArgs<Stack> args{&stack, workload.iterations * 6, &consumed};
+    std::vector<pthread_t> producers(pairs), consumers(pairs);
+    rusage before;
+    getrusage(RUSAGE_SELF, &before);
+    auto start = std::chrono::steady_clock::now();
+    for (auto& thread : consumers) pthread_create(&thread, nullptr, workConsumer<Stack>, &args);
+    for (auto& thread : producers) pthread_create(&thread, nullptr, workProducer<Stack>, &args);
+    for (auto& thread : producers) pthread_join(thread, nullptr);
+    for (int i = 0; i < pairs; ++i) stack.push(-1);  // One end marker per consumer.
+    for (auto& thread : consumers) pthread_join(thread, nullptr);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    rusage after;
+    getrusage(RUSAGE_SELF, &after);
+    auto seconds = [](const timeval& t) { return static_cast<double>(t.tv_sec) + static_cast<double>(t.tv_usec) / 1e6; };
+    const double cpu = seconds(after.ru_utime) - seconds(before.ru_utime) + seconds(after.ru_stime) - seconds(before.ru_stime);
+    std::cout << pairs << " producers, " << pairs << " consumers: consumed " << consumed.load() << " of "
+              << static_cast<long long>(pairs) * args.items << " values in " << elapsed.count() << " s wall, "
+              << cpu << " s CPU\n";
+    return consumed.load() == static_cast<long long>(pairs) * args.items ? 0 : 1;
+}
+
+// Define a coroutine type that starts at once and frees its frame when it finishes; enough to run the async_pop()
+// consumers of the demo below without a scheduler.
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
 };
 
-// Define a function that performs a sequence of stack operations. This function is intended to be used with pthreads.
-void* testStack(void* arg) {
-    // Cast the void pointer to a pointer of ThreadSafeStack<int> type.
-    auto stack = static_cast<ThreadSafeStack<int>*>(arg);
-    // Loop 500 times to perform stack operations.
-    for (int i = 0; i < 500; ++i) {
-        try {
-            // 3 intermixed push and pop operations
-            // 'i * 3 + _' is a way to generate distinct values for each iteration of the loop that are evenly spaced apart
-            stack->push(i * 3 + 1);
-            stack->push(i * 3 + 2);
-            stack->pop();
-            stack->push(i * 3 + 3);
-            stack->pop();
-            stack->pop();
-        } catch (const std::runtime_error& e) {
-            // If an error occurs during the stack operations, log the error message.
-            std::cerr << "Operation error: " << e.what() << "\n";
-        }
+// Take values with co_await async_pop() until the -1 that marks the end of the work. The coroutine runs on
+// whichever producer thread handed it the value it was waiting for.
+template<typename Stack>
+DetachedTask asyncConsumer(Stack& stack, std::atomic<long long>& consumed, std::atomic<int>& finished) {
+    for (;;) {
+        const int value = co_await stack.async_pop();
+        if (value == -1) break;
+        consumed.fetch_add(1, std::memory_order_relaxed);
     }
-    // Return null as the function is used as a thread routine which does not need to return any value.
-    return nullptr;
+    finished.fetch_add(1, std::memory_order_release);
 }
 
-// Main Control Flow
-int main() {
-    // Create a vector to store handles of 200 threads.
-    std::vector<pthread_t> threads(200);
-    // Instantiate a thread-safe stack to be shared among threads.
-    ThreadSafeStack<int> stack;
+// Run the work-queue workload with coroutine consumers: half the threads produce, while as many consumers are
+// coroutines suspended in async_pop(), which take no thread at all while the stack is empty.
+int runAsyncQueue(const Workload& workload) {
+    using Stack = ThreadSafeStack<int, NoLog>;
+    const int pairs = workload.threads > 1 ? workload.threads / 2 : 1;
+    Stack stack;
+    std::atomic<long long> consumed{0};
+    std::atomic<int> finished{0};
+    WorkQueueArgs<Stack> args{&stack, workload.iterations * 6, &consumed};
+    std::vector<pthread_t> producers(pairs);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < pairs; ++i) asyncConsumer(stack, consumed, finished);  // Each suspends at its first co_await.
+    for (auto& thread : producers) pthread_create(&thread, nullptr, workProducer<Stack>, &args);
+    for (auto& thread : producers) pthread_join(thread, nullptr);
+    for (int i = 0; i < pairs; ++i) stack.push(-1);  // One end marker per consumer, each resumed right here.
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << pairs << " producers, " << finished.load(std::memory_order_acquire) << " coroutine consumers: consumed "
+              << consumed.load() << " of " << static_cast<long long>(pairs) * args.items << " values in "
+              << elapsed.count() << " s\n";
+    return consumed.load() == static_cast<long long>(pairs) * args.items && finished.load() == pairs ? 0 : 1;
+}
 
-    // Iterate over the vector to create threads.
-    for (auto& thread : threads) {
-        // Create a new thread that runs the testStack function with a reference to 'stack'.
-        if (pthread_create(&thread, nullptr, testStack, &stack) != 0) {
-            // If thread creation fails, print an error message and exit with code 1.
-            std::cerr << "Failed to create thread." << std::endl;
+// Main Control Flow
+int main(int argc, char* argv[]) {
+    // Pass "lockfree" or "elimination" as the first argument to run the workload on LockFreeStack or EliminationStack
+    // instead of the mutex-based stack, "packed" for LockFreeStack with PackedRepresentation, "combining" for
+    // FlatCombiningStack, "segmented" for SegmentedStack, "sharded" for ShardedStack, "numa" for NumaStack, "cohort"
+    // for the mutex-based stack with a CohortLock, "adaptive" for AdaptiveStack, which also prints its switches,
+    // "configured" for ConfiguredStack with the policies chosen at build time (stack_config.h), or "nolog" / "binlog" /
+    // "mmaplog" to run the mutex-based stack without a trace, with a binary trace in output.bin, or with a
+    // memory-mapped trace in output.trace. "bulk" compares push_bulk/pop_n against one call per element, and "stats"
+    // runs the mutex-based and lock-free stacks with ContentionStats and prints their counters. "workqueue" runs
+    // producers against consumers that block in wait_pop(), and "bounded" does the same on a BoundedStack whose
+    // producers block when it is full; "async" runs the same producers against coroutine consumers suspended in
+    // co_await async_pop(). The workload options listed at Workload follow the variant.
+    const char* variant = argc > 1 && std::strncmp(argv[1], "--", 2) != 0 ? argv[1] : "";
+    Workload workload;
+    if (!parseWorkload(argc, argv, *variant != '\0' ? 2 : 1, workload)) return 1;
+    if (std::strcmp(variant, "bulk") == 0) {
+        compareBulk<ThreadSafeStack<int, NoLog>>("ThreadSafeStack");
+        compareBulk<LockFreeStack<int>>("LockFreeStack");
+        compareBulk<EliminationStack<int>>("EliminationStack");
+        compareBulk<FlatCombiningStack<int, NoLog>>("FlatCombiningStack");
+        compareBulk<SegmentedStack<int, NoLog>>("SegmentedStack");
+        return 0;
+    }
+    if (std::strcmp(variant, "stats") == 0) {
+        using InstrumentedStack = ThreadSafeStack<int, NoLog, PooledNodeAllocator, ContentionStats>;
+        using InstrumentedLockFree = LockFreeStack<int, PooledNodeAllocator, ContentionStats>;
+        std::cout << "ThreadSafeStack: ";
+        int status = runWorkload<InstrumentedStack>(workload, ".txt", printStats<InstrumentedStack>);
+        std::cout << "LockFreeStack: ";
+        return status != 0 ? status : runWorkload<InstrumentedLockFree>(workload, ".txt", printStats<InstrumentedLockFree>);
+    }
+    if (std::strcmp(variant, "workqueue") == 0) {
+        ThreadSafeStack<int, NoLog> stack;
+        return runWorkQueue(workload, stack);
+    }
+    if (std::strcmp(variant, "async") == 0) {
+        return runAsyncQueue(workload);
+    }
+    if (std::strcmp(variant, "bounded") == 0) {
+        BoundedStack<int, NoLog> stack(256);  // Smaller than a burst from every producer, so producers block.
+        std::atomic<int> highWaterHits{0};  // The callback runs on whichever producer crossed the mark.
+        stack.set_high_water(192, [&highWaterHits](std::size_t) { highWaterHits.fetch_add(1, std::memory_order_relaxed); });
+        int status = runWorkQueue(workload, stack);
+        std::cout << "capacity " << stack.capacity() << ", high-water mark reached " << highWaterHits.load() << " times\n";
+        return status;
+    }
+    if (std::strcmp(variant, "combining") == 0) {
+        return runLogged<FlatCombiningStack<int>, FlatCombiningStack<int, NoLog>>(workload);
+    }
+    if (std::strcmp(variant, "sharded") == 0) {
+        return runWorkload<ShardedStack<int>>(workload);
+    }
+    if (std::strcmp(variant, "numa") == 0) {
+        return runWorkload<NumaStack<int>>(workload);
+    }
+    if (std::strcmp(variant, "cohort") == 0) {
+        return runWorkload<ThreadSafeStack<int, NoLog, PooledNodeAllocator, NoStats, CohortLock>>(workload);
+    }
+    if (std::strcmp(variant, "adaptive") == 0) {
+        return runWorkload<AdaptiveStack<int>>(workload, ".txt", printAdaptive);
+    }
+    if (std::strcmp(variant, "configured") == 0) {
+        return runWorkload<ConfiguredStack<int>>(workload);
+    }
+    if (std::strcmp(variant, "segmented") == 0) {
+        return runLogged<SegmentedStack<int>, SegmentedStack<int, NoLog>>(workload);
+    }
+    if (std::strcmp(variant, "nolog") == 0) {
+        return runWorkload<ThreadSafeStack<int, NoLog>>(workload);
+    }
+    if (std::strcmp(variant, "mmaplog") == 0) {
+        if (workload.perThread) {  // Every trace file is preallocated, so one per thread would reserve too much disk.
+            std::cerr << "The mmaplog variant needs --mode shared.\n";
             return 1;
         }
+        return runLogged<ThreadSafeStack<int, MappedLog>, ThreadSafeStack<int, NoLog>>(workload, ".trace");
     }
-
-    // Wait for all threads to finish execution by joining each one.
-    for (auto& thread : threads) {
-        pthread_join(thread, nullptr);
+    if (std::strcmp(variant, "binlog") == 0) {
+        return runLogged<ThreadSafeStack<int, BinaryLog>, ThreadSafeStack<int, NoLog>>(workload, ".bin");
     }
-
-    // Clear the stack to release any remaining resources.
-    stack.clear();
-
-    std::cout << "Program complete.\n";
-    return 0;
+    if (std::strcmp(variant, "lockfree") == 0 || std::strcmp(variant, "elimination") == 0) {
+        int status = std::strcmp(variant, "lockfree") == 0 ? runWorkload<LockFreeStack<int>>(workload)
+                                                          : runWorkload<EliminationStack<int>>(workload);
+        EpochDomain::global().flush();  // Release whatever garbage the main thread can free now.
+        ReclaimStats stats = EpochDomain::global().stats();  // Report how much garbage is still waiting.
+        std::cout << "Reclaimed " << stats.reclaimed << " of " << stats.retired << " retired nodes ("
+                  << stats.pending << " pending, avg latency " << stats.avgReclaimLatencyNs << " ns).\n";
+        return status;
+    }
+    if (std::strcmp(variant, "packed") == 0) {  // No nodes, so there is no reclamation to report.
+        return runWorkload<LockFreeStack<int, PooledNodeAllocator, NoStats, PackedRepresentation>>(workload);
+    }
+    if (*variant != '\0') {
+        std::cerr << "Unknown variant: " << variant << "\n";
+        return 1;
+    }
+    return runLogged<ThreadSafeStack<int>, ThreadSafeStack<int, NoLog>>(workload);
 }
@@ -0,0 +1,255 @@
+#ifndef MAPPED_TRACE_H
+#define MAPPED_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "async_log.h"
+#include "cache_line.h"
+
+// Binary operation trace written straight into a memory-mapped file, for tracing that is cheap enough to leave on.
+// The file is preallocated and split into fixed-size regions. Each thread claims a region of its own on its first
+// record and a fresh one when it fills up, so recording is a few stores into memory no other thread writes: no
+// lock, no ring, no writer thread and no syscall. Because the data lives in a shared file mapping, records already
+// written survive a crash of the process. trace_decode turns a trace back into text and checks it.
+//
+// File layout, all native byte order:
+//   bytes [0, kTraceHeaderBytes)      TraceFileHeader
+//   then regionCount regions of regionBytes each: a TraceRegionHeader followed by regionRecords TraceRecords.
+
+// Define one trace record: what happened, on which thread and when.
+struct TraceRecord {
+    std::int64_t value;  // Logged value, or its hash when hashed is set.
+    std::uint64_t ticks;  // Timestamp from readTraceClock().
+    std::uint32_t thread;  // Small sequential id of the logging thread (logThreadId()).
+    LogOp op;  // Operation that was performed.
+    bool hashed;  // Whether value holds std::hash of a non-integral payload.
+    std::uint16_t reserved;  // Zero.
+};
+
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord is part of the mapped trace format");
+
+inline constexpr char kTraceMagic[8] = {'S', 'T', 'K', 'T', 'R', 'A', 'C', 'E'};
+inline constexpr std::uint32_t kTraceVersion = 1;
+inline constexpr std::size_t kTraceHeaderBytes = 4096;  // One page, so the regions start page-aligned.
+
+// Define the file header. The counters are updated in place while the trace is being written.
+struct TraceFileHeader {
+    char magic[8];  // kTraceMagic.
+    std::uint32_t version;  // kTraceVersion.
+    std::uint32_t recordBytes;  // sizeof(TraceRecord).
+    std::uint64_t regionBytes;  // Size of one region, header included.
+    std::uint64_t regionRecords;  // Records that fit in one region.
+    std::uint64_t regionCount;  // Regions the file was created with.
+    std::uint32_t ticksAreCycles;  // 1 if ticks come from the TSC, 0 if they are already nanoseconds.
+    std::uint32_t reserved;
+    std::int64_t startTicks;  // Clock reading when the trace was opened...
+    std::int64_t startNs;  // ...and the steady_clock time at that moment, in nanoseconds.
+    std::atomic<std::int64_t> endTicks;  // Same pair at a clean close; 0 if the writer did not close the file.
+    std::atomic<std::int64_t> endNs;
+    std::atomic<std::uint64_t> regionsClaimed;  // Regions handed out so far; may exceed regionCount once full.
+    std::atomic<std::uint64_t> dropped;  // Records discarded because every region was in use.
+};
+
+// Define the header of one region, on its own cache line so that neighbouring regions never share one.
+struct alignas(kCacheLineSize) TraceRegionHeader {
+    std::atomic<std::uint64_t> count;  // Records written; each is complete before count covers it.
+    std::uint32_t thread;  // Thread that owns the region.
+    std::uint32_t reserved;
+    std::int64_t claimTicks;  // Clock reading when the region was claimed...
+    std::int64_t claimNs;  // ...and the steady_clock time then. Decoders use these pairs to convert ticks to time.
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "the mapped trace relies on lock-free 64-bit atomics");
+static_assert(sizeof(TraceFileHeader) <= kTraceHeaderBytes, "TraceFileHeader must fit in its page");
+
+// Return the current steady_clock time in nanoseconds.
+inline std::int64_t traceNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Return a timestamp for a trace record: the TSC where there is one, steady_clock nanoseconds elsewhere.
+// RDTSCP waits for the instructions before it, so a record taken after an operation is not stamped before it.
+inline std::int64_t readTraceClock() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int cpu;
+    return static_cast<std::int64_t>(__rdtscp(&cpu));
+#else
+    return traceNowNs();
+#endif
+}
+
+// Return whether readTraceClock() counts TSC cycles rather than nanoseconds.
+inline constexpr bool traceTicksAreCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Define the writer side of a mapped trace.
+class MappedTrace {
+public:
+    static constexpr std::size_t kDefaultFileBytes = 32u << 20;  // Preallocated size of a new trace.
+    static constexpr std::size_t kDefaultRegionRecords = 1024;  // Records per region, about 24 KiB.
+
+private:
+    // Define the calling thread's map from trace id to the region it is filling in that trace.
+    struct ThreadRegions {
+        struct Entry {
+            std::uint64_t traceId;
+            std::shared_ptr<const std::atomic<bool>> closed;  // Set when the trace is destroyed.
+            TraceRegionHeader* region;  // Region being filled, or nullptr once the trace ran out of regions.
+        };
+        std::vector<Entry> entries;
+    };
+
+    const std::uint64_t id;  // Unique id, so a thread's cache never confuses two traces at the same address.
+    int fd;  // Trace file.
+    unsigned char* base;  // Start of the mapping.
+    std::size_t mappedBytes;  // Length of the mapping.
+    TraceFileHeader* header;  // Header at the start of the mapping.
+    std::shared_ptr<std::atomic<bool>> closed;  // Shared with every thread's cache entry.
+
+    static std::uint64_t nextTraceId() {
+        static std::atomic<std::uint64_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    static ThreadRegions& threadRegions() {
+        thread_local ThreadRegions cache;
+        return cache;
+    }
+
+    TraceRegionHeader* regionAt(std::uint64_t index) const {
+        return reinterpret_cast<TraceRegionHeader*>(base + kTraceHeaderBytes + index * header->regionBytes);
+    }
+
+    static TraceRecord* recordsOf(TraceRegionHeader* region) { return reinterpret_cast<TraceRecord*>(region + 1); }
+
+    // Claim the next free region for the calling thread, or return nullptr if the file is full.
+    TraceRegionHeader* claimRegion() {
+        const std::uint64_t index = header->regionsClaimed.fetch_add(1, std::memory_order_relaxed);
+        if (index >= header->regionCount) return nullptr;
+        TraceRegionHeader* region = new (regionAt(index)) TraceRegionHeader{};  // Unclaimed regions stay untouched.
+        region->thread = logThreadId();
+        region->reserved = 0;
+        region->claimTicks = readTraceClock();
+        region->claimNs = traceNowNs();
+        region->count.store(0, std::memory_order_release);
+        return region;
+    }
+
+    // Find the calling thread's cache entry for this trace, claiming a first region on first use.
+    ThreadRegions::Entry& localEntry() {
+        ThreadRegions& cache = threadRegions();
+        for (auto& entry : cache.entries) {
+            if (entry.traceId == id) return entry;
+        }
+        cache.entries.erase(std::remove_if(cache.entries.begin(), cache.entries.end(),
+                                           [](const ThreadRegions::Entry& e) { return e.closed->load(std::memory_order_relaxed); }),
+                            cache.entries.end());  // Forget traces that no longer exist.
+        cache.entries.push_back({id, closed, claimRegion()});
+        return cache.entries.back();
+    }
+
+public:
+    // Constructor to create the trace file at path, preallocated to fileBytes, with regions of regionRecords
+    // records. Throws std::runtime_error if the file cannot be created or mapped.
+    explicit MappedTrace(const std::string& path, std::size_t fileBytes = kDefaultFileBytes,
+                         std::size_t regionRecords = kDefaultRegionRecords)
+        : id(nextTraceId()), fd(-1), base(nullptr), mappedBytes(0), header(nullptr),
+          closed(std::make_shared<std::atomic<bool>>(false)) {
+        const std::size_t regionBytes = sizeof(TraceRegionHeader) + std::max<std::size_t>(regionRecords, 1) * sizeof(TraceRecord);
+        const std::size_t regionCount = fileBytes > kTraceHeaderBytes ? (fileBytes - kTraceHeaderBytes) / regionBytes : 0;
+        if (regionCount == 0) throw std::runtime_error("Trace file too small for one region: " + path);
+        mappedBytes = kTraceHeaderBytes + regionCount * regionBytes;
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::runtime_error("Failed to open trace file: " + path);
+        // Reserve the blocks up front, so a full disk fails here rather than as SIGBUS on a later store.
+        // Filesystems without fallocate support get a sparse file instead.
+        int status = posix_fallocate(fd, 0, static_cast<off_t>(mappedBytes));
+        if (status == EOPNOTSUPP || status == EINVAL) status = ftruncate(fd, static_cast<off_t>(mappedBytes));
+        if (status != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to allocate trace file: " + path);
+        }
+        void* mapping = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Failed to map trace file: " + path);
+        }
+        base = static_cast<unsigned char*>(mapping);
+        header = new (base) TraceFileHeader{};
+        std::memcpy(header->magic, kTraceMagic, sizeof(kTraceMagic));
+        header->version = kTraceVersion;
+        header->recordBytes = sizeof(TraceRecord);
+        header->regionBytes = regionBytes;
+        header->regionRecords = (regionBytes - sizeof(TraceRegionHeader)) / sizeof(TraceRecord);
+        header->regionCount = regionCount;
+        header->ticksAreCycles = traceTicksAreCycles() ? 1 : 0;
+        header->startTicks = readTraceClock();
+        header->startNs = traceNowNs();
+    }
+
+    MappedTrace(const MappedTrace&) = delete;
+    MappedTrace& operator=(const MappedTrace&) = delete;
+
+    // Destructor to close the trace: record the end time, trim the unclaimed regions and unmap the file.
+    // Threads must have stopped logging to this trace.
+    ~MappedTrace() {
+        closed->store(true, std::memory_order_relaxed);
+        header->endTicks.store(readTraceClock(), std::memory_order_relaxed);
+        header->endNs.store(traceNowNs(), std::memory_order_relaxed);
+        const std::uint64_t used = std::min(header->regionsClaimed.load(std::memory_order_relaxed), header->regionCount);
+        const std::size_t keep = kTraceHeaderBytes + used * header->regionBytes;
+        munmap(base, mappedBytes);
+        if (ftruncate(fd, static_cast<off_t>(keep)) != 0) {
+            // Trimming only saves space: the decoder reads just the claimed regions either way.
+        }
+        ::close(fd);
+    }
+
+    // Append a record for op on value to the calling thread's region.
+    template<typename T>
+    void log(LogOp op, const T& value) {
+        ThreadRegions::Entry& entry = localEntry();
+        TraceRegionHeader* region = entry.region;
+        std::uint64_t count = region != nullptr ? region->count.load(std::memory_order_relaxed) : 0;
+        if (region == nullptr || count == header->regionRecords) {
+            region = entry.region = region != nullptr ? claimRegion() : nullptr;
+            if (region == nullptr) {
+                header->dropped.fetch_add(1, std::memory_order_relaxed);
+                return;  // Every region is taken.
+            }
+            count = 0;
+        }
+        const LogRecord packed = makeLogRecord(op, value, region->thread);
+        recordsOf(region)[count] = {packed.value, static_cast<std::uint64_t>(readTraceClock()), packed.thread, op,
+                                    packed.hashed, 0};
+        region->count.store(count + 1, std::memory_order_release);
+    }
+
+    // Return the number of records discarded because the file was full.
+    std::uint64_t dropped() const { return header->dropped.load(std::memory_order_relaxed); }
+};
+
+#endif // MAPPED_TRACE_H
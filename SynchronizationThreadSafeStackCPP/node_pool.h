@@ -0,0 +1,187 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "numa_topology.h"
+
+// Define a pool of fixed-size memory slots shared by every node type with the same size and alignment.
+// Each thread keeps its own free list, so allocate() and deallocate() touch no shared state in the steady state.
+// Memory is carved from slabs of kSlabSlots slots; a thread whose free list runs dry first takes a batch of slots
+// from the central pool and only allocates a new slab if none is available. Slots freed by a thread other than the
+// one that allocated them simply join the freeing thread's list, and once that list grows past two batches one batch
+// is handed back to the central pool under a single lock. Slabs are never returned to the system.
+// There is one central pool per NUMA node, used by the threads whose home node (threadNode()) it is. A slab is
+// carved, and so first touched, by the thread that needed it, so its pages are placed on that thread's node, and
+// batches handed back stay on that node instead of refilling a thread on another socket. Slots only cross nodes with
+// the values that carry them, e.g. when one node's thread pops what another node's thread pushed.
+template<std::size_t Size, std::size_t Align>
+class NodePool {
+public:
+    static constexpr std::size_t kBatchSlots = 128;  // Slots moved between a thread and the central pool at a time.
+    static constexpr std::size_t kSlabSlots = 512;  // Slots carved from one allocation from the system.
+
+private:
+    // Define one slot: either a free-list link or storage for a node.
+    union Slot {
+        Slot* next;
+        alignas(Align) unsigned char bytes[Size];
+    };
+
+    // Define a detached singly linked list of free slots.
+    struct Batch {
+        Slot* head;
+        std::size_t count;
+    };
+
+    // Define the state shared by all threads. It is never destroyed, so threads may exit in any order.
+    struct Central {
+        std::mutex mutex;  // Protects batches and slabs.
+        std::vector<Batch> batches;  // Free slots returned by threads, in kBatchSlots-sized chains.
+        std::vector<Slot*> slabs;  // Every slab allocated so far, kept reachable for the lifetime of the process.
+    };
+
+    // Define the per-thread free list. It is trivially destructible so it stays usable during thread teardown.
+    struct Cache {
+        Slot* head;  // First free slot owned by this thread.
+        std::size_t count;  // Number of slots in the list.
+        bool retired;  // Set once the thread's flusher has run; later frees go straight to the central pool.
+    };
+
+    // Define the object that returns a thread's cached slots to the central pool when the thread exits.
+    struct Flusher {
+        ~Flusher() {
+            Cache& cache = localCache();
+            while (cache.count != 0) {
+                giveBatch(cache, cache.count < kBatchSlots ? cache.count : kBatchSlots);
+            }
+            cache.retired = true;
+        }
+    };
+
+    // Return the central pool of the calling thread's home node.
+    static Central& central() {
+        static auto* instances = new Central[NumaTopology::get().nodeCount()];
+        return instances[threadNode()];
+    }
+
+    static Cache& localCache() {
+        thread_local Cache cache{nullptr, 0, false};
+        return cache;
+    }
+
+    // Access the calling thread's list, registering the exit-time flush on first use.
+    static Cache& registeredCache() {
+        thread_local Flusher flusher;
+        (void)flusher;
+        return localCache();
+    }
+
+    static std::atomic<std::size_t>& slabCounter() {
+        static std::atomic<std::size_t> counter{0};
+        return counter;
+    }
+
+    // Move up to n slots from the front of a thread's list to the central pool.
+    static void giveBatch(Cache& cache, std::size_t n) {
+        Slot* head = cache.head;
+        Slot* tail = head;
+        for (std::size_t i = 1; i < n; ++i) tail = tail->next;
+        cache.head = tail->next;
+        cache.count -= n;
+        tail->next = nullptr;
+        Central& shared = central();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        shared.batches.push_back({head, n});
+    }
+
+    // Refill an empty thread list from the central pool, or from a new slab when the central pool is empty too.
+    static void refill(Cache& cache) {
+        Central& shared = central();
+        {
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            if (!shared.batches.empty()) {
+                Batch batch = shared.batches.back();
+                shared.batches.pop_back();
+                cache.head = batch.head;
+                cache.count = batch.count;
+                return;
+            }
+        }
+        auto slab = static_cast<Slot*>(::operator new(sizeof(Slot) * kSlabSlots, std::align_val_t(alignof(Slot))));
+        for (std::size_t i = 0; i + 1 < kSlabSlots; ++i) slab[i].next = &slab[i + 1];
+        slab[kSlabSlots - 1].next = nullptr;
+        cache.head = slab;
+        cache.count = kSlabSlots;
+        slabCounter().fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        shared.slabs.push_back(slab);
+    }
+
+public:
+    // Take one slot from the calling thread's free list.
+    static void* allocate() {
+        Cache& cache = registeredCache();
+        if (cache.head == nullptr) refill(cache);
+        Slot* slot = cache.head;
+        cache.head = slot->next;
+        --cache.count;
+        return slot;
+    }
+
+    // Return one slot to the calling thread's free list, spilling a batch to the central pool if it grew too long.
+    static void deallocate(void* ptr) {
+        Cache& cache = registeredCache();
+        auto slot = static_cast<Slot*>(ptr);
+        slot->next = cache.head;
+        cache.head = slot;
+        ++cache.count;
+        if (cache.retired) {
+            giveBatch(cache, cache.count);  // The thread is exiting; do not strand the slot in its list.
+        } else if (cache.count >= 2 * kBatchSlots) {
+            giveBatch(cache, kBatchSlots);
+        }
+    }
+
+    // Report how many slabs have been requested from the system, to confirm the hot path stays allocation-free.
+    static std::size_t slabsAllocated() { return slabCounter().load(std::memory_order_relaxed); }
+};
+
+// Define an allocator policy that creates nodes with the global new and delete. Used as a baseline.
+struct HeapNodeAllocator {
+    template<typename Node, typename... Args>
+    static Node* create(Args&&... args) { return new Node(std::forward<Args>(args)...); }
+
+    template<typename Node>
+    static void destroy(Node* node) { delete node; }
+};
+
+// Define an allocator policy that creates nodes in a per-thread NodePool. This is the default for the stacks.
+struct PooledNodeAllocator {
+    template<typename Node>
+    using Pool = NodePool<sizeof(Node), alignof(Node)>;
+
+    template<typename Node, typename... Args>
+    static Node* create(Args&&... args) {
+        void* slot = Pool<Node>::allocate();
+        try {
+            return new (slot) Node(std::forward<Args>(args)...);
+        } catch (...) {
+            Pool<Node>::deallocate(slot);  // Do not leak the slot if the payload constructor throws.
+            throw;
+        }
+    }
+
+    template<typename Node>
+    static void destroy(Node* node) {
+        node->~Node();
+        Pool<Node>::deallocate(node);
+    }
+};
+
+#endif // NODE_POOL_H
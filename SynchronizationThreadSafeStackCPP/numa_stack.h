@@ -0,0 +1,31 @@
+#ifndef NUMA_STACK_H
+#define NUMA_STACK_H
+
+#include <cstddef>
+
+#include "lock_policy.h"
+#include "log_policy.h"
+#include "node_pool.h"
+#include "numa_topology.h"
+#include "sharded_stack.h"
+#include "stack_stats.h"
+#include "thread_safe_stack.h"
+
+// Define the home policy that gives each NUMA node one shard: every thread works on the sub-stack of its home node.
+struct NodeHome {
+    static std::size_t defaultShards() { return NumaTopology::get().nodeCount(); }
+    static std::size_t index() { return threadNode(); }
+};
+
+// Define a NUMA-aware stack for dual- and multi-socket machines: one mutex-based sub-stack per node, so pushes and
+// pops by threads of one node only touch that node's lock, top pointer and nodes. The nodes come from that node's
+// NodePool central pool, so they are allocated and recycled on the node that uses them. Within a node the sub-stack
+// is guarded by a CohortLock, which keeps the lock with the node's threads while they queue for it; thieves from
+// other nodes still get through, but only between local batches. Traffic crosses the interconnect only when a
+// node's sub-stack is empty and its thread steals up to half of another node's values, as in ShardedStack, whose
+// relaxed ordering this shares: LIFO per node, not across the whole stack.
+// Threads should be pinned (e.g. with --pin), since a thread's home node is fixed the first time it asks.
+template<typename T>
+using NumaStack = ShardedStack<T, ThreadSafeStack<T, NoLog, PooledNodeAllocator, NoStats, CohortLock>, NodeHome>;
+
+#endif // NUMA_STACK_H
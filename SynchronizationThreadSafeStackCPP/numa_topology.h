@@ -0,0 +1,113 @@
+#ifndef NUMA_TOPOLOGY_H
+#define NUMA_TOPOLOGY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// NUMA layout of the machine, read from sysfs without libnuma. Nodes are numbered densely from 0 in the order of
+// their kernel ids, counting only the nodes that have a CPU this process may run on, so the index of a node can
+// size per-node arrays directly. A machine, container or kernel that exposes no node information is one node.
+
+// Return the CPUs this process may run on, in ascending order.
+inline std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Parse a sysfs CPU list such as "0-3,8-11".
+inline std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::istringstream ranges(text);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        const std::size_t dash = range.find('-');
+        const int first = std::atoi(range.c_str());
+        const int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// Define the NUMA layout, built once per process.
+class NumaTopology {
+private:
+    std::vector<std::vector<int>> nodeCpus;  // Allowed CPUs of each node, by dense node index.
+    std::vector<std::size_t> cpuNode;  // Dense node index of each CPU; CPUs outside every node map to 0.
+
+    NumaTopology() {
+        const std::vector<int> allowed = allowedCpus();
+        std::vector<int> ids;
+        if (DIR* dir = opendir("/sys/devices/system/node")) {
+            while (dirent* entry = readdir(dir)) {
+                if (std::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+                    ids.push_back(std::atoi(entry->d_name + 4));
+                }
+            }
+            closedir(dir);
+        }
+        std::sort(ids.begin(), ids.end());
+        for (int id : ids) {
+            std::ifstream list("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string text;
+            std::getline(list, text);
+            std::vector<int> cpus;
+            for (int cpu : parseCpuList(text)) {
+                if (std::binary_search(allowed.begin(), allowed.end(), cpu)) cpus.push_back(cpu);
+            }
+            if (!cpus.empty()) nodeCpus.push_back(cpus);
+        }
+        if (nodeCpus.empty()) nodeCpus.push_back(allowed);  // No NUMA information: one node.
+        for (std::size_t node = 0; node < nodeCpus.size(); ++node) {
+            for (int cpu : nodeCpus[node]) {
+                if (static_cast<std::size_t>(cpu) >= cpuNode.size()) cpuNode.resize(static_cast<std::size_t>(cpu) + 1, 0);
+                cpuNode[static_cast<std::size_t>(cpu)] = node;
+            }
+        }
+    }
+
+public:
+    // Return the layout of this machine.
+    static const NumaTopology& get() {
+        static const NumaTopology topology;
+        return topology;
+    }
+
+    // Return the number of nodes; at least 1.
+    std::size_t nodeCount() const { return nodeCpus.size(); }
+
+    // Return the allowed CPUs of every node, by node index.
+    const std::vector<std::vector<int>>& nodes() const { return nodeCpus; }
+
+    // Return the node index of cpu.
+    std::size_t nodeOfCpu(int cpu) const {
+        return cpu >= 0 && static_cast<std::size_t>(cpu) < cpuNode.size() ? cpuNode[static_cast<std::size_t>(cpu)] : 0;
+    }
+
+    // Return the node the calling thread is running on right now.
+    std::size_t currentNode() const { return nodeOfCpu(sched_getcpu()); }
+};
+
+// Return the calling thread's home node: the node it was running on when it first asked. Cached, so hot paths pay
+// one thread-local load. A thread that migrates to another node keeps its old home, so pin threads (e.g. with
+// --pin) where placement matters.
+inline std::size_t threadNode() {
+    thread_local const std::size_t node = NumaTopology::get().currentNode();
+    return node;
+}
+
+#endif // NUMA_TOPOLOGY_H
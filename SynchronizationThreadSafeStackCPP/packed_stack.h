@@ -0,0 +1,242 @@
+#ifndef PACKED_STACK_H
+#define PACKED_STACK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "cache_line.h"
+#include "stack_stats.h"
+
+// Whether T is small enough for PackedStack: trivially copyable, default constructible and at most 4 bytes, so a value
+// fits next to a generation counter in one 64-bit word. For these types the packed form is selected with
+// LockFreeStack<T, Allocator, StatsPolicy, PackedRepresentation>; plain LockFreeStack<T> stays node-based.
+template<typename T>
+inline constexpr bool kPackable =
+    std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T> && sizeof(T) <= sizeof(std::uint32_t);
+
+// Define a lock-free stack of small values kept inline in an array of 64-bit words instead of in nodes.
+// No node is allocated per push and none is ever freed while other threads might read it, so there is nothing to
+// reclaim: the array only grows, in segments of doubling size that live as long as the stack.
+//
+// The top word packs the index of the first free slot with a counter that every operation increments. Every slot
+// word packs a value, a claim state and the low 30 bits of a counter. An operation that finds top at (i, c) claims
+// slot i for counter c + 1 with one CAS: a push writes its value there, a pop or clear writes a marker. Exactly one
+// claim can succeed for each top word, and that CAS is where the operation takes effect. Moving top on to
+// (i + 1, c + 1), (i - 1, c + 1) or (0, c + 1) is a follow-up that any thread completes when it finds a claim pending,
+// so a thread stalled between the two steps never blocks the others. Before top lands on a slot, that slot is reset
+// to unclaimed for counter c + 1, so a claim left behind by an earlier visit can never pass for a pending one, however
+// far the counter has wrapped since; only the claims made while top sits on a slot are ever compared with it.
+// A claim only counts if the slot was read while top still held (i, c), so a thread with a stale top snapshot cannot
+// overwrite a live value: top only leaves (i, c) through a claim on slot i, and every later word there carries a newer
+// counter. That argument, like the tag of the node-based stack, fails only if one thread stalls between its reads
+// and its CAS for 2^30 operations. The value a pop returns is slot i - 1's, read in the same window.
+//
+// Unlike the node-based stack, push_bulk and pop_n move values one at a time, so other threads may interleave.
+// All atomics use the default sequentially consistent ordering: on x86 that costs nothing beyond the CAS itself, and
+// the read-validate-claim argument above relies on the loads staying in program order.
+template<typename T, typename StatsPolicy = NoStats>
+class PackedStack : private StatsPolicy {
+    static_assert(kPackable<T>, "PackedStack holds trivially copyable values of at most 4 bytes");
+
+private:
+    // Claim states stored in bits 30-31 of a slot word.
+    static constexpr std::uint32_t kUnclaimed = 0;  // A fresh slot; never matches a pending claim.
+    static constexpr std::uint32_t kPushed = 1;  // Claimed by a push, whose value the slot holds.
+    static constexpr std::uint32_t kPopped = 2;  // Claimed by a pop of the value in the slot below.
+    static constexpr std::uint32_t kCleared = 3;  // Claimed by clear().
+    static constexpr std::uint32_t kGenMask = (std::uint32_t{1} << 30) - 1;  // Counter bits kept in a slot word.
+
+    static constexpr unsigned kFirstSegmentBits = 6;  // The first segment holds 64 slots; each next one twice as many.
+    static constexpr std::size_t kSegments = 32 - kFirstSegmentBits;  // Segments covering indexes up to kMaxIndex.
+    static constexpr std::uint32_t kMaxIndex = 0xFFFFFFFFu - 64;  // Last slot of the last segment: the stack is full.
+
+    alignas(kCacheLineSize) std::atomic<std::uint64_t> top{0};  // Index of the first free slot << 32 | counter.
+    alignas(kCacheLineSize) std::atomic<std::atomic<std::uint64_t>*> segments[kSegments] = {};  // Slot segments.
+
+    static std::uint64_t packTop(std::uint32_t index, std::uint32_t counter) {
+        return static_cast<std::uint64_t>(index) << 32 | counter;
+    }
+    static std::uint32_t topIndex(std::uint64_t word) { return static_cast<std::uint32_t>(word >> 32); }
+    static std::uint32_t topCounter(std::uint64_t word) { return static_cast<std::uint32_t>(word); }
+
+    static std::uint64_t packSlot(std::uint32_t bits, std::uint32_t state, std::uint32_t counter) {
+        return static_cast<std::uint64_t>(bits) << 32 | state << 30 | (counter & kGenMask);
+    }
+    static std::uint32_t slotBits(std::uint64_t word) { return static_cast<std::uint32_t>(word >> 32); }
+    static std::uint32_t slotState(std::uint64_t word) { return static_cast<std::uint32_t>(word) >> 30; }
+
+    // Check whether a slot word is the claim for the transition to counter.
+    static bool claimedFor(std::uint64_t word, std::uint32_t counter) {
+        return slotState(word) != kUnclaimed && (static_cast<std::uint32_t>(word) & kGenMask) == (counter & kGenMask);
+    }
+
+    static std::uint32_t toBits(const T& value) {
+        std::uint32_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(T));
+        return bits;
+    }
+
+    static T fromBits(std::uint32_t bits) {
+        T value;
+        std::memcpy(&value, &bits, sizeof(T));
+        return value;
+    }
+
+    // Return slot index, creating its segment first if it does not exist yet.
+    std::atomic<std::uint64_t>& slot(std::uint32_t index) {
+        const std::uint64_t offsetFromStart = static_cast<std::uint64_t>(index) + (std::uint64_t{1} << kFirstSegmentBits);
+        const unsigned segment = 63 - static_cast<unsigned>(__builtin_clzll(offsetFromStart)) - kFirstSegmentBits;
+        std::atomic<std::uint64_t>* slots = segments[segment].load();
+        if (slots == nullptr) {
+            const std::size_t size = std::size_t{1} << (kFirstSegmentBits + segment);
+            auto* fresh = new std::atomic<std::uint64_t>[size]();  // Value-initialized: every slot unclaimed.
+            if (segments[segment].compare_exchange_strong(slots, fresh)) {
+                slots = fresh;
+            } else {
+                delete[] fresh;  // Another thread installed the segment first.
+            }
+        }
+        return slots[offsetFromStart - (std::uint64_t{1} << (kFirstSegmentBits + segment))];
+    }
+
+    // Move top past the transition that claim made out of snapshot, unless another thread already has. The slot top
+    // lands on is reset first; it is free, or holds the value being popped, which the claimer has already read.
+    void finish(std::uint64_t snapshot, std::uint64_t claim) {
+        const std::uint32_t index = topIndex(snapshot);
+        const std::uint32_t counter = topCounter(snapshot) + 1;
+        const std::uint32_t state = slotState(claim);
+        const std::uint32_t next = state == kPushed ? index + 1 : state == kPopped ? index - 1 : 0;
+        std::atomic<std::uint64_t>& landing = slot(next);
+        const std::uint64_t reset = packSlot(0, kUnclaimed, counter);
+        for (std::uint64_t word = landing.load(); word != reset && top.load() == snapshot;) {
+            if (landing.compare_exchange_strong(word, reset)) break;  // On failure word is reloaded; check top again.
+        }
+        top.compare_exchange_strong(snapshot, packTop(next, counter));
+    }
+
+    // Claim the transition out of the current top for state, with bits as the slot's value. Completes any claim
+    // already pending and retries until its own claim succeeds, or until giveUp(index) returns true for a top index
+    // that no pending claim is about to change. Returns the top word the claim was made against and stores the bits
+    // of the slot below it in below, or returns std::nullopt if the caller gave up.
+    template<typename GiveUp>
+    std::optional<std::uint64_t> claim(std::uint32_t state, std::uint32_t bits, std::uint32_t& below, GiveUp giveUp) {
+        std::size_t retries = 0;
+        for (;; ++retries) {
+            const std::uint64_t snapshot = top.load();
+            const std::uint32_t index = topIndex(snapshot);
+            std::atomic<std::uint64_t>& target = slot(index);
+            below = index != 0 ? slotBits(slot(index - 1).load()) : 0;
+            std::uint64_t seen = target.load();
+            if (claimedFor(seen, topCounter(snapshot) + 1)) {
+                finish(snapshot, seen);  // Help the operation that got here first, then retry.
+                continue;
+            }
+            if (top.load() != snapshot) continue;  // Top moved while we read the slots, so they may be stale.
+            if (giveUp(index)) {
+                StatsPolicy::countCasRetries(retries);
+                return std::nullopt;
+            }
+            const std::uint64_t mine = packSlot(bits, state, topCounter(snapshot) + 1);
+            if (target.compare_exchange_strong(seen, mine)) {
+                finish(snapshot, mine);
+                StatsPolicy::countCasRetries(retries);
+                return snapshot;
+            }
+        }
+    }
+
+public:
+    // Constructor to initialize an empty stack whose counter starts at firstCounter, so stress runs can cross the
+    // counter's wrap without performing 2^32 operations first.
+    explicit PackedStack(std::uint32_t firstCounter = 0) : top(packTop(0, firstCounter)) {}
+
+    PackedStack(const PackedStack&) = delete;
+    PackedStack& operator=(const PackedStack&) = delete;
+
+    // Destructor to release the segments. No other thread may use the stack by now.
+    ~PackedStack() {
+        for (auto& segment : segments) delete[] segment.load();
+    }
+
+    // Method to push a copy of a value onto the stack. Throws std::length_error once kMaxIndex values are stored, and
+    // std::bad_alloc if a new segment cannot be allocated.
+    void push(const T& value) {
+        std::uint32_t below;
+        StatsPolicy::adjustDepth(1);  // Count the value before it is visible, so depth never dips below zero.
+        const auto claimed = claim(kPushed, toBits(value), below, [](std::uint32_t index) { return index == kMaxIndex; });
+        if (!claimed) {
+            StatsPolicy::adjustDepth(-1);
+            throw std::length_error("PackedStack is full.");
+        }
+        StatsPolicy::countPush();
+    }
+
+    // Method to construct a value and push it. The value is copied into a slot, so this is the same as push.
+    template<typename... Args>
+    void emplace(Args&&... args) { push(T(std::forward<Args>(args)...)); }
+
+    // Method to push every value in [first, last), one at a time; the last value ends up on top.
+    template<typename InputIt>
+    void push_bulk(InputIt first, InputIt last) {
+        for (; first != last; ++first) push(*first);
+    }
+
+    // Method to pop a value from the stack into out. Returns false, without throwing, if the stack is empty.
+    bool try_pop(T& out) {
+        std::uint32_t below;
+        if (!claim(kPopped, 0, below, [](std::uint32_t index) { return index == 0; })) {
+            StatsPolicy::countFailedPop();
+            return false;  // The stack was empty.
+        }
+        StatsPolicy::countPop();
+        StatsPolicy::adjustDepth(-1);
+        out = fromBits(below);
+        return true;
+    }
+
+    // Method to pop a value from the stack. Returns std::nullopt, without throwing, if the stack is empty.
+    std::optional<T> try_pop() {
+        T value;
+        if (!try_pop(value)) return std::nullopt;
+        return value;
+    }
+
+    // Method to pop up to n values one at a time, writing them to out from the top down.
+    // Returns the number of values popped, which is less than n only if the stack ran out.
+    template<typename OutputIt>
+    std::size_t pop_n(OutputIt out, std::size_t n) {
+        std::size_t taken = 0;
+        for (T value; taken < n && try_pop(value); ++taken) *out++ = value;
+        return taken;
+    }
+
+    // Method to pop a value from the stack. Throws std::runtime_error if the stack is empty; prefer try_pop on hot paths.
+    T pop() {
+        std::optional<T> data = try_pop();
+        if (!data) {  // Check if the stack is empty.
+            std::cerr << "Error: Attempted to pop from an empty stack.\n";  // Log an error message.
+            throw std::runtime_error("Attempted to pop an empty stack.");  // Throw an exception.
+        }
+        return *data;  // Return the popped data.
+    }
+
+    // Method to clear the stack with one claim. The slots are kept for reuse.
+    void clear() {
+        std::uint32_t below;
+        const auto claimed = claim(kCleared, 0, below, [](std::uint32_t index) { return index == 0; });
+        if (claimed) StatsPolicy::adjustDepth(-static_cast<std::ptrdiff_t>(topIndex(*claimed)));
+    }
+
+    // Method to take a snapshot of the instrumentation counters. All zero unless StatsPolicy is ContentionStats.
+    StackStats stats() const { return StatsPolicy::snapshot(); }
+};
+
+#endif // PACKED_STACK_H
@@ -0,0 +1,148 @@
+#ifndef REALTIME_STACK_H
+#define REALTIME_STACK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <utility>
+
+#include "lock_policy.h"
+#include "log_policy.h"
+#include "stack_node.h"
+#include "stack_stats.h"
+#include "thread_safe_stack.h"
+
+// Define a fixed pool of memory slots, reserved once and locked into RAM, shared by every node type with the same
+// size and alignment. Unlike NodePool it never grows: reserve() maps and locks all the memory up front, so an
+// allocation is never a page fault, an mmap or a lock of a central pool, and its worst case is a bounded number of
+// compare-exchange retries against other threads using the arena. allocate() throws std::bad_alloc once every slot
+// is in use; size the arena for the deepest stack the application allows.
+// Free slots form a Treiber list of 32-bit indices. The links live in their own atomic array next to the slots, so a
+// thread reading the link of a slot that another thread has just taken reads an atomic, never the node being built
+// there, and the 32-bit tag next to the head index makes a slot that is taken and returned in between look changed.
+template<std::size_t Size, std::size_t Align>
+class LockedArena {
+private:
+    static_assert(Align <= 4096, "Slots are aligned within page-aligned memory");
+
+    static constexpr std::uint32_t kNil = UINT32_MAX;  // Index of no slot; ends the free list.
+    static constexpr std::size_t kStride = (Size + Align - 1) / Align * Align;  // Bytes from one slot to the next.
+
+    static inline std::atomic<std::uint64_t> head{kNil};  // Tag in the high half, first free index in the low half.
+    static inline std::atomic<std::uint32_t>* links = nullptr;  // Link of each free slot to the next one.
+    static inline unsigned char* slots = nullptr;  // kStride-byte slots, Align-aligned.
+    static inline std::uint32_t slotCount = 0;
+    static inline std::atomic<bool> reserved{false};
+
+    static std::uint64_t pack(std::uint64_t oldHead, std::uint32_t index) {
+        return ((oldHead >> 32) + 1) << 32 | index;
+    }
+
+public:
+    // Map, prefault and lock count slots. Call once, before any thread allocates; the threads started afterwards see
+    // the arena through the thread creation. Throws std::runtime_error if the memory cannot be mapped or locked, e.g.
+    // when RLIMIT_MEMLOCK is too small, and std::logic_error if the arena was already reserved.
+    static void reserve(std::size_t count) {
+        if (count == 0 || count >= kNil) throw std::invalid_argument("Arena slot count out of range");
+        if (reserved.exchange(true)) throw std::logic_error("Arena already reserved");
+        const std::size_t linkBytes = (count * sizeof(std::atomic<std::uint32_t>) + Align - 1) / Align * Align;
+        const std::size_t bytes = linkBytes + count * kStride;
+        void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (mapping == MAP_FAILED) {
+            reserved.store(false);
+            throw std::runtime_error("Failed to map arena of " + std::to_string(bytes) + " bytes");
+        }
+        if (mlock(mapping, bytes) != 0) {
+            munmap(mapping, bytes);
+            reserved.store(false);
+            throw std::runtime_error("Failed to lock arena of " + std::to_string(bytes) + " bytes (see ulimit -l)");
+        }
+        links = new (mapping) std::atomic<std::uint32_t>[count];
+        slots = static_cast<unsigned char*>(mapping) + linkBytes;
+        slotCount = static_cast<std::uint32_t>(count);
+        for (std::uint32_t i = 0; i < slotCount; ++i) links[i].store(i + 1 < slotCount ? i + 1 : kNil, std::memory_order_relaxed);
+        head.store(0, std::memory_order_release);
+    }
+
+    // Take one free slot. Throws std::bad_alloc if the arena is exhausted or was never reserved.
+    static void* allocate() {
+        std::uint64_t current = head.load(std::memory_order_acquire);
+        for (;;) {
+            const auto index = static_cast<std::uint32_t>(current);
+            if (index == kNil) throw std::bad_alloc();
+            const std::uint32_t next = links[index].load(std::memory_order_relaxed);
+            if (head.compare_exchange_weak(current, pack(current, next), std::memory_order_acquire, std::memory_order_acquire)) {
+                return slots + std::size_t{index} * kStride;
+            }
+        }
+    }
+
+    // Put a slot taken with allocate() back on the free list.
+    static void deallocate(void* ptr) {
+        const auto index = static_cast<std::uint32_t>((static_cast<unsigned char*>(ptr) - slots) / kStride);
+        std::uint64_t current = head.load(std::memory_order_relaxed);
+        do {
+            links[index].store(static_cast<std::uint32_t>(current), std::memory_order_relaxed);
+        } while (!head.compare_exchange_weak(current, pack(current, index), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Report how many slots were reserved; zero before reserve().
+    static std::size_t capacity() { return reserved.load(std::memory_order_acquire) ? slotCount : 0; }
+};
+
+// Define an allocator policy that creates nodes in a LockedArena. Reserve the arena of each node type with reserve()
+// before the first push; there is no fallback to the heap, since a hidden allocation is the latency spike this
+// allocator exists to rule out.
+struct LockedNodeAllocator {
+    template<typename Node>
+    using Arena = LockedArena<sizeof(Node), alignof(Node)>;
+
+    // Method to reserve room for count nodes of type Node.
+    template<typename Node>
+    static void reserve(std::size_t count) { Arena<Node>::reserve(count); }
+
+    template<typename Node, typename... Args>
+    static Node* create(Args&&... args) {
+        void* slot = Arena<Node>::allocate();
+        try {
+            return new (slot) Node(std::forward<Args>(args)...);
+        } catch (...) {
+            Arena<Node>::deallocate(slot);  // Do not leak the slot if the payload constructor throws.
+            throw;
+        }
+    }
+
+    template<typename Node>
+    static void destroy(Node* node) {
+        node->~Node();
+        Arena<Node>::deallocate(node);
+    }
+};
+
+// Define the stack for real-time threads: a ThreadSafeStack whose nodes come from a locked arena and whose mutex
+// applies priority inheritance, without a log or counters. push() and pop() then make no system call and allocate
+// nothing, unless the lock is contended (a futex wait, with the holder boosted to the waiter's priority) or a
+// consumer sleeps in wait_pop(). Priority inheritance only bounds the wait when the threads run under a real-time
+// policy such as SCHED_FIFO; under SCHED_OTHER there are no priorities to inherit. T should not allocate either:
+// a std::string payload brings the heap back on every push.
+template<typename T>
+using RealtimeStack = ThreadSafeStack<T, NoLog, LockedNodeAllocator, NoStats, PriorityInheritLock>;
+
+// Reserve room for count nodes of RealtimeStack<T>. The arena is shared by every RealtimeStack with the same node
+// size, so reserve the total across them.
+template<typename T>
+void reserveRealtimeNodes(std::size_t count) {
+    LockedNodeAllocator::reserve<StackNode<T>>(count);
+}
+
+// Lock every current and future page of the process into RAM, so neither the code nor the stacks of the real-time
+// threads can page out and fault back in. Returns false if the process may not lock that much (see ulimit -l).
+inline bool lockProcessMemory() {
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+}
+
+#endif // REALTIME_STACK_H
@@ -0,0 +1,313 @@
+#ifndef SEGMENTED_STACK_H
+#define SEGMENTED_STACK_H
+
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "cache_line.h"
+#include "lock_policy.h"
+#include "log_policy.h"
+
+// Define a generic, thread-safe stack that stores elements contiguously in fixed-size chunks.
+// Instead of one StackNode allocation and one next pointer per element, values sit side by side in cache-line
+// aligned chunks of about ChunkBytes bytes, linked to the chunk below. Push and pop touch the slot next to the one
+// touched last, so they stay within a cache line or two instead of chasing a pointer per element. When the top chunk
+// empties it is kept as a spare rather than freed, so a workload that oscillates around a chunk boundary does not
+// allocate and free a chunk on every crossing. The locking and logging model is the same as ThreadSafeStack, including
+// the choice of LockPolicy (see lock_policy.h).
+template<typename T, typename LogPolicy = TextLog, std::size_t ChunkBytes = 4096, typename LockPolicy = PthreadLock>
+class SegmentedStack : private LogPolicy {
+private:
+    using Held = typename LockPolicy::QueueNode;  // Per-acquisition lock state, kept on the caller's stack frame.
+
+    // Define one chunk: a link to the chunk below and raw storage for kCapacity elements.
+    struct Chunk;
+    struct ChunkHeader {
+        Chunk* below;  // Next chunk down the stack, or nullptr.
+    };
+
+public:
+    // Number of elements that fit in one chunk.
+    static constexpr std::size_t kCapacity =
+        ChunkBytes > sizeof(ChunkHeader) + sizeof(T) ? (ChunkBytes - sizeof(ChunkHeader)) / sizeof(T) : 1;
+
+private:
+    struct alignas(kCacheLineSize) Chunk : ChunkHeader {
+        alignas(T) unsigned char storage[kCapacity * sizeof(T)];  // Element slots, filled from index 0 upward.
+
+        T* slot(std::size_t i) { return std::launder(reinterpret_cast<T*>(storage) + i); }
+    };
+
+    // The fields written under the lock start a cache line of their own, away from the log policy in the base class.
+    alignas(kCacheLineSize) Chunk* current;  // Top chunk, or nullptr if the stack holds no chunk at all.
+    std::size_t used;  // Number of constructed elements in current; 0 only when the stack is empty.
+    Chunk* spare;  // Empty chunk kept for the next boundary crossing, or nullptr.
+    LockPolicy mutex;  // Lock to ensure thread safety during operations.
+
+    static Chunk* allocateChunk() { return new Chunk; }  // Default-initialized: the slots stay uninitialized.
+
+    static void freeChunk(Chunk* chunk) { delete chunk; }
+
+    // Make room for one more element, stacking the spare or a new chunk when the top one is full.
+    // Must be called with mutex held.
+    void ensureSlot() {
+        if (current != nullptr && used < kCapacity) return;
+        Chunk* chunk = spare != nullptr ? spare : allocateChunk();
+        spare = nullptr;
+        chunk->below = current;
+        current = chunk;
+        used = 0;
+    }
+
+    // Step down to the chunk below once the top chunk has emptied. Must be called with mutex held.
+    void releaseEmptyChunk() {
+        if (used != 0 || current == nullptr || current->below == nullptr) return;
+        Chunk* empty = current;
+        current = current->below;
+        used = kCapacity;
+        if (spare == nullptr) {
+            spare = empty;  // Keep it for the next push that crosses the boundary.
+        } else {
+            freeChunk(empty);
+        }
+    }
+
+    // Move the top element into out. Must be called with mutex held and the stack non-empty.
+    template<typename Out>
+    void takeTop(Out& out) {
+        T* slot = current->slot(used - 1);
+        out = std::move(*slot);
+        slot->~T();
+        --used;
+        releaseEmptyChunk();
+    }
+
+    // Check whether the stack is empty. Must be called with mutex held.
+    bool emptyLocked() const { return current == nullptr || used == 0; }
+
+    // Return the depth of the stack, counting no further than limit. Must be called with mutex held.
+    std::size_t depthUpTo(std::size_t limit) const {
+        if (current == nullptr) return 0;
+        std::size_t depth = used;
+        for (Chunk* chunk = current->below; chunk != nullptr && depth < limit; chunk = chunk->below) depth += kCapacity;
+        return depth < limit ? depth : limit;
+    }
+
+    // Construct a value in the next free slot. Must be called with mutex held.
+    template<typename... Args>
+    void constructTop(Args&&... args) {
+        ensureSlot();
+        new (current->storage + used * sizeof(T)) T(std::forward<Args>(args)...);
+        ++used;
+    }
+
+    // Construct a value on top of the stack in one critical section.
+    template<typename... Args>
+    void pushLocked(Args&&... args) {
+        Held held;
+        mutex.lock(held);  // Lock the mutex before modifying the stack.
+        try {
+            constructTop(std::forward<Args>(args)...);
+        } catch (...) {
+            releaseEmptyChunk();  // Drop the chunk ensureSlot() may have stacked for the value that failed.
+            mutex.unlock(held);
+            throw;
+        }
+        mutex.unlock(held);  // Unlock the mutex after modifying the stack.
+    }
+
+    // Construct every value in [first, last) on top of the stack in one critical section. linked counts the values
+    // constructed, so a caller can tell how far a push that threw got.
+    template<typename InputIt>
+    void pushRange(InputIt first, InputIt last, std::size_t& linked) {
+        Held held;
+        mutex.lock(held);  // Lock the mutex before modifying the stack.
+        try {
+            for (; first != last; ++first, ++linked) constructTop(*first);
+        } catch (...) {
+            releaseEmptyChunk();  // Values pushed before the failure stay on the stack; an empty new chunk does not.
+            mutex.unlock(held);
+            throw;
+        }
+        mutex.unlock(held);  // Unlock the mutex after modifying the stack.
+    }
+
+public:
+    // Constructor to initialize the stack. Any arguments go to the log policy, e.g. a trace file path.
+    template<typename... LogArgs>
+    explicit SegmentedStack(LogArgs&&... logArgs)
+        : LogPolicy(std::forward<LogArgs>(logArgs)...), current(nullptr), used(0), spare(nullptr) {}
+
+    SegmentedStack(const SegmentedStack&) = delete;
+    SegmentedStack& operator=(const SegmentedStack&) = delete;
+
+    // Destructor to clean up resources.
+    ~SegmentedStack() {
+        clear();  // Destroy the elements and all but the spare chunk.
+        if (spare != nullptr) freeChunk(spare);
+    }
+
+    // Method to push a copy of a value onto the stack.
+    void push(const T& value) { emplace(value); }
+
+    // Method to push a value onto the stack, moving it into its slot.
+    void push(T&& value) { emplace(std::move(value)); }
+
+    // Method to construct a value in place on top of the stack. Without a log the value is built in its slot, so unlike
+    // the node-based stacks the construction happens under the lock. A logging stack builds and records the value
+    // before taking the lock and moves it in, so the log never adds to the time the lock is held. If the move or a new
+    // chunk then throws, it records LogOp::Rejected for the value, as BoundedStack does, to cancel the push.
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        if constexpr (kRecordsOps<LogPolicy>) {
+            T value(std::forward<Args>(args)...);
+            LogPolicy::record(LogOp::Push, value);  // Log while the value is still private; once pushed it may be popped.
+            try {
+                pushLocked(std::move(value));
+            } catch (...) {
+                LogPolicy::record(LogOp::Rejected, value);  // Withdraw the push recorded above.
+                throw;
+            }
+        } else {
+            pushLocked(std::forward<Args>(args)...);
+        }
+    }
+
+    // Method to pop a value from the stack into out. Returns false, without throwing, if the stack is empty.
+    bool try_pop(T& out) {
+        Held held;
+        mutex.lock(held);  // Lock the mutex before modifying the stack.
+        if (emptyLocked()) {
+            mutex.unlock(held);
+            return false;  // The stack was empty.
+        }
+        takeTop(out);
+        mutex.unlock(held);  // Unlock the mutex after modifying the stack.
+        LogPolicy::record(LogOp::Pop, out);  // Log the pop operation outside the lock.
+        return true;
+    }
+
+    // Method to pop a value from the stack. Returns std::nullopt, without throwing, if the stack is empty.
+    std::optional<T> try_pop() {
+        Held held;
+        mutex.lock(held);  // Lock the mutex before modifying the stack.
+        if (emptyLocked()) {
+            mutex.unlock(held);
+            return std::nullopt;  // The stack was empty.
+        }
+        std::optional<T> data(std::move(*current->slot(used - 1)));
+        current->slot(used - 1)->~T();
+        --used;
+        releaseEmptyChunk();
+        mutex.unlock(held);  // Unlock the mutex after modifying the stack.
+        LogPolicy::record(LogOp::Pop, *data);  // Log the pop operation outside the lock.
+        return data;
+    }
+
+    // Method to pop a value from the stack. Throws std::runtime_error if the stack is empty; prefer try_pop on hot paths.
+    T pop() {
+        std::optional<T> data = try_pop();
+        if (!data) {  // Check if the stack is empty.
+            std::cerr << "Error: Attempted to pop from an empty stack.\n";  // Log an error message.
+            throw std::runtime_error("Attempted to pop an empty stack.");  // Throw an exception.
+        }
+        return std::move(*data);  // Return the popped data.
+    }
+
+    // Method to push every value in [first, last) in one critical section; the last value ends up on top.
+    // A logging stack copies and records the values before taking the lock and moves them in; if that stops partway,
+    // the values that were not moved in are recorded as LogOp::Rejected.
+    template<typename InputIt>
+    void push_bulk(InputIt first, InputIt last) {
+        if (first == last) return;
+        std::size_t linked = 0;
+        if constexpr (kRecordsOps<LogPolicy>) {
+            std::vector<T> staged(first, last);
+            for (const T& value : staged) LogPolicy::record(LogOp::Push, value);
+            try {
+                pushRange(std::make_move_iterator(staged.begin()), std::make_move_iterator(staged.end()), linked);
+            } catch (...) {
+                for (std::size_t i = linked; i < staged.size(); ++i) LogPolicy::record(LogOp::Rejected, staged[i]);
+                throw;
+            }
+        } else {
+            pushRange(first, last, linked);
+        }
+    }
+
+    // Method to pop up to n values in one critical section, writing them to out from the top down.
+    // A logging stack moves the values into a buffer reserved before the lock is taken, and records and hands them
+    // out after releasing it.
+    template<typename OutputIt>
+    std::size_t pop_n(OutputIt out, std::size_t n) {
+        if (n == 0) return 0;
+        Held held;
+        if constexpr (kRecordsOps<LogPolicy>) {
+            std::vector<T> staged;
+            for (;;) {
+                mutex.lock(held);  // Lock the mutex before modifying the stack.
+                const std::size_t wanted = depthUpTo(n);
+                if (staged.capacity() >= wanted) break;
+                mutex.unlock(held);
+                staged.reserve(wanted);  // Grow the buffer outside the lock, then look again.
+            }
+            while (staged.size() < n && !emptyLocked()) {
+                T* slot = current->slot(used - 1);
+                staged.push_back(std::move(*slot));
+                slot->~T();
+                --used;
+                releaseEmptyChunk();
+            }
+            mutex.unlock(held);  // Unlock the mutex after modifying the stack.
+            for (T& value : staged) {
+                LogPolicy::record(LogOp::Pop, value);  // Log the pop operations outside the lock.
+                *out++ = std::move(value);
+            }
+            return staged.size();
+        } else {
+            std::size_t taken = 0;
+            mutex.lock(held);  // Lock the mutex before modifying the stack.
+            while (taken < n && !emptyLocked()) {
+                T* slot = current->slot(used - 1);
+                *out++ = std::move(*slot);
+                slot->~T();
+                --used;
+                releaseEmptyChunk();
+                ++taken;
+            }
+            mutex.unlock(held);  // Unlock the mutex after modifying the stack.
+            return taken;
+        }
+    }
+
+    // Method to clear the stack: detach every chunk under the lock, destroy the elements outside it.
+    void clear() {
+        Held held;
+        mutex.lock(held);  // Lock the mutex before modifying the stack.
+        Chunk* chunk = current;
+        std::size_t count = used;
+        current = nullptr;
+        used = 0;
+        mutex.unlock(held);  // Unlock the mutex after modifying the stack.
+        std::size_t removed = 0;
+        while (chunk != nullptr) {
+            for (std::size_t i = 0; i < count; ++i) chunk->slot(i)->~T();
+            removed += count;
+            Chunk* below = chunk->below;
+            freeChunk(chunk);
+            chunk = below;
+            count = kCapacity;  // Every chunk below the top one is full.
+        }
+        if (removed != 0) {
+            LogPolicy::record(LogOp::Clear, removed);
+        }
+    }
+};
+
+#endif // SEGMENTED_STACK_H
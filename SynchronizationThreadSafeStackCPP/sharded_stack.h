@@ -0,0 +1,163 @@
+#ifndef SHARDED_STACK_H
+#define SHARDED_STACK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "cache_line.h"
+#include "log_policy.h"
+#include "lock_policy.h"
+#include "spin_wait.h"
+#include "thread_safe_stack.h"
+
+// Define the default home policy: one shard per hardware thread, handed out to threads in order of first use.
+struct ThreadHome {
+    // Return the number of shards to create when the caller asks for 0.
+    static std::size_t defaultShards() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+    // Return the calling thread's index, assigned on first use and shared by every ShardedStack.
+    static std::size_t index() {
+        static std::atomic<std::size_t> next{0};
+        thread_local std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+};
+
+// Define a stack split into independent shards, for workloads such as task pools that do not need one global LIFO
+// order. Each thread has a home shard: it pushes there and pops from there first, so threads with different homes
+// never touch the same top pointer or cache line. A thread whose home shard is empty steals from the others,
+// starting at a random victim so concurrent thieves spread out, and takes up to half of the victim's values at once
+// so it does not come straight back.
+//
+// Using a ShardedStack is the opt-in to relaxed ordering: a pop returns the newest value of the caller's home shard,
+// or of the shard it stole from, not necessarily the newest value overall. Values pushed by one thread are still
+// popped LIFO by that thread as long as nobody steals them. The Home policy picks a thread's shard, modulo the shard
+// count. With ThreadHome, the default, it is fixed by the order in which threads first touch any ShardedStack; with
+// one shard per core and no more threads than cores, each thread gets a shard of its own. NodeHome (numa_stack.h)
+// gives every NUMA node one shard instead.
+//
+// The shard type defaults to the mutex-based stack with a TTAS spinlock, which costs one exchange and one store when
+// uncontended; any stack with push, try_pop, push_bulk and pop_n works. Unlike the other stacks, T must be default
+// constructible, since stolen values pass through a local buffer.
+template<typename T, typename Shard = ThreadSafeStack<T, NoLog, PooledNodeAllocator, NoStats, TtasSpinLock>,
+         typename Home = ThreadHome>
+class ShardedStack {
+private:
+    // Define one shard, on its own cache lines so that neighbours do not false-share.
+    struct alignas(kCacheLineSize) Slot {
+        Shard stack;
+        std::atomic<std::int64_t> size{0};  // Approximate: updated after the shard operation, without its lock.
+    };
+
+    std::unique_ptr<Slot[]> slots;  // The shards.
+    const std::size_t count;  // Number of shards.
+
+    static constexpr std::size_t kMaxSteal = 32;  // Most values moved by one steal.
+
+    Slot& home() { return slots[Home::index() % count]; }
+
+    // Take one value from some other shard, moving up to half of that shard into the home shard as well.
+    bool stealInto(T& out) {
+        Slot& mine = home();
+        const std::size_t start = static_cast<std::size_t>(fastRandom() % count);
+        for (std::size_t i = 0; i < count; ++i) {
+            Slot& victim = slots[(start + i) % count];
+            if (&victim == &mine || victim.size.load(std::memory_order_relaxed) <= 0) continue;
+            const auto half = static_cast<std::size_t>(victim.size.load(std::memory_order_relaxed) + 1) / 2;
+            T batch[kMaxSteal];
+            const std::size_t taken = victim.stack.pop_n(batch, std::min(std::max<std::size_t>(half, 1), kMaxSteal));
+            if (taken == 0) continue;  // Someone else emptied it first.
+            victim.size.fetch_sub(static_cast<std::int64_t>(taken), std::memory_order_relaxed);
+            out = std::move(batch[0]);  // The victim's newest value.
+            if (taken > 1) {
+                // Keep the rest in the same order: pop_n wrote them newest first, push_bulk puts the last on top.
+                std::reverse(batch + 1, batch + taken);
+                mine.stack.push_bulk(batch + 1, batch + taken);
+                mine.size.fetch_add(static_cast<std::int64_t>(taken - 1), std::memory_order_relaxed);
+            }
+            return true;
+        }
+        return false;
+    }
+
+public:
+    // Constructor to create a stack with the given number of shards; 0 means the Home policy's default.
+    explicit ShardedStack(std::size_t shards = 0) : count(shards != 0 ? shards : Home::defaultShards()) {
+        slots.reset(new Slot[count]);
+    }
+
+    ShardedStack(const ShardedStack&) = delete;
+    ShardedStack& operator=(const ShardedStack&) = delete;
+
+    // Method to return the number of shards.
+    std::size_t shard_count() const { return count; }
+
+    // Method to push a copy of a value onto the calling thread's home shard.
+    void push(const T& value) { emplace(value); }
+
+    // Method to push a value onto the calling thread's home shard, moving it into the node.
+    void push(T&& value) { emplace(std::move(value)); }
+
+    // Method to construct a value in place on the calling thread's home shard.
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        Slot& slot = home();
+        slot.stack.emplace(std::forward<Args>(args)...);
+        slot.size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Method to pop a value from the calling thread's home shard only. Returns false if that shard is empty.
+    bool try_pop_local(T& out) {
+        Slot& slot = home();
+        if (!slot.stack.try_pop(out)) return false;
+        slot.size.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Method to pop a value into out: from the home shard, or stolen from another shard if the home shard is empty.
+    // Returns false, without throwing, if every shard looked empty.
+    bool try_pop(T& out) { return try_pop_local(out) || stealInto(out); }
+
+    // Method to pop a value. Returns std::nullopt, without throwing, if every shard looked empty.
+    std::optional<T> try_pop() {
+        T value;
+        if (!try_pop(value)) return std::nullopt;
+        return std::optional<T>(std::move(value));
+    }
+
+    // Method to pop a value. Throws std::runtime_error if every shard looked empty; prefer try_pop on hot paths.
+    T pop() {
+        std::optional<T> data = try_pop();
+        if (!data) {  // Check if the stack is empty.
+            std::cerr << "Error: Attempted to pop from an empty stack.\n";  // Log an error message.
+            throw std::runtime_error("Attempted to pop an empty stack.");  // Throw an exception.
+        }
+        return std::move(*data);  // Return the popped data.
+    }
+
+    // Method to return the approximate number of values across all shards. Exact once all threads are done; while
+    // they run, it may lag the shards by the operations in flight.
+    std::size_t approx_size() const {
+        std::int64_t total = 0;
+        for (std::size_t i = 0; i < count; ++i) total += slots[i].size.load(std::memory_order_relaxed);
+        return total > 0 ? static_cast<std::size_t>(total) : 0;
+    }
+
+    // Method to clear every shard. Pushes racing with clear() may leave approx_size() off until the next clear().
+    void clear() {
+        for (std::size_t i = 0; i < count; ++i) {
+            slots[i].stack.clear();
+            slots[i].size.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+#endif // SHARDED_STACK_H
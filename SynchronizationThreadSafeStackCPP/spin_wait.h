@@ -0,0 +1,51 @@
+#ifndef SPIN_WAIT_H
+#define SPIN_WAIT_H
+
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Tell the CPU we are in a spin-wait loop: yields pipeline resources to the sibling hyperthread and avoids the
+// memory-order mis-speculation penalty when the awaited cache line finally changes.
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Define a spin-then-yield backoff for wait loops. Spinning is cheapest when the awaited thread is running on another
+// core; once the wait has lasted a while that is unlikely, so the waiter yields its time slice instead of burning it,
+// which matters when threads outnumber cores.
+class SpinBackoff {
+private:
+    unsigned spins = 0;  // Pauses issued so far.
+
+public:
+    static constexpr unsigned kSpinLimit = 64;  // Pauses before the waiter starts yielding.
+
+    // Wait a little before the caller re-checks its condition.
+    void pause() {
+        if (spins < kSpinLimit) {
+            ++spins;
+            cpuRelax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+};
+
+// Return a per-thread pseudo-random number (xorshift64*); cheap enough for randomized backoff and victim selection.
+inline std::uint64_t fastRandom() {
+    thread_local std::uint64_t state = reinterpret_cast<std::uintptr_t>(&state) | 1;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+#endif // SPIN_WAIT_H
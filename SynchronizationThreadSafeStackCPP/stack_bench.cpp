@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <pthread.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "adaptive_stack.h"
+#include "elimination_stack.h"
+#include "flat_combining_stack.h"
+#include "lock_policy.h"
+#include "lock_free_stack.h"
+#include "log_policy.h"
+#include "segmented_stack.h"
+#include "numa_stack.h"
+#include "sharded_stack.h"
+#include "thread_safe_stack.h"
+
+// Benchmark every stack variant across thread counts, operation mixes, payload sizes, logging on/off and, for the
+// mutex-based variants, lock policies.
+// Each run reports throughput and per-operation latency percentiles as one CSV row or JSON object, so runs from two
+// builds can be diffed to spot regressions. Run with --help for the options.
+
+// Define a payload of Bytes bytes, so the cost of copying values in and out of the stacks shows up in the numbers.
+template<std::size_t Bytes>
+struct Payload {
+    static_assert(Bytes % sizeof(std::uint64_t) == 0, "payload size must be a multiple of 8 bytes");
+    std::uint64_t words[Bytes / sizeof(std::uint64_t)];
+
+    Payload() : Payload(0) {}
+
+    explicit Payload(std::uint64_t value) {
+        for (auto& word : words) word = value;
+    }
+};
+
+// Hash a payload by its first word, which is all the log records need.
+namespace std {
+template<std::size_t Bytes>
+struct hash<Payload<Bytes>> {
+    std::size_t operator()(const Payload<Bytes>& payload) const noexcept { return std::hash<std::uint64_t>{}(payload.words[0]); }
+};
+}  // namespace std
+
+// Define the logging policy used for "logging on" rows: a binary trace kept apart from the demo driver's output.
+struct BenchTrace : BinaryLog {
+    BenchTrace() : BinaryLog("stack_bench.bin") {}
+};
+
+// Define an operation mix: the share of operations that are pushes, the rest being pops.
+struct OpMix {
+    const char* name;
+    unsigned pushPercent;
+};
+
+constexpr OpMix kMixes[] = {{"push-heavy", 80}, {"balanced", 50}, {"pop-heavy", 20}};
+
+// Define the command-line options.
+struct Options {
+    std::vector<std::size_t> threadCounts;  // Thread counts to sweep.
+    std::vector<std::string> variants;  // Variants to run; empty means all.
+    std::vector<std::string> locks;  // Lock policies to sweep for the mutex-based variants; empty means all.
+    std::size_t opsPerThread = 20000;  // Operations each thread performs per run.
+    bool json = false;  // Emit JSON instead of CSV.
+    bool withLogging = true;  // Also run the logging-on rows for variants that support a log policy.
+    std::string outputPath;  // Write the report here instead of stdout.
+};
+
+// Define the measured result of one run.
+struct BenchRow {
+    std::string variant;
+    const char* lock;  // Lock policy name, or "-" for variants without a LockPolicy.
+    std::size_t payloadBytes;
+    bool logging;
+    std::size_t threads;
+    const char* mix;
+    std::uint64_t ops;
+    std::uint64_t emptyPops;  // Pops that found the stack empty; still counted as operations.
+    double seconds;
+    std::uint64_t p50Ns;
+    std::uint64_t p99Ns;
+    std::uint64_t p999Ns;
+};
+
+// Define the state handed to each benchmark thread.
+template<typename Stack>
+struct WorkerArgs {
+    Stack* stack;  // Stack shared by all workers.
+    pthread_barrier_t* startBarrier;  // Released once every worker is ready, so they all start together.
+    std::size_t index;  // Worker index, used to seed its random stream.
+    std::size_t ops;  // Number of operations to perform.
+    unsigned pushPercent;  // Share of pushes.
+    std::vector<std::uint32_t> latencies;  // Per-operation latency in nanoseconds.
+    std::uint64_t emptyPops = 0;  // Pops that found the stack empty.
+    std::chrono::steady_clock::time_point begin;  // When this worker started its first operation.
+    std::chrono::steady_clock::time_point end;  // When this worker finished its last operation.
+};
+
+// Perform a random mix of timed pushes and pops. This function is intended to be used with pthreads.
+template<typename Stack, typename Value>
+void* benchWorker(void* arg) {
+    using Clock = std::chrono::steady_clock;
+    auto args = static_cast<WorkerArgs<Stack>*>(arg);
+    std::uint64_t state = 0x9E3779B97F4A7C15ull * (args->index + 1);  // Per-thread xorshift stream, reproducible.
+    args->latencies.resize(args->ops);
+    Value value;
+    pthread_barrier_wait(args->startBarrier);
+    args->begin = Clock::now();
+    for (std::size_t i = 0; i < args->ops; ++i) {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        const bool push = (state * 0x2545F4914F6CDD1Dull >> 32) % 100 < args->pushPercent;
+        auto start = Clock::now();
+        if (push) {
+            args->stack->push(Value(i));
+        } else if (!args->stack->try_pop(value)) {
+            ++args->emptyPops;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        args->latencies[i] = static_cast<std::uint32_t>(std::min<long long>(elapsed, UINT32_MAX));
+    }
+    args->end = Clock::now();
+    return nullptr;
+}
+
+// Return the q-quantile of samples, reordering them.
+std::uint64_t percentile(std::vector<std::uint32_t>& samples, double q) {
+    if (samples.empty()) return 0;
+    auto nth = samples.begin() + static_cast<std::ptrdiff_t>(q * static_cast<double>(samples.size() - 1));
+    std::nth_element(samples.begin(), nth, samples.end());
+    return *nth;
+}
+
+// Run one configuration on a fresh stack and return its row.
+template<typename Stack, typename Value>
+BenchRow runCase(const char* variant, const char* lock, bool logging, std::size_t threadCount, const OpMix& mix, std::size_t ops) {
+    Stack stack;
+    for (std::size_t i = 0; i < threadCount * ops / 4; ++i) {
+        stack.push(Value(i));  // Prefill so pop-heavy mixes measure pops, not empty checks.
+    }
+
+    pthread_barrier_t startBarrier;
+    pthread_barrier_init(&startBarrier, nullptr, static_cast<unsigned>(threadCount + 1));
+    std::vector<WorkerArgs<Stack>> args(threadCount);
+    std::vector<pthread_t> threads(threadCount);
+    for (std::size_t i = 0; i < threadCount; ++i) {
+        args[i].stack = &stack;
+        args[i].startBarrier = &startBarrier;
+        args[i].index = i;
+        args[i].ops = ops;
+        args[i].pushPercent = mix.pushPercent;
+        if (pthread_create(&threads[i], nullptr, benchWorker<Stack, Value>, &args[i]) != 0) {
+            std::cerr << "Failed to create thread." << std::endl;
+            std::exit(1);
+        }
+    }
+    pthread_barrier_wait(&startBarrier);
+    for (auto& thread : threads) {
+        pthread_join(thread, nullptr);
+    }
+    pthread_barrier_destroy(&startBarrier);
+
+    std::vector<std::uint32_t> samples;
+    samples.reserve(threadCount * ops);
+    std::uint64_t emptyPops = 0;
+    auto begin = args.front().begin;
+    auto end = args.front().end;
+    for (auto& worker : args) {
+        samples.insert(samples.end(), worker.latencies.begin(), worker.latencies.end());
+        emptyPops += worker.emptyPops;
+        begin = std::min(begin, worker.begin);
+        end = std::max(end, worker.end);
+    }
+    // Wall time runs from the first worker's start to the last worker's finish; the main thread may be descheduled
+    // for all of it, so it does not time the run itself.
+    std::chrono::duration<double> elapsed = end - begin;
+    BenchRow row{variant, lock, sizeof(Value), logging, threadCount, mix.name, samples.size(), emptyPops, elapsed.count(), 0, 0, 0};
+    row.p50Ns = percentile(samples, 0.50);
+    row.p99Ns = percentile(samples, 0.99);
+    row.p999Ns = percentile(samples, 0.999);
+    return row;
+}
+
+// Sweep thread counts and mixes for one stack type.
+template<typename Stack, typename Value>
+void sweepVariant(const char* variant, const char* lock, bool logging, const Options& options, std::vector<BenchRow>& rows) {
+    if (!options.variants.empty() && std::find(options.variants.begin(), options.variants.end(), variant) == options.variants.end()) {
+        return;
+    }
+    if (!options.locks.empty() && std::strcmp(lock, "-") != 0 &&
+        std::find(options.locks.begin(), options.locks.end(), lock) == options.locks.end()) {
+        return;
+    }
+    if (logging && !options.withLogging) return;
+    for (std::size_t threads : options.threadCounts) {
+        for (const OpMix& mix : kMixes) {
+            rows.push_back(runCase<Stack, Value>(variant, lock, logging, threads, mix, options.opsPerThread));
+        }
+    }
+}
+
+// Sweep the mutex-based variants with one lock policy.
+template<typename Value, typename Lock>
+void sweepLocked(const Options& options, std::vector<BenchRow>& rows) {
+    sweepVariant<ThreadSafeStack<Value, NoLog, PooledNodeAllocator, NoStats, Lock>, Value>("mutex", Lock::kName, false, options, rows);
+    sweepVariant<ThreadSafeStack<Value, BenchTrace, PooledNodeAllocator, NoStats, Lock>, Value>("mutex", Lock::kName, true, options, rows);
+    sweepVariant<SegmentedStack<Value, NoLog, 4096, Lock>, Value>("segmented", Lock::kName, false, options, rows);
+    sweepVariant<SegmentedStack<Value, BenchTrace, 4096, Lock>, Value>("segmented", Lock::kName, true, options, rows);
+    sweepVariant<FlatCombiningStack<Value, NoLog, PooledNodeAllocator, NoStats, Lock>, Value>("combining", Lock::kName, false, options, rows);
+    sweepVariant<FlatCombiningStack<Value, BenchTrace, PooledNodeAllocator, NoStats, Lock>, Value>("combining", Lock::kName, true, options, rows);
+}
+
+// Sweep every variant for one payload type. Only the variants with a log policy get logging-on rows.
+template<typename Value>
+void sweepPayload(const Options& options, std::vector<BenchRow>& rows) {
+    sweepLocked<Value, PthreadLock>(options, rows);
+    sweepLocked<Value, TtasSpinLock>(options, rows);
+    sweepLocked<Value, TicketLock>(options, rows);
+    sweepLocked<Value, McsLock>(options, rows);
+    sweepLocked<Value, AdaptiveLock>(options, rows);
+    sweepLocked<Value, CohortLock>(options, rows);
+    sweepVariant<LockFreeStack<Value>, Value>("lockfree", "-", false, options, rows);
+    if constexpr (kPackable<Value>) {
+        sweepVariant<LockFreeStack<Value, PooledNodeAllocator, NoStats, PackedRepresentation>, Value>("lockfree-packed", "-", false,
+                                                                                                     options, rows);
+    }
+    sweepVariant<EliminationStack<Value>, Value>("elimination", "-", false, options, rows);
+    sweepVariant<AdaptiveStack<Value>, Value>("adaptive", "-", false, options, rows);
+    sweepVariant<ShardedStack<Value>, Value>("sharded", "-", false, options, rows);
+    sweepVariant<NumaStack<Value>, Value>("numa", "-", false, options, rows);
+}
+
+// Write the rows as CSV with a header line.
+void writeCsv(std::ostream& out, const std::vector<BenchRow>& rows) {
+    out << "variant,lock,payload_bytes,logging,threads,mix,ops,empty_pops,seconds,ops_per_sec,p50_ns,p99_ns,p999_ns\n";
+    for (const auto& row : rows) {
+        out << row.variant << ',' << row.lock << ',' << row.payloadBytes << ',' << (row.logging ? "on" : "off") << ',' << row.threads << ','
+            << row.mix << ',' << row.ops << ',' << row.emptyPops << ',' << row.seconds << ','
+            << static_cast<std::uint64_t>(static_cast<double>(row.ops) / row.seconds) << ',' << row.p50Ns << ','
+            << row.p99Ns << ',' << row.p999Ns << '\n';
+    }
+}
+
+// Write the rows as a JSON array of objects with the same fields as the CSV columns.
+void writeJson(std::ostream& out, const std::vector<BenchRow>& rows) {
+    out << "[\n";
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        const auto& row = rows[i];
+        out << "  {\"variant\": \"" << row.variant << "\", \"lock\": \"" << row.lock << "\", \"payload_bytes\": " << row.payloadBytes
+            << ", \"logging\": " << (row.logging ? "true" : "false") << ", \"threads\": " << row.threads
+            << ", \"mix\": \"" << row.mix << "\", \"ops\": " << row.ops << ", \"empty_pops\": " << row.emptyPops
+            << ", \"seconds\": " << row.seconds
+            << ", \"ops_per_sec\": " << static_cast<std::uint64_t>(static_cast<double>(row.ops) / row.seconds)
+            << ", \"p50_ns\": " << row.p50Ns << ", \"p99_ns\": " << row.p99Ns << ", \"p999_ns\": " << row.p999Ns << '}'
+            << (i + 1 < rows.size() ? "," : "") << '\n';
+    }
+    out << "]\n";
+}
+
+// Split a comma-separated list.
+std::vector<std::string> splitList(const char* list) {
+    std::vector<std::string> items;
+    std::string item;
+    for (const char* c = list;; ++c) {
+        if (*c == ',' || *c == '\0') {
+            if (!item.empty()) items.push_back(item);
+            item.clear();
+            if (*c == '\0') break;
+        } else {
+            item += *c;
+        }
+    }
+    return items;
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --threads LIST    thread counts to sweep (default: 1, cores, 2x and 4x cores)\n"
+              << "  --variants LIST   any of mutex,lockfree,lockfree-packed,elimination,adaptive,combining,segmented,sharded,numa\n"
+              << "                    (default: all)\n"
+              << "  --locks LIST      lock policies for mutex, segmented and combining: pthread,ttas,ticket,mcs,adaptive,cohort\n"
+              << "                    (default: all)\n"
+              << "  --ops N           operations per thread per run (default: 20000)\n"
+              << "  --no-logging      skip the logging-on rows\n"
+              << "  --format csv|json report format (default: csv)\n"
+              << "  --output PATH     write the report to PATH instead of stdout\n";
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            for (const auto& item : splitList(argv[++i])) options.threadCounts.push_back(std::stoul(item));
+        } else if (std::strcmp(argv[i], "--variants") == 0 && hasValue) {
+            options.variants = splitList(argv[++i]);
+        } else if (std::strcmp(argv[i], "--locks") == 0 && hasValue) {
+            options.locks = splitList(argv[++i]);
+        } else if (std::strcmp(argv[i], "--ops") == 0 && hasValue) {
+            options.opsPerThread = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--no-logging") == 0) {
+            options.withLogging = false;
+        } else if (std::strcmp(argv[i], "--format") == 0 && hasValue) {
+            options.json = std::strcmp(argv[++i], "json") == 0;
+        } else if (std::strcmp(argv[i], "--output") == 0 && hasValue) {
+            options.outputPath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return std::strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+    if (options.threadCounts.empty()) {  // 1..N cores, then oversubscribed.
+        const auto cores = static_cast<std::size_t>(std::max(1L, sysconf(_SC_NPROCESSORS_ONLN)));
+        for (std::size_t threads : {std::size_t{1}, cores, 2 * cores, 4 * cores}) {
+            if (std::find(options.threadCounts.begin(), options.threadCounts.end(), threads) == options.threadCounts.end()) {
+                options.threadCounts.push_back(threads);
+            }
+        }
+    }
+
+    std::vector<BenchRow> rows;
+    sweepPayload<std::uint32_t>(options, rows);  // Small enough for the packed lock-free representation.
+    sweepPayload<Payload<8>>(options, rows);
+    sweepPayload<Payload<64>>(options, rows);
+    sweepPayload<Payload<256>>(options, rows);
+
+    std::ofstream file;
+    if (!options.outputPath.empty()) {
+        file.open(options.outputPath);
+        if (!file) {
+            std::cerr << "Failed to open " << options.outputPath << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = options.outputPath.empty() ? std::cout : file;
+    if (options.json) {
+        writeJson(out, rows);
+    } else {
+        writeCsv(out, rows);
+    }
+    return 0;
+}
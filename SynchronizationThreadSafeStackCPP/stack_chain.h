@@ -0,0 +1,117 @@
+#ifndef STACK_CHAIN_H
+#define STACK_CHAIN_H
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+#include "node_pool.h"
+#include "stack_node.h"
+
+// Define a detached run of stack nodes, as returned by ThreadSafeStack::drain(): the former contents of a stack, top
+// first, owned by whoever holds the chain. Iterating it reads the values in place, so nothing is copied or moved;
+// the nodes go back to the Allocator when the chain is destroyed, or move on unchanged when the chain is handed to
+// another stack's push_chain(). A chain is movable but not copyable, so it can be handed to another thread whole.
+template<typename T, typename Allocator = PooledNodeAllocator>
+class StackChain {
+private:
+    using Node = StackNode<T>;
+
+    Node* head;  // Former top of the stack, or nullptr for an empty chain.
+    Node* tail;  // Former bottom of the stack; its next is nullptr.
+    std::size_t count;  // Number of nodes.
+
+    template<typename, typename, typename, typename, typename> friend class ThreadSafeStack;
+    template<typename, typename, typename, typename, typename> friend class FlatCombiningStack;
+    template<typename, typename, typename, typename> friend class LockFreeStack;
+
+    StackChain(Node* first, Node* last, std::size_t size) : head(first), tail(last), count(size) {}
+
+    // Give up the nodes without freeing them, leaving the chain empty.
+    Node* release() {
+        Node* first = head;
+        head = tail = nullptr;
+        count = 0;
+        return first;
+    }
+
+public:
+    // Define a forward iterator over the values, top of the former stack first.
+    template<typename Value>
+    class Iterator {
+    private:
+        Node* node;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+
+        Iterator() : node(nullptr) {}
+        explicit Iterator(Node* start) : node(start) {}
+
+        reference operator*() const { return node->data; }
+        pointer operator->() const { return &node->data; }
+        Iterator& operator++() {
+            node = node->next;
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator before = *this;
+            node = node->next;
+            return before;
+        }
+        bool operator==(const Iterator& other) const { return node == other.node; }
+        bool operator!=(const Iterator& other) const { return node != other.node; }
+    };
+
+    using iterator = Iterator<T>;
+    using const_iterator = Iterator<const T>;
+
+    // Constructor to create an empty chain.
+    StackChain() : head(nullptr), tail(nullptr), count(0) {}
+
+    StackChain(StackChain&& other) noexcept : head(other.head), tail(other.tail), count(other.count) { other.release(); }
+
+    StackChain& operator=(StackChain&& other) noexcept {
+        if (this != &other) {
+            clear();
+            head = other.head;
+            tail = other.tail;
+            count = other.count;
+            other.release();
+        }
+        return *this;
+    }
+
+    StackChain(const StackChain&) = delete;
+    StackChain& operator=(const StackChain&) = delete;
+
+    // Destructor to return every node to the allocator.
+    ~StackChain() { clear(); }
+
+    // Method to return the number of values in the chain.
+    std::size_t size() const { return count; }
+
+    // Method to check whether the chain holds no values.
+    bool empty() const { return count == 0; }
+
+    iterator begin() { return iterator(head); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return const_iterator(head); }
+    const_iterator end() const { return const_iterator(); }
+
+    // Method to free every node now instead of at destruction.
+    void clear() {
+        Node* node = release();
+        while (node != nullptr) {
+            Node* next = node->next;
+            Allocator::destroy(node);
+            node = next;
+        }
+    }
+};
+
+#endif // STACK_CHAIN_H
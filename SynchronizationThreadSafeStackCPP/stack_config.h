@@ -0,0 +1,78 @@
+#ifndef STACK_CONFIG_H
+#define STACK_CONFIG_H
+
+#include <cstddef>
+
+#include "bounded_stack.h"
+#include "elimination_stack.h"
+#include "flat_combining_stack.h"
+#include "lock_free_stack.h"
+#include "lock_policy.h"
+#include "log_policy.h"
+#include "node_pool.h"
+#include "segmented_stack.h"
+#include "sharded_stack.h"
+#include "stack_stats.h"
+#include "thread_safe_stack.h"
+
+// Compile-time configuration of the stacks for code that links the header-only library. Each knob below is a macro
+// that names a policy type and can be overridden with -D, or with the matching CMake cache variable, which passes
+// it on to every target that links stack::stack:
+//   STACK_ALLOCATOR     node allocator: PooledNodeAllocator (default) or HeapNodeAllocator;
+//   STACK_LOCK_POLICY   lock of the mutex-based stacks: PthreadLock (default), TtasSpinLock, TicketLock, McsLock,
+//                       AdaptiveLock, CohortLock or PriorityInheritLock;
+//   STACK_LOG_POLICY    log of the stacks that have one: NoLog (default), TextLog, BinaryLog or MappedLog;
+//   STACK_STATS_POLICY  instrumentation: NoStats (default) or ContentionStats.
+// The defaults suit a service: no trace file, no counters, pooled nodes. The Configured* aliases apply StackConfig to
+// each stack family, so the policy choice is made once per build and every stack is still a plain template that the
+// compiler inlines into the caller. A translation unit that needs different policies passes its own config type.
+#if !defined(STACK_ALLOCATOR)
+#define STACK_ALLOCATOR PooledNodeAllocator
+#endif
+#if !defined(STACK_LOCK_POLICY)
+#define STACK_LOCK_POLICY PthreadLock
+#endif
+#if !defined(STACK_LOG_POLICY)
+#define STACK_LOG_POLICY NoLog
+#endif
+#if !defined(STACK_STATS_POLICY)
+#define STACK_STATS_POLICY NoStats
+#endif
+
+// Define the policies chosen for this build.
+struct StackConfig {
+    using Allocator = STACK_ALLOCATOR;
+    using Lock = STACK_LOCK_POLICY;
+    using Log = STACK_LOG_POLICY;
+    using Stats = STACK_STATS_POLICY;
+    static constexpr std::size_t kSegmentBytes = 4096;  // Chunk size of ConfiguredSegmentedStack.
+};
+
+// Mutex-based family.
+template<typename T, typename Config = StackConfig>
+using ConfiguredStack = ThreadSafeStack<T, typename Config::Log, typename Config::Allocator, typename Config::Stats, typename Config::Lock>;
+
+template<typename T, typename Config = StackConfig>
+using ConfiguredBoundedStack = BoundedStack<T, typename Config::Log, typename Config::Lock>;
+
+template<typename T, typename Config = StackConfig>
+using ConfiguredSegmentedStack = SegmentedStack<T, typename Config::Log, Config::kSegmentBytes, typename Config::Lock>;
+
+// Lock-free family. The stacks have no log policy.
+template<typename T, typename Config = StackConfig>
+using ConfiguredLockFreeStack = LockFreeStack<T, typename Config::Allocator, typename Config::Stats>;
+
+template<typename T, typename Config = StackConfig>
+using ConfiguredEliminationStack = EliminationStack<T, typename Config::Allocator, typename Config::Stats>;
+
+// Combining and sharded families. Shards never log: one trace per shard would not be a trace of the stack. The
+// combining stack has no async_pop()/async_push(), and its top_peek() takes the lock.
+template<typename T, typename Config = StackConfig>
+using ConfiguredCombiningStack = FlatCombiningStack<T, typename Config::Log, typename Config::Allocator,
+                                                    typename Config::Stats, typename Config::Lock>;
+
+template<typename T, typename Config = StackConfig>
+using ConfiguredShardedStack =
+    ShardedStack<T, ThreadSafeStack<T, NoLog, typename Config::Allocator, typename Config::Stats, typename Config::Lock>>;
+
+#endif // STACK_CONFIG_H
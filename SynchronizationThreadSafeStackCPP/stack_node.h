@@ -0,0 +1,18 @@
+#ifndef STACK_NODE_H
+#define STACK_NODE_H
+
+#include <utility>
+
+// Define a template class StackNode that can store any type T.
+template<typename T>
+class StackNode {
+public:
+    T data; // Public member variable to hold the data of type T.
+    StackNode* next; // Pointer to the next StackNode in the stack.
+
+    // Explicit constructor that builds the data in place from the given arguments and sets the next pointer to nullptr.
+    template<typename... Args>
+    explicit StackNode(Args&&... args) : data(std::forward<Args>(args)...), next(nullptr) {}
+};
+
+#endif // STACK_NODE_H
@@ -0,0 +1,245 @@
+#ifndef STACK_STATS_H
+#define STACK_STATS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cache_line.h"
+
+// Instrumentation policies for the stacks. A stack calls the hooks below around its lock and after each operation;
+// NoStats implements every hook as an empty inline function and is an empty base class, so a stack built with it
+// carries no counters and compiles to the same code as before. ContentionStats records into per-thread slots and
+// aggregates them when stats() is called.
+
+// Define a latency histogram with power-of-two buckets: bucket 0 counts 0 ns samples, bucket i counts samples in
+// [2^(i-1), 2^i) ns, and the last bucket also takes everything longer.
+struct LatencyHistogram {
+    static constexpr std::size_t kBuckets = 32;  // 2^31 ns is about two seconds.
+
+    std::uint64_t counts[kBuckets] = {};  // Samples per bucket.
+    std::uint64_t samples = 0;  // Total number of samples.
+    std::uint64_t totalNs = 0;  // Sum of all samples.
+    std::uint64_t maxNs = 0;  // Longest sample.
+
+    // Return the bucket a sample of ns nanoseconds falls into.
+    static std::size_t bucketFor(std::uint64_t ns) {
+        std::size_t bucket = 0;
+        while (ns != 0 && bucket + 1 < kBuckets) {
+            ns >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    // Return the average sample, or 0 if there are none.
+    double meanNs() const { return samples == 0 ? 0.0 : static_cast<double>(totalNs) / static_cast<double>(samples); }
+
+    // Return an upper bound for the q-quantile: the upper edge of the bucket that holds it.
+    std::uint64_t percentileNs(double q) const {
+        const auto rank = static_cast<std::uint64_t>(q * static_cast<double>(samples));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            seen += counts[i];
+            if (seen > rank) return i + 1 == kBuckets ? maxNs : (std::uint64_t{1} << i);
+        }
+        return maxNs;
+    }
+};
+
+// Define a snapshot of a stack's counters, as returned by stats().
+struct StackStats {
+    std::uint64_t pushes = 0;  // Values pushed, counting each value of a bulk push.
+    std::uint64_t pops = 0;  // Values popped, counting each value of a bulk pop.
+    std::uint64_t failedPops = 0;  // Pops, or pop_n calls, that ran into an empty stack.
+    std::uint64_t casRetries = 0;  // CAS attempts on the top pointer that lost a race (lock-free stacks only).
+    LatencyHistogram lockWait;  // Time from requesting the lock to holding it (mutex-based stacks only).
+    LatencyHistogram lockHold;  // Time from acquiring the lock to starting to release it (mutex-based stacks only).
+    std::int64_t depth = 0;  // Number of values on the stack when the snapshot was taken.
+    std::int64_t peakDepth = 0;  // Largest depth seen so far.
+
+    // Return the number of push and pop calls, successful or not.
+    std::uint64_t ops() const { return pushes + pops + failedPops; }
+};
+
+// Define a policy that records nothing. Every hook is empty, so instrumentation compiles out entirely.
+struct NoStats {
+    struct Timestamp {};  // Carries nothing; stands in for a clock reading.
+
+    NoStats() = default;
+
+    Timestamp now() const { return {}; }
+    void recordWait(Timestamp, Timestamp) {}
+    void recordHold(Timestamp, Timestamp) {}
+    void countPush(std::size_t = 1) {}
+    void countPop(std::size_t = 1) {}
+    void countFailedPop() {}
+    void countCasRetries(std::size_t) {}
+    void adjustDepth(std::ptrdiff_t) {}
+
+    // Return an all-zero snapshot.
+    StackStats snapshot() const { return {}; }
+};
+
+// Define a policy that counts operations, lock wait and hold times, CAS retries and depth.
+// Every thread writes only its own cache-line-aligned slot, so counting adds no shared-cache-line traffic beyond the
+// depth counter; snapshot() sums the slots. Slots are found the same way FlatCombiningStack finds its publication
+// records: a thread_local cache keyed by a unique id, with slots of exited threads adopted by new ones.
+class ContentionStats {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Timestamp = Clock::time_point;
+
+private:
+    // Define one histogram whose buckets are written by a single thread and read by snapshot().
+    struct SlotHistogram {
+        std::atomic<std::uint64_t> counts[LatencyHistogram::kBuckets] = {};
+        std::atomic<std::uint64_t> samples{0};
+        std::atomic<std::uint64_t> totalNs{0};
+        std::atomic<std::uint64_t> maxNs{0};
+    };
+
+    // Define one thread's counters, aligned so that no two threads' slots share a cache line.
+    struct alignas(kCacheLineSize) Slot {
+        std::atomic<std::uint64_t> pushes{0};
+        std::atomic<std::uint64_t> pops{0};
+        std::atomic<std::uint64_t> failedPops{0};
+        std::atomic<std::uint64_t> casRetries{0};
+        SlotHistogram lockWait;
+        SlotHistogram lockHold;
+        std::atomic<bool> abandoned{false};  // Set when the owning thread exits, so another thread can adopt it.
+    };
+
+    // Define the calling thread's map from stats id to its slot.
+    struct ThreadSlots {
+        struct Entry {
+            std::uint64_t statsId;
+            std::shared_ptr<Slot> slot;
+        };
+        std::vector<Entry> entries;
+
+        // Hand every slot this thread owned back for reuse; its counts stay in the totals.
+        ~ThreadSlots() {
+            for (auto& entry : entries) entry.slot->abandoned.store(true, std::memory_order_release);
+        }
+    };
+
+    mutable std::mutex registryMutex;  // Protects slots.
+    std::vector<std::shared_ptr<Slot>> slots;  // Every slot handed out, kept for snapshot().
+    const std::uint64_t id;  // Unique id, so a thread's cache never confuses two stacks at the same address.
+    alignas(kCacheLineSize) std::atomic<std::int64_t> depth{0};  // Shared: depth is a property of the stack, not of a thread.
+    std::atomic<std::int64_t> peakDepth{0};
+
+    static std::uint64_t nextStatsId() {
+        static std::atomic<std::uint64_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    static ThreadSlots& threadSlots() {
+        thread_local ThreadSlots cache;
+        return cache;
+    }
+
+    // Add n to a counter that only the calling thread writes; a plain load and store avoids a locked instruction.
+    static void bump(std::atomic<std::uint64_t>& counter, std::uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static void recordSample(SlotHistogram& histogram, Timestamp from, Timestamp to) {
+        const auto ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+        bump(histogram.counts[LatencyHistogram::bucketFor(ns)], 1);
+        bump(histogram.samples, 1);
+        bump(histogram.totalNs, ns);
+        if (ns > histogram.maxNs.load(std::memory_order_relaxed)) histogram.maxNs.store(ns, std::memory_order_relaxed);
+    }
+
+    static void addInto(LatencyHistogram& total, const SlotHistogram& histogram) {
+        for (std::size_t i = 0; i < LatencyHistogram::kBuckets; ++i) {
+            total.counts[i] += histogram.counts[i].load(std::memory_order_relaxed);
+        }
+        total.samples += histogram.samples.load(std::memory_order_relaxed);
+        total.totalNs += histogram.totalNs.load(std::memory_order_relaxed);
+        total.maxNs = std::max(total.maxNs, histogram.maxNs.load(std::memory_order_relaxed));
+    }
+
+    // Find the calling thread's slot, adopting an abandoned one or creating a new one on first use.
+    Slot& localSlot() {
+        ThreadSlots& cache = threadSlots();
+        for (auto& entry : cache.entries) {
+            if (entry.statsId == id) return *entry.slot;
+        }
+        cache.entries.erase(std::remove_if(cache.entries.begin(), cache.entries.end(),
+                                           [](const ThreadSlots::Entry& e) { return e.slot.use_count() == 1; }),
+                            cache.entries.end());  // Forget slots of stacks that no longer exist.
+        std::shared_ptr<Slot> slot;
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            for (auto& candidate : slots) {
+                bool wasAbandoned = true;
+                if (candidate->abandoned.compare_exchange_strong(wasAbandoned, false, std::memory_order_acq_rel)) {
+                    slot = candidate;
+                    break;
+                }
+            }
+            if (!slot) {
+                slot = std::make_shared<Slot>();
+                slots.push_back(slot);
+            }
+        }
+        cache.entries.push_back({id, slot});
+        return *slot;
+    }
+
+public:
+    ContentionStats() : id(nextStatsId()) {}
+
+    ContentionStats(const ContentionStats&) = delete;
+    ContentionStats& operator=(const ContentionStats&) = delete;
+
+    Timestamp now() const { return Clock::now(); }
+
+    // Record the time between asking for the lock and getting it.
+    void recordWait(Timestamp requested, Timestamp acquired) { recordSample(localSlot().lockWait, requested, acquired); }
+
+    // Record the time between getting the lock and releasing it.
+    void recordHold(Timestamp acquired, Timestamp released) { recordSample(localSlot().lockHold, acquired, released); }
+
+    void countPush(std::size_t n = 1) { bump(localSlot().pushes, n); }
+    void countPop(std::size_t n = 1) { bump(localSlot().pops, n); }
+    void countFailedPop() { bump(localSlot().failedPops, 1); }
+    void countCasRetries(std::size_t n) {
+        if (n != 0) bump(localSlot().casRetries, n);
+    }
+
+    // Track the stack's depth and its high-water mark.
+    void adjustDepth(std::ptrdiff_t delta) {
+        const std::int64_t current = depth.fetch_add(delta, std::memory_order_relaxed) + delta;
+        std::int64_t peak = peakDepth.load(std::memory_order_relaxed);
+        while (current > peak && !peakDepth.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {}
+    }
+
+    // Sum every thread's slot into one snapshot. Counters are read while other threads may still be writing them,
+    // so a snapshot taken mid-run is approximate; one taken after the threads are joined is exact.
+    StackStats snapshot() const {
+        StackStats total;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& slot : slots) {
+            total.pushes += slot->pushes.load(std::memory_order_relaxed);
+            total.pops += slot->pops.load(std::memory_order_relaxed);
+            total.failedPops += slot->failedPops.load(std::memory_order_relaxed);
+            total.casRetries += slot->casRetries.load(std::memory_order_relaxed);
+            addInto(total.lockWait, slot->lockWait);
+            addInto(total.lockHold, slot->lockHold);
+        }
+        total.depth = depth.load(std::memory_order_relaxed);
+        total.peakDepth = peakDepth.load(std::memory_order_relaxed);
+        return total;
+    }
+};
+
+#endif // STACK_STATS_H
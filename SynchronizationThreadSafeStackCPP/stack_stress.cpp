@@ -0,0 +1,699 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "adaptive_stack.h"
+#include "bounded_stack.h"
+#include "elimination_stack.h"
+#include "flat_combining_stack.h"
+#include "lock_free_stack.h"
+#include "lock_policy.h"
+#include "log_policy.h"
+#include "mapped_trace.h"
+#include "numa_stack.h"
+#include "packed_stack.h"
+#include "realtime_stack.h"
+#include "segmented_stack.h"
+#include "sharded_stack.h"
+#include "spin_wait.h"
+#include "thread_safe_stack.h"
+
+// Stress every stack variant with many threads under randomized schedules and check what they did.
+// Each thread runs a random mix of push, try_pop, push_bulk, pop_n and clear, with random pauses and yields between
+// operations to shake up the interleavings, and appends one compact record per value to its own history: the value,
+// what happened to it, and timestamps taken just before the call and just after it returns. Nothing is shared
+// between threads except the stack, so the checks cost the run nothing. After the threads are joined the main
+// thread pops whatever is left, and the histories are checked offline:
+//   - conservation: every pushed value is popped exactly once or removed by a clear(), and nothing else is popped;
+//   - real time: no value is popped before its push was called;
+//   - linearizability of the LIFO order, for every variant except the sharded ones, whose order is relaxed by
+//     design: a pop never returns x while some y pushed after x's push returned was on the stack for the whole pop;
+//     a pop that finds the stack empty never does so while some value was on it for the whole call; and no pop
+//     returns a value that a clear() running entirely between its push and the pop must have removed.
+// These are the conditions the histories can prove; a full linearizability search is exponential, and these catch
+// the lost, duplicated, invented and reordered values that real bugs produce. A watchdog aborts the run if a round
+// has not finished within the timeout, so a deadlock fails loudly instead of hanging. The exit status is 1 if any
+// check fails. Build with -DSTACK_SANITIZE=thread or address (or the tsan and asan presets) to run it under a
+// sanitizer. Run with --help for the options.
+
+namespace {
+
+using Value = std::uint32_t;  // Thread index in the top 8 bits, that thread's push counter in the low 24.
+
+constexpr unsigned kValueThreadShift = 24;
+constexpr std::size_t kMaxThreads = 255;  // Thread 255 is the main thread's final drain.
+constexpr std::size_t kMaxPushesPerThread = std::size_t{1} << kValueThreadShift;
+constexpr std::size_t kMaxBulk = 8;  // Most values in one push_bulk or pop_n.
+
+// Define what a history record says happened.
+enum class Op : std::uint8_t {
+    Push,  // value was pushed.
+    Pop,  // value was popped.
+    EmptyPop,  // A pop, or a pop_n that returned fewer values than asked for, found the stack empty.
+    Clear,  // clear() was called.
+};
+
+// Define one history record: 24 bytes, written by one thread only.
+struct Event {
+    std::int64_t invoke;  // Timestamp taken before the call.
+    std::int64_t response;  // Timestamp taken after it returned.
+    Value value;  // The value pushed or popped; unused for EmptyPop and Clear.
+    Op op;
+};
+
+// Define the command-line options.
+struct Options {
+    std::vector<std::size_t> threadCounts;  // Thread counts to run each variant with.
+    std::vector<std::string> variants;  // Variants to run; empty means all.
+    std::size_t opsPerThread = 20000;  // Operations each thread performs per round.
+    std::size_t rounds = 3;  // Rounds per variant and thread count, each with its own schedule.
+    std::uint64_t seed = 1;  // Seed for every thread's random stream, so a failing schedule can be rerun.
+    unsigned clearPermille = 1;  // Share of operations that are clear(), in thousandths.
+    unsigned timeoutSeconds = 120;  // How long one round may take before the watchdog aborts.
+};
+
+// Return a timestamp for a history record, fenced on both sides so that the call it brackets cannot move across it.
+std::int64_t stamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_mfence();
+    const std::int64_t ticks = readTraceClock();
+    _mm_lfence();
+    return ticks;
+#else
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::int64_t ticks = readTraceClock();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return ticks;
+#endif
+}
+
+// Return the next number from a reproducible xorshift64* stream.
+std::uint64_t nextRandom(std::uint64_t& state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+// Define the state handed to each stress thread.
+template<typename Stack>
+struct WorkerArgs {
+    Stack* stack;  // Stack shared by all workers.
+    pthread_barrier_t* startBarrier;  // Released once every worker is ready, so they all start together.
+    std::size_t index;  // Worker index: the top bits of every value it pushes.
+    std::size_t ops;  // Number of operations to perform.
+    unsigned pushPercent;  // Share of pushes among the operations that are not clears.
+    unsigned clearPermille;  // Share of clears.
+    std::uint64_t seed;  // Seed of this worker's random stream.
+    std::vector<Event> history;  // What this worker did, in program order.
+};
+
+// Perform a random mix of operations, recording each one. This function is intended to be used with pthreads.
+template<typename Stack>
+void* stressWorker(void* arg) {
+    auto args = static_cast<WorkerArgs<Stack>*>(arg);
+    Stack& stack = *args->stack;
+    std::uint64_t state = args->seed;
+    const Value base = static_cast<Value>(args->index) << kValueThreadShift;
+    Value next = 0;  // Number of values pushed so far.
+    Value batch[kMaxBulk];
+    args->history.reserve(args->ops * 2);
+    pthread_barrier_wait(args->startBarrier);
+    for (std::size_t i = 0; i < args->ops && next + kMaxBulk < kMaxPushesPerThread; ++i) {
+        const std::uint64_t roll = nextRandom(state);
+        if ((roll & 0xF) == 0) {  // Now and then, pause for a while or give up the core to change the interleaving.
+            const unsigned pauses = static_cast<unsigned>(roll >> 8) & 0xFF;
+            if (pauses == 0) {
+                std::this_thread::yield();
+            } else {
+                for (unsigned p = 0; p < pauses; ++p) cpuRelax();
+            }
+        }
+        const unsigned choice = static_cast<unsigned>((roll >> 16) % 1000);
+        const bool bulk = ((roll >> 32) & 0x1F) == 0;
+        const std::size_t count = 2 + static_cast<std::size_t>((roll >> 40) % (kMaxBulk - 1));
+        if (choice < args->clearPermille) {
+            const std::int64_t invoke = stamp();
+            stack.clear();
+            args->history.push_back({invoke, stamp(), 0, Op::Clear});
+        } else if (choice % 100 < args->pushPercent) {
+            if constexpr (requires(Stack& s, Value* values) { s.push_bulk(values, values); }) {
+                if (bulk) {
+                    for (std::size_t k = 0; k < count; ++k) batch[k] = base | next++;
+                    const std::int64_t invoke = stamp();
+                    stack.push_bulk(batch, batch + count);
+                    const std::int64_t response = stamp();
+                    for (std::size_t k = 0; k < count; ++k) args->history.push_back({invoke, response, batch[k], Op::Push});
+                    continue;
+                }
+            }
+            const Value value = base | next++;
+            const std::int64_t invoke = stamp();
+            stack.push(value);
+            args->history.push_back({invoke, stamp(), value, Op::Push});
+        } else {
+            if constexpr (requires(Stack& s, Value* values) { s.pop_n(values, 1); }) {
+                if (bulk) {
+                    const std::int64_t invoke = stamp();
+                    const std::size_t taken = stack.pop_n(batch, count);
+                    const std::int64_t response = stamp();
+                    for (std::size_t k = 0; k < taken; ++k) args->history.push_back({invoke, response, batch[k], Op::Pop});
+                    if (taken < count) args->history.push_back({invoke, response, 0, Op::EmptyPop});
+                    continue;
+                }
+            }
+            Value value;
+            const std::int64_t invoke = stamp();
+            const bool popped = stack.try_pop(value);
+            args->history.push_back({invoke, stamp(), popped ? value : 0, popped ? Op::Pop : Op::EmptyPop});
+        }
+    }
+    return nullptr;
+}
+
+// Define what the histories say about one pushed value.
+struct ValueInfo {
+    bool pushed = false;
+    std::uint32_t pops = 0;
+    std::int64_t pushInvoke = 0;
+    std::int64_t pushResponse = 0;
+    std::int64_t popInvoke = 0;
+    std::int64_t popResponse = 0;
+    std::int64_t removal = std::numeric_limits<std::int64_t>::max();  // Earliest time it may have left the stack.
+};
+
+// Define an index over values keyed by removal time that answers, for a time t: of the values added so far that
+// were still on the stack after t, which one was pushed last? A Fenwick tree over removal times sorted latest
+// first, holding the latest push invocation in each prefix, so both adding and asking take O(log n).
+class LatestPushIndex {
+private:
+    std::vector<std::int64_t> removals;  // Distinct removal times, latest first.
+    std::vector<std::pair<std::int64_t, Value>> tree;  // 1-based; (push invocation, value), or (-1, 0) if none.
+
+public:
+    explicit LatestPushIndex(std::vector<std::int64_t> times) : removals(std::move(times)) {
+        std::sort(removals.begin(), removals.end(), std::greater<>());
+        removals.erase(std::unique(removals.begin(), removals.end()), removals.end());
+        tree.assign(removals.size() + 1, {-1, 0});
+    }
+
+    // Add a value that stays on the stack until removal.
+    void add(std::int64_t removal, std::int64_t pushInvoke, Value value) {
+        auto position = static_cast<std::size_t>(
+            std::lower_bound(removals.begin(), removals.end(), removal, std::greater<>()) - removals.begin()) + 1;
+        for (; position < tree.size(); position += position & (~position + 1)) {
+            if (pushInvoke > tree[position].first) tree[position] = {pushInvoke, value};
+        }
+    }
+
+    // Return the latest-pushed value whose removal is after t, as (push invocation, value), or (-1, 0) if none.
+    std::pair<std::int64_t, Value> latestRemovedAfter(std::int64_t t) const {
+        auto position = static_cast<std::size_t>(
+            std::lower_bound(removals.begin(), removals.end(), t, std::greater<>()) - removals.begin());
+        std::pair<std::int64_t, Value> best{-1, 0};
+        for (; position > 0; position -= position & (~position + 1)) {
+            if (tree[position].first > best.first) best = tree[position];
+        }
+        return best;
+    }
+};
+
+// Return a value as "thread#counter" for messages.
+std::string describe(Value value) {
+    return std::to_string(value >> kValueThreadShift) + "#" + std::to_string(value & (kMaxPushesPerThread - 1));
+}
+
+// Check the histories of one round. strict turns on the LIFO checks. Returns the number of problems found.
+std::uint64_t check(const std::vector<std::vector<Event>>& histories, bool strict) {
+    std::uint64_t problems = 0;
+    auto report = [&problems](const std::string& message) {
+        if (++problems <= 10) std::cerr << "  " << message << "\n";
+    };
+
+    // Index every push, and every clear by invocation and by response.
+    std::vector<std::vector<ValueInfo>> values(histories.size());
+    std::vector<std::pair<std::int64_t, std::int64_t>> clears;  // (invoke, response)
+    for (std::size_t thread = 0; thread < histories.size(); ++thread) {
+        for (const Event& event : histories[thread]) {
+            if (event.op == Op::Push) {
+                const std::size_t counter = event.value & (kMaxPushesPerThread - 1);
+                if (values[thread].size() <= counter) values[thread].resize(counter + 1);
+                ValueInfo& info = values[thread][counter];
+                info.pushed = true;
+                info.pushInvoke = event.invoke;
+                info.pushResponse = event.response;
+            } else if (event.op == Op::Clear) {
+                clears.push_back({event.invoke, event.response});
+            }
+        }
+    }
+    auto find = [&values](Value value) -> ValueInfo* {
+        const std::size_t thread = value >> kValueThreadShift;
+        const std::size_t counter = value & (kMaxPushesPerThread - 1);
+        if (thread >= values.size() || counter >= values[thread].size() || !values[thread][counter].pushed) return nullptr;
+        return &values[thread][counter];
+    };
+
+    // Match every pop with its push.
+    std::vector<const Event*> pops;
+    std::vector<const Event*> emptyPops;
+    for (const auto& history : histories) {
+        for (const Event& event : history) {
+            if (event.op == Op::EmptyPop) emptyPops.push_back(&event);
+            if (event.op != Op::Pop) continue;
+            ValueInfo* info = find(event.value);
+            if (info == nullptr) {
+                report("popped " + describe(event.value) + ", which was never pushed");
+                continue;
+            }
+            if (++info->pops > 1) {
+                report("popped " + describe(event.value) + " more than once");
+                continue;
+            }
+            info->popInvoke = event.invoke;
+            info->popResponse = event.response;
+            info->removal = event.invoke;
+            if (event.response < info->pushInvoke) report("popped " + describe(event.value) + " before it was pushed");
+            pops.push_back(&event);
+        }
+    }
+
+    // A value nobody popped must have been removed by a clear that ended after its push began; the earliest such
+    // clear's invocation is the earliest it may have left the stack.
+    std::sort(clears.begin(), clears.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+    std::vector<std::int64_t> earliestInvoke(clears.size() + 1, std::numeric_limits<std::int64_t>::max());
+    for (std::size_t i = clears.size(); i > 0; --i) earliestInvoke[i - 1] = std::min(earliestInvoke[i], clears[i - 1].first);
+    std::vector<std::int64_t> removals;
+    for (std::size_t thread = 0; thread < values.size(); ++thread) {
+        for (std::size_t counter = 0; counter < values[thread].size(); ++counter) {
+            ValueInfo& info = values[thread][counter];
+            if (!info.pushed) continue;
+            if (info.pops == 0) {
+                const auto first = std::upper_bound(clears.begin(), clears.end(), info.pushInvoke,
+                                                    [](std::int64_t t, const auto& clear) { return t < clear.second; });
+                if (first == clears.end()) {
+                    report("lost " + describe(static_cast<Value>(thread << kValueThreadShift | counter)) +
+                           ": pushed, never popped and no clear() came after it");
+                } else {
+                    info.removal = earliestInvoke[static_cast<std::size_t>(first - clears.begin())];
+                }
+            }
+            removals.push_back(info.removal);
+        }
+    }
+    if (!strict) return problems;
+
+    // No pop returns a value that a clear running entirely between its push and the pop removed.
+    std::sort(clears.begin(), clears.end());
+    std::vector<std::int64_t> earliestResponse(clears.size() + 1, std::numeric_limits<std::int64_t>::max());
+    for (std::size_t i = clears.size(); i > 0; --i) earliestResponse[i - 1] = std::min(earliestResponse[i], clears[i - 1].second);
+    for (const Event* pop : pops) {
+        const ValueInfo& info = *find(pop->value);
+        const auto after = std::upper_bound(clears.begin(), clears.end(), std::make_pair(info.pushResponse, std::numeric_limits<std::int64_t>::max()));
+        if (earliestResponse[static_cast<std::size_t>(after - clears.begin())] < pop->invoke) {
+            report("popped " + describe(pop->value) + " after a clear() that ran entirely after its push");
+        }
+    }
+
+    // Sweep the pops by invocation, adding each value once its push has returned, and ask whether some value pushed
+    // later than the popped one was on the stack for the whole pop, or any value was for the whole empty pop.
+    struct Push {
+        std::int64_t response;
+        const ValueInfo* info;
+        Value value;
+    };
+    std::vector<Push> pushes;
+    for (std::size_t thread = 0; thread < values.size(); ++thread) {
+        for (std::size_t counter = 0; counter < values[thread].size(); ++counter) {
+            const ValueInfo& info = values[thread][counter];
+            if (info.pushed) pushes.push_back({info.pushResponse, &info, static_cast<Value>(thread << kValueThreadShift | counter)});
+        }
+    }
+    std::sort(pushes.begin(), pushes.end(), [](const Push& a, const Push& b) { return a.response < b.response; });
+    std::vector<const Event*> queries = pops;
+    queries.insert(queries.end(), emptyPops.begin(), emptyPops.end());
+    std::sort(queries.begin(), queries.end(), [](const Event* a, const Event* b) { return a->invoke < b->invoke; });
+    LatestPushIndex index(std::move(removals));
+    std::size_t added = 0;
+    for (const Event* query : queries) {
+        for (; added < pushes.size() && pushes[added].response < query->invoke; ++added) {
+            index.add(pushes[added].info->removal, pushes[added].info->pushInvoke, pushes[added].value);
+        }
+        const auto [pushInvoke, blocker] = index.latestRemovedAfter(query->response);
+        if (query->op == Op::EmptyPop) {
+            if (pushInvoke >= 0) report("a pop found the stack empty while " + describe(blocker) + " was on it");
+        } else if (pushInvoke > find(query->value)->pushResponse) {
+            report("popped " + describe(query->value) + " while " + describe(blocker) + ", pushed after it, was above it");
+        }
+    }
+    return problems;
+}
+
+// Define a watchdog that aborts the process if a round runs longer than its deadline.
+class Watchdog {
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::string round;  // Description of the round being watched, or empty between rounds.
+    std::uint64_t generation = 0;  // Bumped whenever a round starts or ends.
+    bool stopping = false;
+    std::thread thread;
+
+public:
+    explicit Watchdog(unsigned timeoutSeconds) {
+        thread = std::thread([this, timeoutSeconds] {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping) {
+                if (round.empty()) {
+                    changed.wait(lock);
+                    continue;
+                }
+                const std::uint64_t watched = generation;
+                if (!changed.wait_for(lock, std::chrono::seconds(timeoutSeconds), [&] { return generation != watched || stopping; })) {
+                    std::cerr << "Round " << round << " did not finish within " << timeoutSeconds << " s: deadlock?\n";
+                    std::abort();
+                }
+            }
+        });
+    }
+
+    ~Watchdog() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_one();
+        thread.join();
+    }
+
+    // Start watching a round, or stop watching with an empty description.
+    void watch(std::string description) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            round = std::move(description);
+            ++generation;
+        }
+        changed.notify_one();
+    }
+};
+
+// Run every round of one variant and return the number of problems found.
+template<typename Stack>
+std::uint64_t stressVariant(const char* variant, bool strict, const Options& options, Watchdog& watchdog,
+                            const std::function<std::unique_ptr<Stack>()>& make) {
+    if (!options.variants.empty() && std::find(options.variants.begin(), options.variants.end(), variant) == options.variants.end()) {
+        return 0;
+    }
+    std::uint64_t problems = 0;
+    for (std::size_t threadCount : options.threadCounts) {
+        for (std::size_t round = 0; round < options.rounds; ++round) {
+            const std::string description = std::string(variant) + ", " + std::to_string(threadCount) + " threads, round " + std::to_string(round);
+            watchdog.watch(description);
+            std::unique_ptr<Stack> stack = make();
+            std::uint64_t state = options.seed ^ (0x9E3779B97F4A7C15ull * (round + 1)) ^ threadCount;
+            const unsigned pushPercent = 30 + static_cast<unsigned>(nextRandom(state) % 41);  // 30..70% pushes.
+
+            pthread_barrier_t startBarrier;
+            pthread_barrier_init(&startBarrier, nullptr, static_cast<unsigned>(threadCount + 1));
+            std::vector<WorkerArgs<Stack>> args(threadCount);
+            std::vector<pthread_t> threads(threadCount);
+            for (std::size_t i = 0; i < threadCount; ++i) {
+                args[i] = {stack.get(), &startBarrier, i, options.opsPerThread, pushPercent, options.clearPermille,
+                           nextRandom(state) | 1, {}};
+                if (pthread_create(&threads[i], nullptr, stressWorker<Stack>, &args[i]) != 0) {
+                    std::cerr << "Failed to create thread." << std::endl;
+                    std::exit(1);
+                }
+            }
+            pthread_barrier_wait(&startBarrier);
+            for (auto& thread : threads) {
+                pthread_join(thread, nullptr);
+            }
+            pthread_barrier_destroy(&startBarrier);
+
+            std::vector<std::vector<Event>> histories(threadCount + 1);
+            std::uint64_t pushes = 0, pops = 0, emptyPops = 0, clears = 0;
+            for (std::size_t i = 0; i < threadCount; ++i) histories[i] = std::move(args[i].history);
+            for (Value value;;) {  // Take whatever is left, as one more thread that only pops.
+                const std::int64_t invoke = stamp();
+                const bool popped = stack->try_pop(value);
+                histories[threadCount].push_back({invoke, stamp(), popped ? value : 0, popped ? Op::Pop : Op::EmptyPop});
+                if (!popped) break;
+            }
+            for (const auto& history : histories) {
+                for (const Event& event : history) {
+                    pushes += event.op == Op::Push;
+                    pops += event.op == Op::Pop;
+                    emptyPops += event.op == Op::EmptyPop;
+                    clears += event.op == Op::Clear;
+                }
+            }
+            stack.reset();
+            watchdog.watch("");
+            std::cout << description << ": " << pushes << " pushes, " << pops << " pops, " << emptyPops << " empty pops, "
+                      << clears << " clears" << std::endl;
+            const std::uint64_t found = check(histories, strict);
+            if (found != 0) std::cout << "  " << found << " problems (seed " << options.seed << ")" << std::endl;
+            problems += found;
+        }
+    }
+    return problems;
+}
+
+// Run one variant on a default-constructed stack.
+template<typename Stack>
+std::uint64_t stressVariant(const char* variant, bool strict, const Options& options, Watchdog& watchdog) {
+    return stressVariant<Stack>(variant, strict, options, watchdog, [] { return std::make_unique<Stack>(); });
+}
+
+// Run the mutex-based stack with one lock policy.
+template<typename Lock>
+std::uint64_t stressLocked(const Options& options, Watchdog& watchdog) {
+    const std::string variant = std::string("mutex-") + Lock::kName;
+    return stressVariant<ThreadSafeStack<Value, NoLog, PooledNodeAllocator, NoStats, Lock>>(variant.c_str(), true, options, watchdog);
+}
+
+// Define a value whose copy throws while throwsLeft is non-zero, one throw per copy, to exercise failed pushes.
+struct FragileValue {
+    static inline int throwsLeft = 0;
+    Value value;
+
+    explicit FragileValue(Value v = 0) : value(v) {}
+    FragileValue(const FragileValue& other) : value(other.value) {
+        if (throwsLeft > 0 && throwsLeft-- == 1) throw std::runtime_error("FragileValue copy failed");
+    }
+    FragileValue& operator=(const FragileValue&) = default;
+};
+
+// Define a log policy that only keeps the balance of pushes against pops and rejected pushes.
+struct TallyLog {
+    static inline std::int64_t outstanding = 0;  // Pushes recorded and not yet popped or rejected, by all stacks.
+
+    template<typename T>
+    void record(LogOp op, const T&) {
+        outstanding += op == LogOp::Push ? 1 : op == LogOp::Pop || op == LogOp::Rejected ? -1 : 0;
+    }
+};
+
+// Make a push and a push_bulk on a SegmentedStack throw on the first value of a new chunk, then check that every value
+// that made it in pops back in LIFO order and, with TallyLog, that every recorded push was popped or rejected.
+// Single-threaded; returns the number of problems found.
+template<typename LogPolicy>
+std::uint64_t checkThrowingPushes(const char* name) {
+    using Stack = SegmentedStack<FragileValue, LogPolicy, 256>;
+    const int staging = kRecordsOps<LogPolicy> ? 1 : 0;  // A logging stack copies each value once before the lock.
+    std::uint64_t problems = 0;
+    for (const bool bulk : {false, true}) {
+        Stack stack;
+        TallyLog::outstanding = 0;
+        Value pushed = 0;
+        const Value fill = bulk ? Stack::kCapacity - 1 : Stack::kCapacity;  // The failing value starts a new chunk.
+        for (; pushed < fill; ++pushed) stack.push(FragileValue(pushed));
+        const FragileValue extra[] = {FragileValue(pushed), FragileValue(pushed + 1), FragileValue(pushed + 2)};
+        try {
+            if (bulk) {
+                FragileValue::throwsLeft = 3 * staging + 2;  // The first value goes in, the second throws.
+                stack.push_bulk(std::begin(extra), std::end(extra));
+            } else {
+                FragileValue::throwsLeft = staging + 1;
+                stack.push(extra[0]);
+            }
+        } catch (const std::runtime_error&) {
+        }
+        FragileValue::throwsLeft = 0;
+        if (bulk) ++pushed;
+        const std::string what = std::string(name) + ": " + (bulk ? "push_bulk" : "push") + " failure";
+        FragileValue out;
+        for (Value expected = pushed; expected-- > 0;) {
+            if (!stack.try_pop(out)) {
+                std::cout << what << " hid " << expected + 1 << " values" << std::endl;
+                ++problems;
+                break;
+            }
+            if (out.value != expected) {
+                std::cout << what << ": popped " << out.value << ", expected " << expected << std::endl;
+                ++problems;
+                break;
+            }
+        }
+        if (stack.try_pop(out)) {
+            std::cout << what << " left value " << out.value << " behind" << std::endl;
+            ++problems;
+        }
+        if constexpr (std::is_same_v<LogPolicy, TallyLog>) {
+            if (TallyLog::outstanding != 0) {
+                std::cout << what << " left " << TallyLog::outstanding << " recorded pushes unmatched" << std::endl;
+                ++problems;
+            }
+        }
+    }
+    std::cout << name << ": " << (problems == 0 ? "ok" : "failed") << std::endl;
+    return problems;
+}
+
+// Run the throwing-push checks on a SegmentedStack without and with a log.
+std::uint64_t checkThrowingPushes(const Options& options) {
+    if (!options.variants.empty() &&
+        std::find(options.variants.begin(), options.variants.end(), "segmented-throw") == options.variants.end()) {
+        return 0;
+    }
+    return checkThrowingPushes<NoLog>("segmented-throw") + checkThrowingPushes<TallyLog>("segmented-throw, logged");
+}
+
+// Run the real-time stack, whose arena must hold every node at once; skipped if the arena cannot be locked.
+std::uint64_t stressRealtime(std::size_t nodes, const Options& options, Watchdog& watchdog) {
+    if (!options.variants.empty() && std::find(options.variants.begin(), options.variants.end(), "realtime") == options.variants.end()) {
+        return 0;
+    }
+    try {
+        reserveRealtimeNodes<Value>(nodes);
+    } catch (const std::exception& error) {
+        std::cout << "realtime: skipped, " << error.what() << '\n';
+        return 0;
+    }
+    return stressVariant<RealtimeStack<Value>>("realtime", true, options, watchdog);
+}
+
+// Split a comma-separated list.
+std::vector<std::string> splitList(const char* list) {
+    std::vector<std::string> items;
+    std::string item;
+    for (const char* c = list;; ++c) {
+        if (*c == ',' || *c == '\0') {
+            if (!item.empty()) items.push_back(item);
+            item.clear();
+            if (*c == '\0') break;
+        } else {
+            item += *c;
+        }
+    }
+    return items;
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --threads LIST    thread counts to run (default: 4 and 4x cores, at least 16; at most " << kMaxThreads - 1 << ")\n"
+              << "  --variants LIST   any of mutex-pthread,mutex-ttas,mutex-ticket,mutex-mcs,mutex-adaptive,mutex-cohort,\n"
+              << "                    segmented,segmented-throw,bounded,realtime,lockfree,lockfree-packed,packed-wrap,elimination,\n"
+              << "                    combining,adaptive,sharded,numa (default: all)\n"
+              << "  --ops N           operations per thread per round (default: 20000)\n"
+              << "  --rounds N        rounds per variant and thread count (default: 3)\n"
+              << "  --seed N          seed for the random schedules (default: 1)\n"
+              << "  --clears N        clears per thousand operations (default: 1)\n"
+              << "  --timeout S       abort if a round takes longer than S seconds (default: 120)\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            for (const auto& item : splitList(argv[++i])) options.threadCounts.push_back(std::stoul(item));
+        } else if (std::strcmp(argv[i], "--variants") == 0 && hasValue) {
+            options.variants = splitList(argv[++i]);
+        } else if (std::strcmp(argv[i], "--ops") == 0 && hasValue) {
+            options.opsPerThread = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--rounds") == 0 && hasValue) {
+            options.rounds = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) {
+            options.seed = std::stoull(argv[++i]);
+        } else if (std::strcmp(argv[i], "--clears") == 0 && hasValue) {
+            options.clearPermille = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (std::strcmp(argv[i], "--timeout") == 0 && hasValue) {
+            options.timeoutSeconds = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else {
+            printUsage(argv[0]);
+            return std::strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+    if (options.threadCounts.empty()) {
+        const auto cores = static_cast<std::size_t>(std::max(1L, sysconf(_SC_NPROCESSORS_ONLN)));
+        options.threadCounts = {4, std::min(std::max<std::size_t>(16, 4 * cores), kMaxThreads - 1)};
+    }
+    for (std::size_t threads : options.threadCounts) {
+        if (threads == 0 || threads >= kMaxThreads) {
+            std::cerr << "Thread counts must be between 1 and " << kMaxThreads - 1 << ".\n";
+            return 1;
+        }
+    }
+
+    Watchdog watchdog(options.timeoutSeconds);
+    std::uint64_t problems = 0;
+    problems += stressLocked<PthreadLock>(options, watchdog);
+    problems += stressLocked<TtasSpinLock>(options, watchdog);
+    problems += stressLocked<TicketLock>(options, watchdog);
+    problems += stressLocked<McsLock>(options, watchdog);
+    problems += stressLocked<AdaptiveLock>(options, watchdog);
+    problems += stressLocked<CohortLock>(options, watchdog);
+    problems += stressVariant<SegmentedStack<Value, NoLog>>("segmented", true, options, watchdog);
+    problems += checkThrowingPushes(options);
+    const std::size_t capacity = *std::max_element(options.threadCounts.begin(), options.threadCounts.end()) *
+                                 (options.opsPerThread + kMaxBulk);  // Never fills, so push never blocks.
+    problems += stressVariant<BoundedStack<Value, NoLog>>("bounded", true, options, watchdog,
+                                                         [capacity] { return std::make_unique<BoundedStack<Value, NoLog>>(capacity); });
+    problems += stressRealtime(capacity, options, watchdog);
+    problems += stressVariant<LockFreeStack<Value>>("lockfree", true, options, watchdog);
+    problems += stressVariant<LockFreeStack<Value, PooledNodeAllocator, NoStats, PackedRepresentation>>("lockfree-packed", true, options, watchdog);
+    const std::uint32_t nearWrap = std::numeric_limits<std::uint32_t>::max() - 4096;  // Wraps early in every round.
+    problems += stressVariant<PackedStack<Value>>("packed-wrap", true, options, watchdog,
+                                                  [nearWrap] { return std::make_unique<PackedStack<Value>>(nearWrap); });
+    problems += stressVariant<EliminationStack<Value>>("elimination", true, options, watchdog);
+    problems += stressVariant<FlatCombiningStack<Value, NoLog>>("combining", true, options, watchdog);
+    AdaptiveThresholds restless;  // Switch at every sample, so the rounds exercise migration under load.
+    restless.sampleEvery = 64;
+    restless.minInterval = std::chrono::milliseconds(0);
+    restless.minSampleOps = 64;
+    restless.lockFreeAboveWaitNs = 0.0;
+    restless.mutexBelowRetries = 1e9;
+    restless.confirmSamples = 1;
+    problems += stressVariant<AdaptiveStack<Value>>("adaptive", true, options, watchdog,
+                                                   [restless] { return std::make_unique<AdaptiveStack<Value>>(restless); });
+    problems += stressVariant<ShardedStack<Value>>("sharded", false, options, watchdog);
+    problems += stressVariant<NumaStack<Value>>("numa", false, options, watchdog);
+    if (problems != 0) {
+        std::cout << problems << " problems found.\n";
+        return 1;
+    }
+    std::cout << "All histories check out.\n";
+    return 0;
+}
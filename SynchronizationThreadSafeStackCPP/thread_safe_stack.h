@@ -0,0 +1,587 @@
+#ifndef THREAD_SAFE_STACK_H
+#define THREAD_SAFE_STACK_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "cache_line.h"
+#include "coro_resume.h"
+#include "lock_policy.h"
+#include "log_policy.h"
+#include "node_pool.h"
+#include "stack_chain.h"
+#include "stack_node.h"
+#include "stack_stats.h"
+#include "wait_queue.h"
+
+// Define a generic, thread-safe stack class that can handle any type T.
+// Nodes come from the Allocator policy (see node_pool.h); the default per-thread pool keeps malloc off the hot path.
+// Operations are recorded through the LogPolicy (see log_policy.h) outside the mutex, so logging never lengthens the
+// critical section: pushes before the lock is taken, while the node is still private, and pops and clears after it is
+// released. The policy is a private base so that NoLog adds no storage at all.
+// The StatsPolicy (see stack_stats.h) works the same way: NoStats compiles out, ContentionStats measures lock wait
+// and hold times, operation counts and depth, reported by stats().
+// The LockPolicy (see lock_policy.h) is the lock that guards top: a pthread mutex by default, or a TTAS spinlock,
+// ticket, MCS or adaptive spin-then-park lock.
+// wait_pop() and wait_pop_for() let consumers sleep on an empty stack instead of retrying; producers only pay for a
+// wakeup when a consumer is actually waiting (see wait_queue.h). Coroutines do the same with co_await async_pop(),
+// which suspends instead of blocking the thread; a push that finds a suspended consumer hands the value straight to
+// it, oldest consumer first, without building a node, and resumes it inline or on the executor it named.
+// Suspended consumers are served before threads in wait_pop(). The stack must outlive every suspended consumer.
+template<typename T, typename LogPolicy = TextLog, typename Allocator = PooledNodeAllocator, typename StatsPolicy = NoStats,
+         typename LockPolicy = PthreadLock>
+class ThreadSafeStack : private LogPolicy, private StatsPolicy {
+private:
+    using Timestamp = typename StatsPolicy::Timestamp;
+
+    // Whether top_peek() can read a copy of the top value without the lock: values that fit a lock-free atomic.
+    // std::conjunction stops at the first false trait, so std::atomic<T> is never instantiated for other types.
+    template<typename U>
+    struct LockFreeAtomic : std::bool_constant<std::atomic<U>::is_always_lock_free> {};
+    static constexpr bool kMirrorsTop =
+        std::conjunction_v<std::is_trivially_copyable<T>, std::is_default_constructible<T>,
+                           std::bool_constant<sizeof(T) <= sizeof(std::uint64_t)>, LockFreeAtomic<T>>;
+    struct NoMirror {};
+    using TopMirror = std::conditional_t<kMirrorsTop, std::atomic<T>, NoMirror>;
+
+    // Define a coroutine suspended in async_pop(). It lives in the awaiter, inside the coroutine frame, so waiting
+    // allocates nothing; a pusher that dequeues it fills value and then resumes it.
+    struct AsyncWaiter {
+        AsyncWaiter* next = nullptr;  // Next consumer in arrival order.
+        std::optional<T> value;  // Value handed over by the pusher.
+        std::coroutine_handle<> handle;  // Coroutine to resume.
+        ResumeTarget target;  // Where to resume it.
+    };
+
+    // Define what a critical section carries from lock() to unlock(). Lives on the caller's stack frame, which is
+    // what queue locks such as McsLock need.
+    struct Held {
+        typename LockPolicy::QueueNode node;
+        Timestamp acquired;
+    };
+
+    // The hot fields, which every operation writes, start a cache line of their own: the lock holder pulls in one
+    // line for the lock word and top, and nothing touched outside the lock (the policies in the base classes, the
+    // wait queue) shares it. Queue and ticket locks carry their own finer-grained alignment.
+    alignas(kCacheLineSize) StackNode<T>* top;  // Pointer to the top node of the stack.
+    std::atomic<std::size_t> size;  // Number of values. Written under mutex; read without it by approx_size().
+    [[no_unique_address]] TopMirror topValue;  // Copy of the top value, for top_peek(); empty unless kMirrorsTop.
+    std::size_t waiting;  // Number of consumers parked, or about to park, in waitQueue. Protected by mutex.
+    std::atomic<AsyncWaiter*> asyncHead;  // Oldest suspended async_pop(). Written under mutex; read without it as a hint.
+    AsyncWaiter* asyncTail;  // Newest suspended async_pop(). Protected by mutex.
+    LockPolicy mutex;  // Lock to ensure thread safety during operations.
+    alignas(kCacheLineSize) WaitQueue waitQueue;  // Where wait_pop() sleeps until a push arrives; cold otherwise.
+
+    // Refresh the fields read without the lock after top changed by delta values. Call with the mutex held. Only the
+    // lock holder writes them, so plain loads and stores suffice, and they share the line the holder already owns.
+    void publish(std::ptrdiff_t delta) {
+        size.store(static_cast<std::size_t>(static_cast<std::ptrdiff_t>(size.load(std::memory_order_relaxed)) + delta),
+                   std::memory_order_relaxed);
+        if constexpr (kMirrorsTop) {
+            if (top != nullptr) topValue.store(top->data, std::memory_order_relaxed);
+        }
+    }
+
+    // Lock the mutex, recording how long the wait took.
+    void lock(Held& held) {
+        const Timestamp requested = StatsPolicy::now();
+        mutex.lock(held.node);
+        held.acquired = StatsPolicy::now();
+        StatsPolicy::recordWait(requested, held.acquired);
+    }
+
+    // Unlock the mutex, recording how long it was held. The sample is stored after the lock is released.
+    void unlock(Held& held) {
+        const Timestamp released = StatsPolicy::now();
+        mutex.unlock(held.node);
+        StatsPolicy::recordHold(held.acquired, released);
+    }
+
+    // Detach the top node, sleeping while the stack is empty until deadline passes; nullptr waits without one.
+    // Returns nullptr only on timeout.
+    StackNode<T>* waitForNode(const timespec* deadline) {
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        bool counted = false;
+        while (top == nullptr) {
+            if (!counted) {
+                ++waiting;  // Producers read this under the lock, so they see us before we sleep.
+                counted = true;
+            }
+            waitQueue.prepare();
+            unlock(held);
+            const bool woken = waitQueue.park(deadline);
+            lock(held);
+            if (!woken && top == nullptr) break;  // Timed out with nothing to take.
+        }
+        if (counted) --waiting;
+        auto node = top;  // Store the top node.
+        if (node != nullptr) {
+            top = node->next;  // Update the top to the next node.
+            StatsPolicy::adjustDepth(-1);
+            publish(-1);
+        }
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        return node;
+    }
+
+    // Take the oldest suspended consumer off the queue, or return nullptr if there is none. Call with the mutex held.
+    AsyncWaiter* dequeueWaiter() {
+        AsyncWaiter* waiter = asyncHead.load(std::memory_order_relaxed);
+        if (waiter != nullptr) {
+            asyncHead.store(waiter->next, std::memory_order_relaxed);
+            if (waiter->next == nullptr) asyncTail = nullptr;
+        }
+        return waiter;
+    }
+
+    // Give value to a consumer taken off the queue, outside the lock, and resume it. The waiter may be gone as soon
+    // as it is resumed.
+    template<typename U>
+    void deliver(AsyncWaiter* waiter, U&& value) {
+        waiter->value.emplace(std::forward<U>(value));
+        StatsPolicy::countPush();
+        waiter->target(waiter->handle);
+    }
+
+    // Hand a push straight to a suspended consumer, without building a node. Returns false, leaving value untouched,
+    // if no consumer was waiting once the lock was taken.
+    bool handOff(T& value) {
+        Held held;
+        lock(held);
+        AsyncWaiter* waiter = dequeueWaiter();
+        unlock(held);
+        if (waiter == nullptr) return false;
+        LogPolicy::record(LogOp::Push, value);
+        deliver(waiter, std::move(value));
+        return true;
+    }
+
+    // Hand a node detached by waitForNode() to the caller.
+    std::optional<T> takeWaited(StackNode<T>* node) {
+        if (node == nullptr) {
+            StatsPolicy::countFailedPop();
+            return std::nullopt;  // Timed out.
+        }
+        StatsPolicy::countPop();
+        std::optional<T> data(std::move(node->data));  // Move the data straight into the result.
+        Allocator::destroy(node);  // Free the old top node outside the lock.
+        LogPolicy::record(LogOp::Pop, *data);  // Log the pop operation outside the lock.
+        return data;
+    }
+
+public:
+    // Constructor to initialize the stack. Any arguments go to the log policy, e.g. a trace file path.
+    // Throws if the policy cannot open its output.
+    template<typename... LogArgs>
+    explicit ThreadSafeStack(LogArgs&&... logArgs)
+        : LogPolicy(std::forward<LogArgs>(logArgs)...), top(nullptr), size(0), waiting(0), asyncHead(nullptr), asyncTail(nullptr) {}
+
+    // The stack owns its nodes and its mutex, so copying is not supported.
+    ThreadSafeStack(const ThreadSafeStack&) = delete;
+    ThreadSafeStack& operator=(const ThreadSafeStack&) = delete;
+
+    // Destructor to clean up resources.
+    ~ThreadSafeStack() {
+        clear();  // Clear the stack.
+    }
+
+    // Method to push a copy of a value onto the stack.
+    void push(const T& value) { emplace(value); }
+
+    // Method to push a value onto the stack, moving it into the node.
+    void push(T&& value) { emplace(std::move(value)); }
+
+    // Method to construct a value in place on top of the stack.
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        if (asyncHead.load(std::memory_order_relaxed) != nullptr) {  // A coroutine may be waiting: try to skip the node.
+            T value(std::forward<Args>(args)...);
+            if (!handOff(value)) pushNode(Allocator::template create<StackNode<T>>(std::move(value)));
+            return;
+        }
+        pushNode(Allocator::template create<StackNode<T>>(std::forward<Args>(args)...));  // Build the node before taking the lock.
+    }
+
+private:
+    // Publish a node built by emplace(), or give its value to a consumer that suspended in the meantime.
+    void pushNode(StackNode<T>* newNode) {
+        LogPolicy::record(LogOp::Push, newNode->data);  // Log while the node is still private; once published it may be popped.
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        if (AsyncWaiter* waiter = dequeueWaiter()) {
+            unlock(held);
+            deliver(waiter, std::move(newNode->data));
+            Allocator::destroy(newNode);
+            return;
+        }
+        newNode->next = top;  // Set the new node's next to the current top.
+        top = newNode;  // Update the top to be the new node.
+        StatsPolicy::adjustDepth(1);
+        publish(1);
+        const bool wake = waiting != 0;
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        if (wake) waitQueue.notify();
+        StatsPolicy::countPush();
+    }
+
+public:
+    // Method to push every value in [first, last) in one critical section; the last value ends up on top.
+    // The nodes are built and logged before the lock is taken, so the lock is held only to splice the chain in.
+    template<typename InputIt>
+    void push_bulk(InputIt first, InputIt last) {
+        if (first == last) return;
+        auto bottom = Allocator::template create<StackNode<T>>(*first);  // The first value ends up deepest in the chain.
+        auto head = bottom;
+        std::size_t count = 1;
+        try {
+            for (++first; first != last; ++first) {  // Build the chain privately, newest value at the head.
+                auto node = Allocator::template create<StackNode<T>>(*first);
+                node->next = head;
+                head = node;
+                ++count;
+            }
+        } catch (...) {
+            while (head != nullptr) {  // Free the partial chain before propagating the error.
+                auto next = head->next;
+                Allocator::destroy(head);
+                head = next;
+            }
+            throw;
+        }
+        spliceChain(head, bottom, count);
+    }
+
+    // Method to push every value of a chain taken from a stack with the same node allocator, e.g. by drain(), in one
+    // critical section without copying: the nodes themselves are linked in, keeping their order, so the chain's first
+    // value ends up on top. The chain is left empty.
+    void push_chain(StackChain<T, Allocator>&& chain) {
+        const std::size_t count = chain.size();
+        StackNode<T>* bottom = chain.tail;
+        StackNode<T>* head = chain.release();
+        if (head != nullptr) spliceChain(head, bottom, count);
+    }
+
+private:
+    // Link the private chain head..bottom of count nodes onto the stack in one critical section, handing its newest
+    // values to suspended consumers first.
+    void spliceChain(StackNode<T>* head, StackNode<T>* bottom, std::size_t count) {
+        for (auto node = head; node != nullptr; node = node->next) {
+            LogPolicy::record(LogOp::Push, node->data);  // Log while the chain is still private.
+        }
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        AsyncWaiter* served = nullptr;  // Suspended consumers given the newest values, linked through next.
+        StackNode<T>* given = nullptr;  // Their nodes, in the same order, linked through next.
+        while (head != nullptr && asyncHead.load(std::memory_order_relaxed) != nullptr) {
+            AsyncWaiter* waiter = dequeueWaiter();
+            waiter->next = served;
+            served = waiter;
+            StackNode<T>* node = head;
+            head = node->next;
+            node->next = given;
+            given = node;
+            --count;
+        }
+        if (head != nullptr) {
+            bottom->next = top;  // Hang the current stack off the end of the chain.
+            top = head;  // Update the top to be the newest node of the chain.
+        }
+        StatsPolicy::adjustDepth(static_cast<std::ptrdiff_t>(count));
+        publish(static_cast<std::ptrdiff_t>(count));
+        const std::size_t wake = std::min(count, waiting);  // One wakeup per value, but no more than are waiting.
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        if (wake != 0) waitQueue.notify(wake);
+        StatsPolicy::countPush(count);
+        while (served != nullptr) {  // Read next before deliver(), which may end the waiter's coroutine.
+            AsyncWaiter* waiter = served;
+            StackNode<T>* node = given;
+            served = waiter->next;
+            given = node->next;
+            deliver(waiter, std::move(node->data));
+            Allocator::destroy(node);
+        }
+    }
+
+public:
+    // Method to pop up to n values in one critical section, writing them to out from the top down.
+    // Returns the number of values popped, which is less than n only if the stack ran out.
+    template<typename OutputIt>
+    std::size_t pop_n(OutputIt out, std::size_t n) {
+        if (n == 0) return 0;
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        auto first = top;  // The detached chain starts at the current top.
+        std::size_t taken = 0;
+        auto rest = top;
+        while (rest != nullptr && taken < n) {  // Walk past up to n nodes.
+            rest = rest->next;
+            ++taken;
+        }
+        top = rest;  // Cut the chain off in one step.
+        StatsPolicy::adjustDepth(-static_cast<std::ptrdiff_t>(taken));
+        publish(-static_cast<std::ptrdiff_t>(taken));
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        StatsPolicy::countPop(taken);
+        if (taken < n) StatsPolicy::countFailedPop();  // The stack ran out before n values.
+        for (std::size_t i = 0; i < taken; ++i) {  // The chain is private now; unload it without the lock.
+            auto next = first->next;
+            LogPolicy::record(LogOp::Pop, first->data);
+            *out++ = std::move(first->data);
+            Allocator::destroy(first);
+            first = next;
+        }
+        return taken;
+    }
+
+    // Method to pop a value from the stack into out. Returns false, without throwing, if the stack is empty.
+    bool try_pop(T& out) {
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        auto node = top;  // Store the top node.
+        if (node != nullptr) {
+            top = node->next;  // Update the top to the next node.
+            StatsPolicy::adjustDepth(-1);
+            publish(-1);
+        }
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        if (node == nullptr) {
+            StatsPolicy::countFailedPop();
+            return false;  // The stack was empty.
+        }
+        StatsPolicy::countPop();
+        out = std::move(node->data);  // The node is ours now, so move the data out without holding the lock.
+        Allocator::destroy(node);  // Free the old top node outside the lock.
+        LogPolicy::record(LogOp::Pop, out);  // Log the pop operation outside the lock.
+        return true;
+    }
+
+    // Method to pop a value from the stack. Returns std::nullopt, without throwing, if the stack is empty.
+    std::optional<T> try_pop() {
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        auto node = top;  // Store the top node.
+        if (node != nullptr) {
+            top = node->next;  // Update the top to the next node.
+            StatsPolicy::adjustDepth(-1);
+            publish(-1);
+        }
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        if (node == nullptr) {
+            StatsPolicy::countFailedPop();
+            return std::nullopt;  // The stack was empty.
+        }
+        StatsPolicy::countPop();
+        std::optional<T> data(std::move(node->data));  // Move the data straight into the result.
+        Allocator::destroy(node);  // Free the old top node outside the lock.
+        LogPolicy::record(LogOp::Pop, *data);  // Log the pop operation outside the lock.
+        return data;
+    }
+
+    // Method to pop a value from the stack. Throws std::runtime_error if the stack is empty; prefer try_pop on hot paths.
+    T pop() {
+        std::optional<T> data = try_pop();
+        if (!data) {  // Check if the stack is empty.
+            std::cerr << "Error: Attempted to pop from an empty stack.\n";  // Log an error message.
+            throw std::runtime_error("Attempted to pop an empty stack.");  // Throw an exception.
+        }
+        return std::move(*data);  // Return the popped data.
+    }
+
+    // Method to pop a value from the stack, sleeping until a value is pushed if the stack is empty.
+    T wait_pop() { return std::move(*takeWaited(waitForNode(nullptr))); }
+
+    // Method to pop a value from the stack, sleeping up to timeout for a push if the stack is empty.
+    // Returns std::nullopt, without throwing, if the stack is still empty when the timeout expires.
+    template<typename Rep, typename Period>
+    std::optional<T> wait_pop_for(const std::chrono::duration<Rep, Period>& timeout) {
+        const timespec deadline = WaitQueue::deadlineAfter(timeout);
+        return takeWaited(waitForNode(&deadline));
+    }
+
+    // Define the awaitable returned by async_pop(). co_await yields the popped value: at once if the stack has one,
+    // otherwise once a push hands one over.
+    class PopAwaiter {
+    private:
+        ThreadSafeStack& stack;
+        AsyncWaiter waiter;
+
+    public:
+        PopAwaiter(ThreadSafeStack& owner, ResumeTarget target) : stack(owner) { waiter.target = target; }
+
+        bool await_ready() const noexcept { return false; }  // await_suspend() takes the fast path under the lock.
+
+        // Take the top value if there is one and continue without suspending; otherwise queue up and suspend.
+        // Once the lock is released a pusher may resume the coroutine, so nothing here touches *this after that.
+        bool await_suspend(std::coroutine_handle<> handle) {
+            Held held;
+            stack.lock(held);
+            StackNode<T>* node = stack.top;
+            if (node != nullptr) {
+                stack.top = node->next;
+                stack.StatsPolicy::adjustDepth(-1);
+                stack.publish(-1);
+                stack.unlock(held);
+                waiter.value.emplace(std::move(node->data));
+                Allocator::destroy(node);  // Free the old top node outside the lock.
+                return false;
+            }
+            waiter.handle = handle;
+            if (stack.asyncTail != nullptr) {
+                stack.asyncTail->next = &waiter;
+            } else {
+                stack.asyncHead.store(&waiter, std::memory_order_relaxed);
+            }
+            stack.asyncTail = &waiter;
+            stack.unlock(held);
+            return true;
+        }
+
+        T await_resume() {
+            stack.StatsPolicy::countPop();
+            stack.LogPolicy::record(LogOp::Pop, *waiter.value);  // Log the pop operation on the consumer's side.
+            return std::move(*waiter.value);
+        }
+    };
+
+    // Method to pop a value from a coroutine: co_await stack.async_pop() suspends while the stack is empty and
+    // resumes, on the thread of the push that delivered the value, once one arrives.
+    PopAwaiter async_pop() { return PopAwaiter(*this, ResumeTarget::inlineOnPusher()); }
+
+    // Method to pop a value from a coroutine, resuming through executor.schedule() if it had to wait. The executor
+    // must outlive the wait.
+    template<typename Executor>
+    PopAwaiter async_pop(Executor& executor) { return PopAwaiter(*this, ResumeTarget::on(executor)); }
+
+    // Method to push a value from a coroutine. The stack is unbounded, so the push happens at once and co_await
+    // never suspends; it is there so coroutine code can use this stack and a bounded one alike.
+    std::suspend_never async_push(T value) {
+        push(std::move(value));
+        return {};
+    }
+
+    // Method to clear the stack.
+    // The whole chain is detached in one short critical section and freed after the lock is released, so pushes
+    // and pops racing with clear() only wait for a pointer swap. A push that completes after the swap lands on the
+    // now-empty stack instead of being discarded.
+    void clear() {
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        auto node = top;  // Take the whole chain.
+        top = nullptr;  // Leave an empty stack behind.
+        size.store(0, std::memory_order_relaxed);
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        std::size_t count = 0;
+        while (node != nullptr) {  // Free the detached chain without holding the lock.
+            auto next = node->next;
+            Allocator::destroy(node);
+            node = next;
+            ++count;
+        }
+        if (count != 0) {
+            LogPolicy::record(LogOp::Clear, count);  // One record for the whole chain rather than one per element.
+            StatsPolicy::adjustDepth(-static_cast<std::ptrdiff_t>(count));
+        }
+    }
+
+    // Method to detach every value at once, as a chain the caller owns: a pointer swap under the lock, whatever the
+    // depth. The values stay in their nodes; the chain is counted, and logged as one clear, after the lock is
+    // released. Pushes that complete after the swap land on the now-empty stack.
+    StackChain<T, Allocator> drain() {
+        Held held;
+        lock(held);  // Lock the mutex before modifying the stack.
+        auto head = top;  // Take the whole chain.
+        top = nullptr;  // Leave an empty stack behind.
+        size.store(0, std::memory_order_relaxed);
+        unlock(held);  // Unlock the mutex after modifying the stack.
+        std::size_t count = 0;
+        StackNode<T>* tail = nullptr;
+        for (auto node = head; node != nullptr; node = node->next) {  // Walk the private chain without the lock.
+            tail = node;
+            ++count;
+        }
+        if (count != 0) {
+            LogPolicy::record(LogOp::Clear, count);  // The values left the stack, as with clear().
+            StatsPolicy::adjustDepth(-static_cast<std::ptrdiff_t>(count));
+        }
+        return StackChain<T, Allocator>(head, tail, count);
+    }
+
+    // Method to call fn(const T&) on every value, top first, without popping. The lock is held for the whole walk,
+    // so the values seen are exactly the stack's contents at one moment; fn should be short and must not use the
+    // stack. For a long per-value job, drain() and push_chain() the values back instead.
+    template<typename Fn>
+    void for_each_snapshot(Fn fn) {
+        Held held;
+        lock(held);  // Lock the mutex so no push or pop changes the chain under the walk.
+        try {
+            for (const StackNode<T>* node = top; node != nullptr; node = node->next) fn(static_cast<const T&>(node->data));
+        } catch (...) {
+            unlock(held);
+            throw;
+        }
+        unlock(held);  // Unlock the mutex after the walk.
+    }
+
+    // Method to return the number of values, read without the lock so it never contends with push or pop. It may lag
+    // operations in flight on other threads; once they are done it is exact. See size_locked() for an exact count.
+    std::size_t approx_size() const { return size.load(std::memory_order_relaxed); }
+
+    // Method to check, without the lock, whether the stack looks empty. Same consistency as approx_size().
+    bool empty() const { return approx_size() == 0; }
+
+    // Method to return a copy of the top value, or std::nullopt if the stack looks empty. For small trivially
+    // copyable T it reads a relaxed copy of the top value without the lock, which may be a value that was on top a
+    // moment ago; for other types it is top_peek_locked().
+    std::optional<T> top_peek() {
+        if constexpr (kMirrorsTop) {
+            if (empty()) return std::nullopt;
+            return topValue.load(std::memory_order_relaxed);
+        } else {
+            return top_peek_locked();
+        }
+    }
+
+    // Method to return the exact number of values at one moment. Slower: takes the lock, so it waits behind and
+    // delays pushes and pops.
+    std::size_t size_locked() {
+        Held held;
+        lock(held);
+        const std::size_t depth = size.load(std::memory_order_relaxed);
+        unlock(held);
+        return depth;
+    }
+
+    // Method to check whether the stack is empty at one moment. Slower: takes the lock.
+    bool empty_locked() { return size_locked() == 0; }
+
+    // Method to return a copy of the value on top at one moment, or std::nullopt if the stack is empty. Slower:
+    // takes the lock, and copies the value under it.
+    std::optional<T> top_peek_locked() {
+        Held held;
+        lock(held);
+        std::optional<T> value;
+        try {
+            if (top != nullptr) value.emplace(top->data);
+        } catch (...) {
+            unlock(held);
+            throw;
+        }
+        unlock(held);
+        return value;
+    }
+
+    // Method to take a snapshot of the instrumentation counters. All zero unless StatsPolicy is ContentionStats.
+    StackStats stats() const { return StatsPolicy::snapshot(); }
+};
+
+#endif // THREAD_SAFE_STACK_H
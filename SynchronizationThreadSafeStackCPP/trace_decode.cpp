@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "mapped_trace.h"
+
+// Decode a memory-mapped trace written by MappedLog (see mapped_trace.h).
+//   trace_decode FILE            print every record, merged across threads in timestamp order
+//   trace_decode --check FILE    check the trace against the behaviour of a stack and print a summary
+// The text form is one line per record: nanoseconds since the trace was opened, the thread id, and the same
+// "Pushed: N" / "Popped: N" / "Cleared: N" / "Rejected: N" text as TextLog ('#' marks a hashed value).
+//
+// --check verifies what a trace of a correct stack must satisfy: every pop returns a value that was pushed before
+// it and has not been popped since, and each thread's timestamps never go backwards. Records are taken outside the
+// stack's lock, so the trace cannot order operations that overlapped in time, and does not prove strict LIFO order
+// between them; it does catch lost, duplicated and invented values. The trace does not say which values a clear()
+// removed, and its record is taken after the chain was swapped out, so a push recorded before it may have been
+// linked in after the swap, and a pop recorded after it may have unlinked its value before the swap. A Clear record
+// therefore moves every outstanding push to a set of possibly cleared values instead of forgetting it, and a pop
+// that matches no outstanding push may still consume one of those. Only a pop with no push left to match at all is
+// reported. A Rejected record withdraws a push that was recorded before it failed, on a full BoundedStack or a throw
+// in SegmentedStack, so it consumes an outstanding or possibly cleared push of its value like a pop would, and is
+// reported if none is left. The exit status is 1 if any check fails.
+
+namespace {
+
+// Define one decoded record with the time converted to nanoseconds since the trace was opened.
+struct Event {
+    double ns;
+    std::uint64_t ticks;
+    std::uint32_t thread;
+    LogOp op;
+    bool hashed;
+    std::int64_t value;
+};
+
+// Define a linear mapping from clock ticks to nanoseconds since the trace was opened, fitted to the calibration
+// pairs in the file: the start, every region claim and, after a clean close, the end.
+struct TickScale {
+    double nsPerTick = 1.0;
+    std::int64_t originTicks = 0;
+
+    double toNs(std::uint64_t ticks) const {
+        return (static_cast<double>(static_cast<std::int64_t>(ticks) - originTicks)) * nsPerTick;
+    }
+};
+
+// Define the trace file mapped read-only.
+class TraceFile {
+private:
+    int fd = -1;
+    void* mapping = MAP_FAILED;
+    std::size_t bytes = 0;
+
+public:
+    const TraceFileHeader* header = nullptr;
+
+    // Open and validate the file; prints the reason and returns false on failure.
+    bool open(const char* path) {
+        fd = ::open(path, O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            std::cerr << "Cannot open " << path << "\n";
+            return false;
+        }
+        bytes = static_cast<std::size_t>(info.st_size);
+        if (bytes < kTraceHeaderBytes) {
+            std::cerr << path << " is too short to be a trace\n";
+            return false;
+        }
+        mapping = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "Cannot map " << path << "\n";
+            return false;
+        }
+        header = static_cast<const TraceFileHeader*>(mapping);
+        if (std::memcmp(header->magic, kTraceMagic, sizeof(kTraceMagic)) != 0 || header->version != kTraceVersion ||
+            header->recordBytes != sizeof(TraceRecord)) {
+            std::cerr << path << " is not a version " << kTraceVersion << " stack trace\n";
+            return false;
+        }
+        return true;
+    }
+
+    ~TraceFile() {
+        if (mapping != MAP_FAILED) munmap(mapping, bytes);
+        if (fd >= 0) ::close(fd);
+    }
+
+    // Return the regions that were claimed and are fully inside the file.
+    std::vector<const TraceRegionHeader*> regions() const {
+        std::vector<const TraceRegionHeader*> result;
+        const std::uint64_t claimed = std::min(header->regionsClaimed.load(std::memory_order_relaxed), header->regionCount);
+        for (std::uint64_t i = 0; i < claimed; ++i) {
+            const std::size_t offset = kTraceHeaderBytes + i * header->regionBytes;
+            if (offset + header->regionBytes > bytes) break;  // Truncated file.
+            result.push_back(reinterpret_cast<const TraceRegionHeader*>(static_cast<const unsigned char*>(mapping) + offset));
+        }
+        return result;
+    }
+};
+
+// Fit the tick scale to the earliest and latest calibration pairs in the trace.
+TickScale fitScale(const TraceFile& file, const std::vector<const TraceRegionHeader*>& regions) {
+    const TraceFileHeader& header = *file.header;
+    TickScale scale;
+    scale.originTicks = header.startTicks;
+    if (header.ticksAreCycles == 0) return scale;  // Ticks are nanoseconds already.
+    std::pair<std::int64_t, std::int64_t> first{header.startTicks, header.startNs};
+    std::pair<std::int64_t, std::int64_t> last = first;
+    for (const auto* region : regions) {
+        if (region->claimTicks > last.first) last = {region->claimTicks, region->claimNs};
+    }
+    const std::int64_t endTicks = header.endTicks.load(std::memory_order_relaxed);
+    if (endTicks > last.first) last = {endTicks, header.endNs.load(std::memory_order_relaxed)};
+    if (last.first > first.first) {
+        scale.nsPerTick = static_cast<double>(last.second - first.second) / static_cast<double>(last.first - first.first);
+    }
+    return scale;
+}
+
+const char* opText(LogOp op) {
+    switch (op) {
+        case LogOp::Push: return "Pushed";
+        case LogOp::Pop: return "Popped";
+        case LogOp::Clear: return "Cleared";
+        case LogOp::Dropped: return "Dropped";
+        case LogOp::Rejected: return "Rejected";
+    }
+    return "Unknown";
+}
+
+// Check the events, in timestamp order, against the behaviour of a stack. Returns the number of problems found.
+std::uint64_t check(const std::vector<Event>& events, const std::vector<const TraceRegionHeader*>& regions,
+                    std::uint64_t dropped) {
+    std::uint64_t problems = 0;
+    auto report = [&problems](const std::string& message) {
+        if (++problems <= 20) std::cerr << message << "\n";
+    };
+
+    // Each region is written by one thread in program order, so its timestamps must not decrease.
+    for (const auto* region : regions) {
+        const auto* records = reinterpret_cast<const TraceRecord*>(region + 1);
+        const std::uint64_t count = region->count.load(std::memory_order_acquire);
+        for (std::uint64_t i = 1; i < count; ++i) {
+            if (records[i].ticks < records[i - 1].ticks) {
+                report("thread " + std::to_string(region->thread) + ": timestamp went backwards at record " + std::to_string(i));
+            }
+        }
+    }
+
+    using Counts = std::map<std::pair<bool, std::int64_t>, std::int64_t>;
+    Counts outstanding;  // Pushes not yet matched by a pop, per value.
+    Counts possiblyCleared;  // Pushes that were outstanding at a Clear record and have not been matched since.
+    // Match a pop against counts, returning false if no push of its value is left there.
+    const auto consume = [](Counts& counts, const Event& event) {
+        auto it = counts.find({event.hashed, event.value});
+        if (it == counts.end()) return false;
+        if (--it->second == 0) counts.erase(it);
+        return true;
+    };
+    std::uint64_t pushes = 0, pops = 0, clears = 0, rejected = 0;
+    std::int64_t depth = 0, peak = 0;
+    for (const Event& event : events) {
+        if (event.op == LogOp::Push) {
+            ++pushes;
+            ++outstanding[{event.hashed, event.value}];
+            peak = std::max(peak, ++depth);
+        } else if (event.op == LogOp::Pop) {
+            ++pops;
+            if (consume(outstanding, event)) {
+                --depth;
+            } else if (!consume(possiblyCleared, event)) {
+                report("thread " + std::to_string(event.thread) + " at " + std::to_string(static_cast<long long>(event.ns)) +
+                       " ns popped " + (event.hashed ? "#" : "") + std::to_string(event.value) +
+                       ", which no earlier push left on the stack");
+            }
+        } else if (event.op == LogOp::Rejected) {
+            ++rejected;
+            if (consume(outstanding, event)) {
+                --depth;
+            } else if (!consume(possiblyCleared, event)) {
+                report("thread " + std::to_string(event.thread) + " at " + std::to_string(static_cast<long long>(event.ns)) +
+                       " ns rejected a push of " + (event.hashed ? "#" : "") + std::to_string(event.value) +
+                       ", which no earlier push left on the stack");
+            }
+        } else if (event.op == LogOp::Clear) {
+            ++clears;
+            for (const auto& [value, count] : outstanding) possiblyCleared[value] += count;
+            outstanding.clear();
+            depth = 0;
+        }
+    }
+    if (dropped != 0) {
+        std::cerr << "warning: " << dropped << " records were dropped because the trace was full; "
+                  << "pops of their values may be reported above\n";
+    }
+    std::cout << pushes << " pushes (" << rejected << " rejected), " << pops << " pops, " << clears << " clears across " << regions.size()
+              << " regions; " << depth << " values left on the stack (peak " << peak << "); " << problems
+              << " problems\n";
+    return problems;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const bool checkMode = argc == 3 && std::strcmp(argv[1], "--check") == 0;
+    if (!(argc == 2 && argv[1][0] != '-') && !checkMode) {
+        std::cerr << "Usage: " << argv[0] << " [--check] FILE\n";
+        return 2;
+    }
+    TraceFile file;
+    if (!file.open(argv[argc - 1])) return 2;
+    const auto regions = file.regions();
+    const TickScale scale = fitScale(file, regions);
+
+    std::vector<Event> events;
+    for (const auto* region : regions) {
+        const auto* records = reinterpret_cast<const TraceRecord*>(region + 1);
+        const std::uint64_t count = std::min(region->count.load(std::memory_order_acquire), file.header->regionRecords);
+        for (std::uint64_t i = 0; i < count; ++i) {
+            const TraceRecord& r = records[i];
+            events.push_back({scale.toNs(r.ticks), r.ticks, r.thread, r.op, r.hashed, r.value});
+        }
+    }
+    std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.ticks < b.ticks; });
+
+    if (checkMode) {
+        return check(events, regions, file.header->dropped.load(std::memory_order_relaxed)) == 0 ? 0 : 1;
+    }
+    for (const Event& event : events) {
+        std::printf("%14.0f  thread %-4u %s: %s%lld\n", event.ns, event.thread, opText(event.op), event.hashed ? "#" : "",
+                    static_cast<long long>(event.value));
+    }
+    return 0;
+}
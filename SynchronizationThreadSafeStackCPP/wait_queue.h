@@ -0,0 +1,76 @@
+#ifndef WAIT_QUEUE_H
+#define WAIT_QUEUE_H
+
+#include <chrono>
+#include <cstddef>
+#include <pthread.h>
+#include <time.h>
+
+// Define a place for consumers to sleep until a producer has something for them. It only does the sleeping and
+// waking: the stack counts its waiters under its own lock, so a producer learns whether anyone is waiting from a
+// plain read inside the critical section it already holds, and only calls notify() when the count is non-zero.
+//
+// The handshake that makes this safe: a consumer that found the stack empty calls prepare() while still holding the
+// stack's lock, then releases the lock and calls park(). A producer that pushes after that must take the stack's
+// lock, so it sees the waiter, and its notify() blocks on the internal mutex until the consumer is asleep. A wakeup
+// therefore cannot fall between the consumer's check and its sleep.
+class WaitQueue {
+private:
+    pthread_mutex_t mutex;  // Held from prepare() until the consumer is asleep, and around every signal.
+    pthread_cond_t wake;  // Signalled once per value made available to a waiter.
+
+public:
+    WaitQueue() : mutex(PTHREAD_MUTEX_INITIALIZER), wake(PTHREAD_COND_INITIALIZER) {
+        pthread_mutex_init(&mutex, nullptr);
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);  // Deadlines must not move when the wall clock does.
+        pthread_cond_init(&wake, &attr);
+        pthread_condattr_destroy(&attr);
+    }
+
+    ~WaitQueue() {
+        pthread_cond_destroy(&wake);
+        pthread_mutex_destroy(&mutex);
+    }
+
+    WaitQueue(const WaitQueue&) = delete;
+    WaitQueue& operator=(const WaitQueue&) = delete;
+
+    // Return the CLOCK_MONOTONIC time timeout from now, for use as a park() deadline.
+    template<typename Rep, typename Period>
+    static timespec deadlineAfter(const std::chrono::duration<Rep, Period>& timeout) {
+        timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+        if (ns <= 0) return deadline;
+        deadline.tv_sec += static_cast<time_t>(ns / 1000000000);
+        deadline.tv_nsec += static_cast<long>(ns % 1000000000);
+        if (deadline.tv_nsec >= 1000000000) {
+            ++deadline.tv_sec;
+            deadline.tv_nsec -= 1000000000;
+        }
+        return deadline;
+    }
+
+    // Begin waiting. Must be called with the stack's lock held, and followed by park() once it is released.
+    void prepare() { pthread_mutex_lock(&mutex); }
+
+    // Sleep until notified or until deadline passes; nullptr waits without a deadline. Returns false on timeout.
+    // Like any condition variable wait it may also return early, so the caller re-checks the stack either way.
+    bool park(const timespec* deadline) {
+        const int status = deadline == nullptr ? pthread_cond_wait(&wake, &mutex)
+                                               : pthread_cond_timedwait(&wake, &mutex, deadline);
+        pthread_mutex_unlock(&mutex);
+        return status == 0;
+    }
+
+    // Wake up to count sleeping consumers. Called after the stack's lock is released, and only when it had waiters.
+    void notify(std::size_t count = 1) {
+        pthread_mutex_lock(&mutex);
+        for (std::size_t i = 0; i < count; ++i) pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&mutex);
+    }
+};
+
+#endif // WAIT_QUEUE_H
@@ -42,9 +42,76 @@ impl<T> Stack<T> {
     }
 }
 
+// Workload settings, shared with the C and C++ drivers so the cross-language harness can run all three alike.
+//   --threads N        number of threads (default 200)
+//   --iterations N     loop iterations per thread; each iteration is 6 operations (default 500)
+//   --mix M            classic (3 pushes and 3 pops intermixed), push-heavy, balanced or pop-heavy (default classic)
+//   --log on|off       write every operation to output.txt (default on)
+//   --mode M           serial (each thread holds the stack lock for its whole loop, the default),
+//                      shared (one stack, locked per operation) or per-thread (each thread has its own stack)
+#[derive(Clone, Copy, PartialEq)]
+enum Mode {
+    Serial,
+    Shared,
+    PerThread,
+}
+
+#[derive(Clone, Copy)]
+struct Workload {
+    threads: usize,
+    iterations: i32,
+    // 0 selects the classic pattern; otherwise the share of random operations that are pushes.
+    push_percent: u64,
+    log: bool,
+    mode: Mode,
+}
+
+impl Workload {
+    // Read the workload settings from the command line, or return a usage message.
+    fn from_args() -> Result<Self, String> {
+        let mut workload = Workload { threads: 200, iterations: 500, push_percent: 0, log: true, mode: Mode::Serial };
+        let args: Vec<String> = std::env::args().collect();
+        let usage = format!(
+            "Usage: {} [--threads N] [--iterations N] [--mix classic|push-heavy|balanced|pop-heavy] \
+             [--log on|off] [--mode serial|shared|per-thread]",
+            args[0]
+        );
+        let mut i = 1;
+        while i < args.len() {
+            let value = args.get(i + 1).map(String::as_str);
+            match (args[i].as_str(), value) {
+                ("--threads", Some(v)) => workload.threads = v.parse().ok().filter(|&n| n > 0).ok_or(usage.clone())?,
+                ("--iterations", Some(v)) => workload.iterations = v.parse().ok().filter(|&n| n >= 0).ok_or(usage.clone())?,
+                ("--mix", Some("classic")) => workload.push_percent = 0,
+                ("--mix", Some("push-heavy")) => workload.push_percent = 80,
+                ("--mix", Some("balanced")) => workload.push_percent = 50,
+                ("--mix", Some("pop-heavy")) => workload.push_percent = 20,
+                ("--log", Some("on")) => workload.log = true,
+                ("--log", Some("off")) => workload.log = false,
+                ("--mode", Some("serial")) => workload.mode = Mode::Serial,
+                ("--mode", Some("shared")) => workload.mode = Mode::Shared,
+                ("--mode", Some("per-thread")) => workload.mode = Mode::PerThread,
+                _ => return Err(usage),
+            }
+            i += 2;
+        }
+        Ok(workload)
+    }
+}
+
 fn main() {
+    // Read the workload settings, or print usage and exit.
+    let workload = Workload::from_args().unwrap_or_else(|usage| {
+        eprintln!("{}", usage);
+        std::process::exit(1);
+    });
     // Create and open a new file called 'output.txt', or exit if the file can't be created.
-    let file = File::create("output.txt").expect("Failed to create output file.");
+    // With logging off the writer goes to a sink instead, so the stack code is the same either way.
+    let file: Box<dyn Write + Send> = if workload.log {
+        Box::new(File::create("output.txt").expect("Failed to create output file."))
+    } else {
+        Box::new(std::io::sink())
+    };
     // Wrap the file in a BufWriter for efficient writing.
     let writer = BufWriter::new(file);
     // Wrap the BufWriter in an Arc and Mutex to allow safe shared access across threads.
@@ -53,20 +120,44 @@ fn main() {
     let shared_stack = Arc::new(Mutex::new(Stack::<i32>::new()));
     // Initialize a vector to hold the handles of the spawned threads.
     let mut handles = vec![];
-    // Loop 200 times to create 200 threads.
-    for _ in 0..200 {
-        // Clone the Arc pointing to the stack to pass to the thread.
-        let stack_clone = Arc::clone(&shared_stack);
+    // Loop to create the threads.
+    for index in 0..workload.threads {
+        // Clone the Arc pointing to the stack to pass to the thread, or give the thread a stack of its own.
+        let stack_clone = if workload.mode == Mode::PerThread {
+            Arc::new(Mutex::new(Stack::<i32>::new()))
+        } else {
+            Arc::clone(&shared_stack)
+        };
         // Clone the Arc pointing to the writer to pass to the thread.
         let writer_clone = Arc::clone(&shared_writer);
         // Spawn a new thread.
         let handle = thread::spawn(move || {
-            // Lock the stack for this thread, panicking if the lock fails.
-            let mut stack = stack_clone.lock().unwrap();
-            // Lock the writer for this thread, panicking if the lock fails.
-            let mut writer = writer_clone.lock().unwrap();
-            // Execute the test_stack function which performs operations on the stack and writes to the file.
-            test_stack(&mut stack, &mut writer);
+            // With logging off each thread writes to a sink of its own and never locks the shared writer,
+            // just as the C and C++ drivers skip their log, so per-thread mode shares no lock at all.
+            let mut own_sink: Option<BufWriter<Box<dyn Write + Send>>> =
+                if workload.log { None } else { Some(BufWriter::new(Box::new(std::io::sink()))) };
+            if workload.mode == Mode::Serial {
+                // Lock the stack for this thread, panicking if the lock fails.
+                let mut stack = stack_clone.lock().unwrap();
+                match own_sink.as_mut() {
+                    Some(sink) => test_stack(&workload, index, &mut |op| op(&mut stack, sink)),
+                    None => {
+                        // Lock the writer for this thread, panicking if the lock fails.
+                        let mut writer = writer_clone.lock().unwrap();
+                        // Execute the test_stack function which performs operations on the stack and writes to the file.
+                        test_stack(&workload, index, &mut |op| op(&mut stack, &mut writer));
+                    }
+                }
+            } else {
+                // Lock the stack, then the writer if logging is on, for each operation separately.
+                test_stack(&workload, index, &mut |op| {
+                    let mut stack = stack_clone.lock().unwrap();
+                    match own_sink.as_mut() {
+                        Some(sink) => op(&mut stack, sink),
+                        None => op(&mut stack, &mut writer_clone.lock().unwrap()),
+                    }
+                });
+            }
         });
         // Store the handle of the spawned thread in the vector.
         handles.push(handle);
@@ -76,49 +167,61 @@ fn main() {
         // Block the current thread until the thread represented by handle completes.
         handle.join().unwrap();
     }
+    // Make sure everything buffered reaches the file.
+    shared_writer.lock().unwrap().flush().expect("Error writing to file");
     // Print to the console when all threads have completed their execution.
     println!("Program completed.");
 
 }
 
-// Define the test_stack function that operates on a mutable reference to a Stack of i32 and a mutable BufWriter for a File.
-fn test_stack(stack: &mut Stack<i32>, writer: &mut BufWriter<File>) {
-    // Iterate 500 times, using `i` as the loop counter.
-    for i in 0..500 {
-        // 3 intermixed push and pop operations
-        // 'i * 3 + _' is a way to generate distinct values for each iteration of the loop that are evenly spaced apart
-        let next_value1 = i * 3 + 1;
-        writeln!(writer, "Pushing {}", next_value1).expect("Error writing to file");
-        stack.push(next_value1);
-
-        let next_value2 = i * 3 + 2;
-        writeln!(writer, "Pushing {}", next_value2).expect("Error writing to file");
-        stack.push(next_value2);
+// A stack operation, run by test_stack with the stack and writer locked.
+type Op<'a> = &'a mut dyn FnMut(&mut Stack<i32>, &mut BufWriter<Box<dyn Write + Send>>);
 
-        pop_and_log(stack, writer);
-
-        let next_value3 = i * 3 + 3;
-        writeln!(writer, "Pushing {}", next_value3).expect("Error writing to file");
-        stack.push(next_value3);
-
-        pop_and_log(stack, writer);
-
-        pop_and_log(stack, writer);
+// Define the test_stack function that runs the workload's operations through `with_stack`,
+// which supplies a mutable reference to a Stack of i32 and a mutable BufWriter for the output.
+fn test_stack(workload: &Workload, index: usize, with_stack: &mut dyn FnMut(Op)) {
+    // xorshift state for the random mixes, identical to the C and C++ drivers.
+    let mut state: u64 = 0x9E3779B97F4A7C15u64.wrapping_mul(index as u64 + 1);
+    // Iterate over the loop, using `i` as the loop counter.
+    for i in 0..workload.iterations {
+        if workload.push_percent == 0 {
+            // 3 intermixed push and pop operations
+            // 'i * 3 + _' is a way to generate distinct values for each iteration of the loop that are evenly spaced apart
+            with_stack(&mut |stack, writer| push_and_log(stack, writer, i * 3 + 1));
+            with_stack(&mut |stack, writer| push_and_log(stack, writer, i * 3 + 2));
+            with_stack(&mut |stack, writer| pop_and_log(stack, writer));
+            with_stack(&mut |stack, writer| push_and_log(stack, writer, i * 3 + 3));
+            with_stack(&mut |stack, writer| pop_and_log(stack, writer));
+            with_stack(&mut |stack, writer| pop_and_log(stack, writer));
+            continue;
+        }
+        for j in 0..6 {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            if (state.wrapping_mul(0x2545F4914F6CDD1D) >> 32) % 100 < workload.push_percent {
+                with_stack(&mut |stack, writer| push_and_log(stack, writer, i * 6 + j));
+            } else {
+                with_stack(&mut |stack, writer| pop_and_log(stack, writer));
+            }
+        }
     }
 }
 
+// Define a function push_and_log that pushes the value onto the stack and writes a log message.
+// The messages match the C driver's, one line per push and per successful pop, so --log on does the same I/O.
+fn push_and_log<W: Write>(stack: &mut Stack<i32>, writer: &mut W, value: i32) {
+    stack.push(value);
+    writeln!(writer, "Pushed {}", value).expect("Error writing to file");
+}
+
 // Define a generic function pop_and_log that accepts a stack and a writer.
 // The generic type T must implement the 'Display' trait for formatting.
-fn pop_and_log<T: std::fmt::Display>(stack: &mut Stack<T>, writer: &mut BufWriter<File>) {
+fn pop_and_log<T: std::fmt::Display, W: Write>(stack: &mut Stack<T>, writer: &mut W) {
     // Attempt to pop a value from the stack.
+    // If a value is successfully popped (i.e., the stack was not empty), write a log message stating the popped value.
+    // An empty stack is not logged, as in the C and C++ drivers.
     if let Some(value) = stack.pop() {
-        // If a value is successfully popped (i.e., the stack was not empty), write a log message stating the popped value.
         writeln!(writer, "Popped {}", value).expect("Error writing to file");
-    } else {
-        // If no value could be popped (i.e., the stack was empty), write a log message stating that the stack was empty.
-        writeln!(writer, "Stack was empty, nothing to pop").expect("Error writing to file");
     }
 }
-
-
-
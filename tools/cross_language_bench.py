@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+"""Run the C, C++ and Rust stack drivers under identical workloads and compare them.
+
+Each driver accepts the same workload options (--threads, --iterations, --mix, --log, --mode), so one workload spec
+drives all three. Every run executes in a scratch directory (the drivers write output.txt into their working
+directory). The harness reports wall time, ops/sec, CPU time, voluntary and involuntary context switches (from the
+child's rusage) and peak RSS (sampled from /proc). Each iteration of a driver's loop is 6 stack operations, so
+ops = threads * iterations * 6.
+
+The sharing model is part of the spec: "shared" runs every thread against one stack, "per-thread" gives each thread
+its own stack, which is what the original C driver did.
+
+Examples:
+    tools/cross_language_bench.py --build
+    tools/cross_language_bench.py --threads 1,8,64 --mix balanced --log off --csv results.csv
+    tools/cross_language_bench.py --spec workload.json --cpp-variants default,lockfree --json results.json
+
+A spec file is a JSON object with any of the keys threads, iterations, mix, log, mode and repeat. List values are
+swept, e.g. {"threads": [1, 8], "mode": ["shared", "per-thread"], "log": ["off"]}.
+"""
+
+import argparse
+import csv
+import itertools
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BUILD_DIR = os.path.join(REPO, "_harness_build")
+MIXES = ("classic", "push-heavy", "balanced", "pop-heavy")
+MODES = ("shared", "per-thread")
+OPS_PER_ITERATION = 6
+RSS_POLL_S = 0.002  # How often a running driver's peak RSS is sampled.
+
+
+def default_binaries():
+    """Return where --build puts each driver."""
+    return {
+        "c": os.path.join(BUILD_DIR, "c", "SynchronizationThreadSafeStack"),
+        "cpp": os.path.join(BUILD_DIR, "cpp", "SynchronizationThreadSafeStackCPP"),
+        "rust": os.path.join(REPO, "synchronization_thread_safe_stack", "target", "release",
+                             "synchronization_thread_safe_stack"),
+    }
+
+
+def build():
+    """Build all three drivers with optimizations."""
+    for name, source in (("c", "SynchronizationThreadSafeStackC"), ("cpp", "SynchronizationThreadSafeStackCPP")):
+        out = os.path.join(BUILD_DIR, name)
+        subprocess.run(["cmake", "-S", os.path.join(REPO, source), "-B", out, "-DCMAKE_BUILD_TYPE=Release"],
+                       check=True, stdout=subprocess.DEVNULL)
+        subprocess.run(["cmake", "--build", out, "-j", str(os.cpu_count() or 1)], check=True, stdout=subprocess.DEVNULL)
+    subprocess.run(["cargo", "build", "--release", "--quiet"], check=True,
+                   cwd=os.path.join(REPO, "synchronization_thread_safe_stack"))
+
+
+def read_peak_rss(pid, name):
+    """Return the VmHWM of pid in KiB, or None if pid is gone or has not exec'd the driver yet."""
+    try:
+        with open("/proc/%d/status" % pid) as status:
+            fields = dict(line.split(":", 1) for line in status if ":" in line)
+    except OSError:
+        return None
+    if fields.get("Name", "").strip() != name[:15] or "VmHWM" not in fields:
+        return None
+    return int(fields["VmHWM"].split()[0])
+
+
+def run_once(command):
+    """Run command in a scratch directory and return its wall time and resource usage.
+
+    Peak RSS is sampled from /proc/<pid>/status rather than taken from ru_maxrss: the child starts life as a copy of
+    this Python process, and Linux carries that pre-exec high-water mark into ru_maxrss, hiding small drivers.
+    """
+    scratch = tempfile.mkdtemp(prefix="stack_bench_")
+    name = os.path.basename(command[0])
+    peak = None
+    try:
+        start = time.perf_counter()
+        child = subprocess.Popen(command, cwd=scratch, stdout=subprocess.DEVNULL)
+        while True:
+            pid, status, usage = os.wait4(child.pid, os.WNOHANG)
+            if pid != 0:
+                break
+            sample = read_peak_rss(child.pid, name)
+            if sample is not None:
+                peak = max(peak or 0, sample)
+            time.sleep(RSS_POLL_S)
+        wall = time.perf_counter() - start
+        child.returncode = os.waitstatus_to_exitcode(status)
+        if child.returncode != 0:
+            raise RuntimeError("%s exited with status %d" % (" ".join(command), child.returncode))
+    finally:
+        shutil.rmtree(scratch, ignore_errors=True)
+    return {
+        "wall_s": wall,
+        "user_s": usage.ru_utime,
+        "sys_s": usage.ru_stime,
+        "voluntary_ctx": usage.ru_nvcsw,
+        "involuntary_ctx": usage.ru_nivcsw,
+        "peak_rss_kib": peak,  # None if the run finished before the first sample.
+    }
+
+
+def measure(command, repeat):
+    """Run command repeat times and keep the run with the median wall time."""
+    runs = sorted((run_once(command) for _ in range(repeat)), key=lambda run: run["wall_s"])
+    return runs[len(runs) // 2]
+
+
+def as_list(value):
+    return value if isinstance(value, list) else [value]
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--spec", help="JSON workload spec; command-line options override its keys")
+    parser.add_argument("--threads", help="comma-separated thread counts (default 8)")
+    parser.add_argument("--iterations", help="comma-separated iterations per thread (default 500)")
+    parser.add_argument("--mix", help="comma-separated mixes from %s (default classic)" % ", ".join(MIXES))
+    parser.add_argument("--log", help="comma-separated on/off (default on,off)")
+    parser.add_argument("--mode", help="comma-separated sharing modes from %s (default both)" % ", ".join(MODES))
+    parser.add_argument("--repeat", type=int, help="runs per configuration; the median is kept (default 3)")
+    parser.add_argument("--languages", default="c,cpp,rust", help="drivers to run (default c,cpp,rust)")
+    parser.add_argument("--cpp-variants", default="default",
+                        help="C++ stack variants: default, lockfree, elimination, combining, segmented (default: default)")
+    parser.add_argument("--build", action="store_true", help="build the drivers into _harness_build first")
+    for language in ("c", "cpp", "rust"):
+        parser.add_argument("--%s-bin" % language, help="path to the %s driver" % language)
+    parser.add_argument("--csv", help="also write the report as CSV to this path")
+    parser.add_argument("--json", help="also write the report as JSON to this path")
+    return parser.parse_args()
+
+
+def load_spec(args):
+    """Merge the spec file, command-line options and defaults into lists of values to sweep."""
+    spec = {"threads": [8], "iterations": [500], "mix": ["classic"], "log": ["on", "off"], "mode": list(MODES),
+            "repeat": 3}
+    if args.spec:
+        with open(args.spec) as handle:
+            spec.update(json.load(handle))
+    for key in ("threads", "iterations", "mix", "log", "mode"):
+        option = getattr(args, key)
+        if option is not None:
+            spec[key] = option.split(",")
+        spec[key] = [str(value) for value in as_list(spec[key])]
+    if args.repeat is not None:
+        spec["repeat"] = args.repeat
+    for mix in spec["mix"]:
+        if mix not in MIXES:
+            sys.exit("unknown mix: %s" % mix)
+    for mode in spec["mode"]:
+        if mode not in MODES:
+            sys.exit("unknown mode: %s" % mode)
+    return spec
+
+
+def driver_commands(args, binaries):
+    """Yield (name, command prefix) for every driver and C++ variant to run."""
+    for language in args.languages.split(","):
+        if language == "cpp":
+            for variant in args.cpp_variants.split(","):
+                prefix = [binaries["cpp"]] + ([] if variant == "default" else [variant])
+                yield "cpp" if variant == "default" else "cpp-" + variant, prefix
+        elif language in binaries:
+            yield language, [binaries[language]]
+        else:
+            sys.exit("unknown language: %s" % language)
+
+
+def main():
+    args = parse_args()
+    spec = load_spec(args)
+    if args.build:
+        build()
+    binaries = default_binaries()
+    for language in binaries:
+        override = getattr(args, "%s_bin" % language)
+        if override:
+            binaries[language] = os.path.abspath(override)
+
+    rows = []
+    drivers = list(driver_commands(args, binaries))
+    for threads, iterations, mix, log, mode in itertools.product(spec["threads"], spec["iterations"], spec["mix"],
+                                                                 spec["log"], spec["mode"]):
+        workload = ["--threads", threads, "--iterations", iterations, "--mix", mix, "--log", log, "--mode", mode]
+        ops = int(threads) * int(iterations) * OPS_PER_ITERATION
+        for name, prefix in drivers:
+            result = measure(prefix + workload, spec["repeat"])
+            row = {"driver": name, "threads": int(threads), "iterations": int(iterations), "mix": mix, "log": log,
+                   "mode": mode, "ops": ops}
+            row.update(result)
+            row["ops_per_sec"] = ops / result["wall_s"]
+            rows.append(row)
+            print("%-16s threads=%-4s mix=%-10s log=%-3s mode=%-10s %9.4f s %12.0f ops/s  ctx=%d/%d  rss=%s KiB"
+                  % (name, threads, mix, log, mode, result["wall_s"], row["ops_per_sec"], result["voluntary_ctx"],
+                     result["involuntary_ctx"], result["peak_rss_kib"] or "n/a"), flush=True)
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as handle:
+            writer = csv.DictWriter(handle, fieldnames=list(rows[0].keys()) if rows else [])
+            writer.writeheader()
+            writer.writerows(rows)
+    if args.json:
+        with open(args.json, "w") as handle:
+            json.dump(rows, handle, indent=2)
+
+
+if __name__ == "__main__":
+    main()